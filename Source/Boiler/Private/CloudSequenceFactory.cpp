@@ -0,0 +1,101 @@
+#include "CloudSequenceFactory.h"
+
+#if WITH_EDITOR
+
+#include "Misc/FileHelper.h"
+#include "Misc/ScopedSlowTask.h"
+#include "CloudVoxels.h"
+
+#define LOCTEXT_NAMESPACE "UCloudSequenceFactory"
+
+UCloudSequenceFactory::UCloudSequenceFactory(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer) {
+	SupportedClass = UVaporCloudSequence::StaticClass();
+	Formats.Add(TEXT("vdbseq;OpenVDB Sequence"));
+	bCreateNew = false;
+	bEditorImport = true;
+	bEditAfterNew = true;
+	ImportPriority = DefaultImportPriority;
+}
+
+FText UCloudSequenceFactory::GetDisplayName() const {
+	return LOCTEXT("CloudSequenceFactoryDescription", "Cloud Sequence");
+}
+
+bool UCloudSequenceFactory::FactoryCanImport(const FString& Filename) {
+	return FPaths::GetExtension(Filename).Equals(TEXT("vdbseq"), ESearchCase::IgnoreCase);
+}
+
+UObject* UCloudSequenceFactory::FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags, const FString& Filename, const TCHAR* Parms, FFeedbackContext* Warn, bool& bOutOperationCanceled) {
+	bOutOperationCanceled = false;
+	if (!FactoryCanImport(Filename)) return nullptr;
+
+	return CreateSequenceFromVDBs(Filename, InParent, InName, Flags, bOutOperationCanceled);
+}
+
+UVaporCloudSequence* UCloudSequenceFactory::CreateSequenceFromVDBs(const FString& Filename, UObject* InParent, FName InName, EObjectFlags Flags, bool& bOutOperationCanceled) {
+	/* Read the sequence file */
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *Filename)) {
+		UE_LOG(LogTemp, Error, TEXT("Error opening VDB sequence file: %s"), *Filename);
+		return nullptr;
+	}
+
+	/* Parse the frame rate and the frame files */
+	float FrameRate = 24.0f;
+	TArray<FString> FrameFiles;
+	for (FString Line : Lines) {
+		Line.TrimStartAndEndInline();
+		if (Line.IsEmpty() || Line.StartsWith(TEXT("#"))) continue;
+		if (Line.StartsWith(TEXT("fps="), ESearchCase::IgnoreCase)) {
+			FrameRate = FMath::Max(FCString::Atof(*Line.RightChop(4)), 0.01f);
+			continue;
+		}
+		FrameFiles.Add(FPaths::IsRelative(Line) ? FPaths::Combine(FPaths::GetPath(Filename), Line) : Line);
+	}
+
+	/* Make sure the sequence has at least 1 frame */
+	if (FrameFiles.Num() == 0) {
+		UE_LOG(LogTemp, Error, TEXT("No frames found in VDB sequence file"));
+		return nullptr;
+	}
+
+	/* Create the new sequence asset */
+	UVaporCloudSequence* Sequence = NewObject<UVaporCloudSequence>(InParent, InName, Flags);
+	Sequence->FrameRate = FrameRate;
+
+	/* Import the frames one by one, only a single frame is resident in dense form at a time */
+	FScopedSlowTask SlowTask(FrameFiles.Num(), LOCTEXT("ImportingCloudSequence", "Importing cloud sequence..."));
+	SlowTask.MakeDialog(true);
+	TArray<uint8> Density;
+	TArray<uint16> SDF;
+	for (const FString& FrameFile : FrameFiles) {
+		SlowTask.EnterProgressFrame(1.0f, FText::FromString(FPaths::GetCleanFilename(FrameFile)));
+		if (SlowTask.ShouldCancel()) {
+			bOutOperationCanceled = true;
+			return nullptr;
+		}
+
+		/* Load and resample the VDB file into dense voxel buffers */
+		FCloudVoxels Voxels;
+		if (!LoadCloudVoxelsFromVDB(FrameFile, Voxels)) return nullptr;
+		if (Sequence->NumFrames == 0) Sequence->FrameSize = Voxels.Size;
+
+		/* Encode the frame the same way as the static cloud textures */
+		const int32 NumVoxels = Voxels.Density.Num();
+		Density.SetNumUninitialized(NumVoxels);
+		SDF.SetNumUninitialized(NumVoxels);
+		for (int32 index = 0; index < NumVoxels; ++index) {
+			Density[index] = Voxels.EncodeDensity(index);
+			SDF[index] = Voxels.EncodeSDF(index);
+		}
+		Sequence->AddFrame(Density, SDF);
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Vapor: Imported cloud sequence with %d frames at %.2f fps (%.2f MB per frame)"),
+		Sequence->NumFrames, Sequence->FrameRate, Sequence->GetFrameBytes() / (1024.0f * 1024.0f));
+	return Sequence;
+}
+
+#undef LOCTEXT_NAMESPACE
+
+#endif // WITH_EDITOR
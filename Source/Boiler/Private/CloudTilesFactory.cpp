@@ -0,0 +1,102 @@
+#include "CloudTilesFactory.h"
+
+#if WITH_EDITOR
+
+#include "Misc/FileHelper.h"
+#include "Misc/ScopedSlowTask.h"
+#include "CloudVoxels.h"
+
+#define LOCTEXT_NAMESPACE "UCloudTilesFactory"
+
+UCloudTilesFactory::UCloudTilesFactory(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer) {
+	SupportedClass = UVaporCloudscape::StaticClass();
+	Formats.Add(TEXT("vdbtiles;OpenVDB Tiled Cloudscape"));
+	bCreateNew = false;
+	bEditorImport = true;
+	bEditAfterNew = true;
+	ImportPriority = DefaultImportPriority;
+}
+
+FText UCloudTilesFactory::GetDisplayName() const {
+	return LOCTEXT("CloudTilesFactoryDescription", "Tiled Cloudscape");
+}
+
+bool UCloudTilesFactory::FactoryCanImport(const FString& Filename) {
+	return FPaths::GetExtension(Filename).Equals(TEXT("vdbtiles"), ESearchCase::IgnoreCase);
+}
+
+UObject* UCloudTilesFactory::FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags, const FString& Filename, const TCHAR* Parms, FFeedbackContext* Warn, bool& bOutOperationCanceled) {
+	bOutOperationCanceled = false;
+	if (!FactoryCanImport(Filename)) return nullptr;
+
+	return CreateCloudscapeFromVDB(Filename, InParent, InName, Flags, bOutOperationCanceled);
+}
+
+UVaporCloudscape* UCloudTilesFactory::CreateCloudscapeFromVDB(const FString& Filename, UObject* InParent, FName InName, EObjectFlags Flags, bool& bOutOperationCanceled) {
+	/* Read the cloudscape file */
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *Filename)) {
+		UE_LOG(LogTemp, Error, TEXT("Error opening VDB tiles file: %s"), *Filename);
+		return nullptr;
+	}
+
+	/* Parse the number of tiles and the source file */
+	FIntPoint NumTiles = FIntPoint::ZeroValue;
+	FString Source;
+	for (FString Line : Lines) {
+		Line.TrimStartAndEndInline();
+		if (Line.StartsWith(TEXT("tiles="), ESearchCase::IgnoreCase)) {
+			TArray<FString> Counts;
+			Line.RightChop(6).ParseIntoArrayWS(Counts);
+			if (Counts.Num() == 2) NumTiles = FIntPoint(FCString::Atoi(*Counts[0]), FCString::Atoi(*Counts[1]));
+		} else if (Line.StartsWith(TEXT("source="), ESearchCase::IgnoreCase)) {
+			Source = Line.RightChop(7);
+			if (FPaths::IsRelative(Source)) Source = FPaths::Combine(FPaths::GetPath(Filename), Source);
+		}
+	}
+
+	/* Make sure the file has a valid grid of tiles */
+	if (NumTiles.X <= 0 || NumTiles.Y <= 0 || Source.IsEmpty()) {
+		UE_LOG(LogTemp, Error, TEXT("VDB tiles file needs a \"tiles=X Y\" and a \"source=\" line"));
+		return nullptr;
+	}
+
+	/* Create the new cloudscape asset */
+	UVaporCloudscape* Cloudscape = NewObject<UVaporCloudscape>(InParent, InName, Flags);
+	Cloudscape->Init(NumTiles);
+
+	/* Resample the tiles one by one, only a single tile is resident in dense form at a time */
+	FScopedSlowTask SlowTask(NumTiles.X * NumTiles.Y * VaporCloudscape::NumLODs, LOCTEXT("ImportingCloudscape", "Importing tiled cloudscape..."));
+	SlowTask.MakeDialog(true);
+	TArray<uint8> Density;
+	TArray<uint16> SDF;
+	const bool bSuccess = LoadCloudTilesFromVDB(Source, NumTiles, [&](const FIntPoint& Tile, const int32 LOD, const FCloudVoxels* Voxels) {
+		SlowTask.EnterProgressFrame(1.0f, FText::Format(LOCTEXT("ImportingTile", "Tile {0}, {1} (LOD {2})"), Tile.X, Tile.Y, LOD));
+		if (SlowTask.ShouldCancel()) {
+			bOutOperationCanceled = true;
+			return false;
+		}
+		if (Voxels == nullptr) return true;
+
+		/* Encode the tile the same way as the static cloud textures */
+		const int32 NumVoxels = Voxels->Density.Num();
+		Density.SetNumUninitialized(NumVoxels);
+		SDF.SetNumUninitialized(NumVoxels);
+		for (int32 index = 0; index < NumVoxels; ++index) {
+			Density[index] = Voxels->EncodeDensity(index);
+			SDF[index] = Voxels->EncodeSDF(index);
+		}
+		Cloudscape->SetTile(Tile.X + Tile.Y * NumTiles.X, LOD, Density, SDF);
+		return true;
+	});
+	if (!bSuccess) return nullptr;
+
+	int32 NumEmpty = 0;
+	for (const bool bEmpty : Cloudscape->EmptyTiles) NumEmpty += bEmpty ? 1 : 0;
+	UE_LOG(LogTemp, Log, TEXT("Vapor: Imported %dx%d tiled cloudscape, %d empty tiles"), NumTiles.X, NumTiles.Y, NumEmpty);
+	return Cloudscape;
+}
+
+#undef LOCTEXT_NAMESPACE
+
+#endif // WITH_EDITOR
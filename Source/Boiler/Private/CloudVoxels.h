@@ -0,0 +1,119 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/* Size of a single voxel in world units, must match `UNITS_PER_VOXEL` in "Cloud.ush". */
+constexpr float UNITS_PER_VOXEL = 800.0f; // 8 m
+
+/* Dense copy of a resampled cloud, stored in texture index space. (x + y * X + z * X * Y) */
+struct FCloudVoxels {
+	/* Number of voxels along each axis */
+	FIntVector Size = FIntVector::ZeroValue;
+
+	/* Density of each voxel (0..1) */
+	TArray<float> Density;
+	/* Signed distance to the cloud surface of each voxel, in voxels */
+	TArray<float> SDF;
+
+	/** @brief Allocate the buffers for a grid of the given size. */
+	void Init(const FIntVector& InSize) {
+		Size = InSize;
+		Density.SetNumZeroed(Size.X * Size.Y * Size.Z);
+		SDF.SetNumZeroed(Size.X * Size.Y * Size.Z);
+	}
+
+	/** @brief Get the buffer index of a voxel. */
+	FORCEINLINE int32 Index(const int32 X, const int32 Y, const int32 Z) const {
+		return X + (Y * Size.X) + (Z * Size.X * Size.Y);
+	}
+
+	/** @brief Check if a point in voxel-space lies inside the grid. */
+	FORCEINLINE bool Contains(const FVector3f& Point) const {
+		return Point.X >= 0.0f && Point.Y >= 0.0f && Point.Z >= 0.0f
+			&& Point.X <= Size.X && Point.Y <= Size.Y && Point.Z <= Size.Z;
+	}
+
+	/** @brief Encode the density of a voxel as stored in the density texture. (G8, 0..1) */
+	FORCEINLINE uint8 EncodeDensity(const int32 VoxelIndex) const {
+		return (uint8)(FMath::Clamp(Density[VoxelIndex], 0.0f, 1.0f) * 255.0f);
+	}
+
+	/** @brief Encode the signed distance of a voxel as stored in the SDF texture. (G16, -32..512 voxels) */
+	FORCEINLINE uint16 EncodeSDF(const int32 VoxelIndex) const {
+		return (uint16)(FMath::Clamp((SDF[VoxelIndex] + 32.0f) / (512.0f + 32.0f), 0.0f, 1.0f) * 65535.0f);
+	}
+
+	/** @brief Create the next mip, averaging each 2x2x2 block. The SDF stays in voxels of the full resolution grid. */
+	FCloudVoxels Downsample() const {
+		FCloudVoxels Mip;
+		Mip.Init(FIntVector(FMath::Max(Size.X / 2, 1), FMath::Max(Size.Y / 2, 1), FMath::Max(Size.Z / 2, 1)));
+		for (int32 z = 0; z < Mip.Size.Z; ++z) {
+			for (int32 y = 0; y < Mip.Size.Y; ++y) {
+				for (int32 x = 0; x < Mip.Size.X; ++x) {
+					float DensitySum = 0.0f, SDFSum = 0.0f;
+					for (int32 i = 0; i < 8; ++i) {
+						const int32 Child = Index(FMath::Min(x * 2 + (i & 1), Size.X - 1), FMath::Min(y * 2 + ((i >> 1) & 1), Size.Y - 1), FMath::Min(z * 2 + (i >> 2), Size.Z - 1));
+						DensitySum += Density[Child];
+						SDFSum += SDF[Child];
+					}
+					Mip.Density[Mip.Index(x, y, z)] = DensitySum / 8.0f;
+					Mip.SDF[Mip.Index(x, y, z)] = SDFSum / 8.0f;
+				}
+			}
+		}
+		return Mip;
+	}
+
+	/** @brief Trilinearly sample the density at a point in voxel-space. */
+	FORCEINLINE float SampleDensity(const FVector3f& Point) const { return Sample(Density, Point); }
+
+	/** @brief Trilinearly sample the signed distance at a point in voxel-space. */
+	FORCEINLINE float SampleSDF(const FVector3f& Point) const { return Sample(SDF, Point); }
+
+private:
+	/** @brief Trilinearly sample a buffer, with texel centers at +0.5 and clamped addressing. (like `GlobalBilinearClampedSampler`) */
+	float Sample(const TArray<float>& Buffer, const FVector3f& Point) const {
+		const FVector3f Texel = Point - 0.5f;
+		const int32 X0 = FMath::Clamp(FMath::FloorToInt32(Texel.X), 0, Size.X - 1);
+		const int32 Y0 = FMath::Clamp(FMath::FloorToInt32(Texel.Y), 0, Size.Y - 1);
+		const int32 Z0 = FMath::Clamp(FMath::FloorToInt32(Texel.Z), 0, Size.Z - 1);
+		const int32 X1 = FMath::Min(X0 + 1, Size.X - 1);
+		const int32 Y1 = FMath::Min(Y0 + 1, Size.Y - 1);
+		const int32 Z1 = FMath::Min(Z0 + 1, Size.Z - 1);
+		const float FX = FMath::Clamp(Texel.X - X0, 0.0f, 1.0f);
+		const float FY = FMath::Clamp(Texel.Y - Y0, 0.0f, 1.0f);
+		const float FZ = FMath::Clamp(Texel.Z - Z0, 0.0f, 1.0f);
+
+		const float C00 = FMath::Lerp(Buffer[Index(X0, Y0, Z0)], Buffer[Index(X1, Y0, Z0)], FX);
+		const float C10 = FMath::Lerp(Buffer[Index(X0, Y1, Z0)], Buffer[Index(X1, Y1, Z0)], FX);
+		const float C01 = FMath::Lerp(Buffer[Index(X0, Y0, Z1)], Buffer[Index(X1, Y0, Z1)], FX);
+		const float C11 = FMath::Lerp(Buffer[Index(X0, Y1, Z1)], Buffer[Index(X1, Y1, Z1)], FX);
+		return FMath::Lerp(FMath::Lerp(C00, C10, FY), FMath::Lerp(C01, C11, FY), FZ);
+	}
+};
+
+/* Error of a field mip against a supersampled box filter over its footprint. (see `ValidateFieldMips`) */
+struct FFieldMipError {
+	/* Mean density error of a single sample of the mip, and of a single unfiltered sample of mip 0 */
+	float MipError = 0.0f;
+	float BaseError = 0.0f;
+	/* Largest amount the SDF of the mip overestimated the distance by, in voxels of mip 0 */
+	float SDFOverestimate = 0.0f;
+	int32 NumPoints = 0;
+};
+
+/**
+ * @brief Check how well the field mips match the footprint they're sampled at, logs the error of each mip.
+ * The reference is a supersampled box filter over the footprint, compared to a single sample of the mip and of mip 0.
+ * Returns the error of each mip, mip 0 is left empty.
+ */
+TArray<FFieldMipError> ValidateFieldMips(const TArray<FCloudVoxels>& Mips);
+
+/** @brief Load a VDB file and resample its density into dense voxel buffers. (see "CloudscapeFactory.cpp") */
+bool LoadCloudVoxelsFromVDB(const FString& Filename, FCloudVoxels& OutVoxels);
+
+/**
+ * @brief Load a VDB file and resample it into a grid of tiles, at every LOD of `VaporCloudscape`.
+ * Tiles include the apron, `OnTile` receives nullptr for empty tiles, and can return false to cancel.
+ */
+bool LoadCloudTilesFromVDB(const FString& Filename, const FIntPoint& NumTiles, TFunctionRef<bool(const FIntPoint& Tile, const int32 LOD, const FCloudVoxels* Voxels)> OnTile);
@@ -3,6 +3,11 @@
 #if WITH_EDITOR
 
 #include "Engine/VolumeTexture.h"
+#include "CloudVoxels.h"
+#include "TransmittanceBake.h"
+#include "Vapor/Public/VaporCloudscape.h"
+#include "Vapor/Public/VaporDensity.h"
+#include "Misc/Optional.h"
 
 THIRD_PARTY_INCLUDES_START
 __pragma(warning(disable: 4706))
@@ -63,57 +68,47 @@ float Remap(float Value, float InMin, float InMax, float OutMin, float OutMax) {
 	return OutMin + (Clamped * (OutMax - OutMin));
 }
 
-openvdb::FloatGrid::Ptr ResampleGrid(const openvdb::BBoxd& WorldAABB, const openvdb::FloatGrid& Grid, const openvdb::FloatGrid::Ptr ScaleGrid, const uint32 X, const uint32 Y, const uint32 Z) {
+/** @brief Pre-filter a grid for down-sampling by a scale factor, returns nullptr if there is no grid. */
+openvdb::FloatGrid::Ptr PrefilterGrid(const openvdb::FloatGrid::Ptr Grid, const float ScaleFactor) {
+	if (Grid == nullptr) return nullptr;
+	openvdb::FloatGrid::Ptr Filtered = Grid->deepCopy();
+	if (ScaleFactor >= 2.0f) {
+		openvdb::tools::Filter<openvdb::FloatGrid> Filter(*Filtered);
+		Filter.gaussian((int)ScaleFactor / 2, 1);
+	}
+	return Filtered;
+}
+
+/** @brief Resample a world region of pre-filtered grids into X * Y * Z voxels. (the VDB Y axis is up) */
+openvdb::FloatGrid::Ptr ResampleRegion(const openvdb::BBoxd& WorldAABB, const openvdb::FloatGrid& Filtered, const openvdb::FloatGrid::Ptr FilteredScale, const uint32 X, const uint32 Y, const uint32 Z) {
 	/* Find the step size to use for resampling the grid */
 	const openvdb::Vec3d StepSizes = WorldAABB.extents() / openvdb::Vec3d(X, Z, Y);
-	const double StepSize = std::max(std::max(StepSizes.x(), StepSizes.y()), StepSizes.z());
-
-	/* Calculate the down-scale factor of the resampling process */
-	const openvdb::Coord GridSize = Grid.evalActiveVoxelDim();
-	const openvdb::Vec3f ScaleFactor = openvdb::Vec3f(GridSize.x(), GridSize.y(), GridSize.z()) / openvdb::Vec3f(X, Z, Y);
-	const float LargestScaleFactor = std::max(std::max(ScaleFactor.x(), ScaleFactor.y()), ScaleFactor.z());
 
 	/* Create the new resampled grid */
 	openvdb::FloatGrid::Ptr Resampled = openvdb::FloatGrid::create(0.0f);
 	openvdb::FloatGrid::Accessor Accessor = Resampled->getAccessor();
 
-	/* Pre-filter the input grid for down-sampling */
-	openvdb::FloatGrid::Ptr Filtered = Grid.deepCopy();
-	openvdb::FloatGrid::Ptr FilteredScale = ScaleGrid ? ScaleGrid->deepCopy() : nullptr;
-	if (LargestScaleFactor >= 2.0f) {
-		openvdb::tools::Filter<openvdb::FloatGrid> Filter(*Filtered);
-		Filter.gaussian((int)LargestScaleFactor / 2, 1);
-		if (FilteredScale != nullptr) {
-			openvdb::tools::Filter<openvdb::FloatGrid> FilterScale(*FilteredScale);
-			FilterScale.gaussian((int)LargestScaleFactor / 2, 1);
-		}
-	}
-
-	/* Create a box grid sampler for the input grid */
-	const openvdb::tools::GridSampler<openvdb::FloatGrid, openvdb::tools::BoxSampler> Sampler(*Filtered);
+	/* Create box grid samplers for the input grids */
+	const openvdb::tools::GridSampler<openvdb::FloatGrid, openvdb::tools::BoxSampler> Sampler(Filtered);
+	TOptional<openvdb::tools::GridSampler<openvdb::FloatGrid, openvdb::tools::BoxSampler>> ScaleSampler;
+	if (FilteredScale != nullptr) ScaleSampler.Emplace(*FilteredScale);
 
 	/* Resample the pre-filtered grid */
 	for (uint32 z = 0; z < Z; ++z) {
 		for (uint32 y = 0; y < Y; ++y) {
 			for (uint32 x = 0; x < X; ++x) {
-				/* Sample the pre-filtered grid */
-				float Value = Sampler.wsSample(openvdb::Vec3d(
+				const openvdb::Vec3d SamplePos = openvdb::Vec3d(
 					WorldAABB.min().x() + x * StepSizes.x(),
 					WorldAABB.min().y() + z * StepSizes.y(),
 					WorldAABB.min().z() + y * StepSizes.z()
-				));
-
-				if (ScaleGrid != nullptr) {
-					const openvdb::tools::GridSampler<openvdb::FloatGrid, openvdb::tools::BoxSampler> ScaleSampler(*FilteredScale);
-					const float DensityScale = ScaleSampler.wsSample(openvdb::Vec3d(
-						WorldAABB.min().x() + x * StepSizes.x(),
-						WorldAABB.min().y() + z * StepSizes.y(),
-						WorldAABB.min().z() + y * StepSizes.z()
-					));
-					
-					const float PowScale = FMath::Pow(FMath::Clamp(DensityScale, 0.0f, 1.0f), 4.0f);
-					Value *= PowScale;
-					Value = FMath::Pow(Value, FMath::Lerp(0.3f, 0.6f, FMath::Max(0.00001f, PowScale)));
+				);
+
+				/* Sample the pre-filtered grid */
+				float Value = Sampler.wsSample(SamplePos);
+
+				/* The density scale grid is baked into the density, the renderer applies the component density on top */
+				if (ScaleSampler.IsSet()) {
+					Value = VaporDensity::Transform(Value, ScaleSampler->wsSample(SamplePos));
 				}
 
 				/* Set the value inside our resampled grid */
@@ -125,82 +120,209 @@ openvdb::FloatGrid::Ptr ResampleGrid(const openvdb::BBoxd& WorldAABB, const open
 	return Resampled;
 }
 
-void CreateDensityTexture(UVolumeTexture& Output, const openvdb::FloatGrid& DensityGrid) {
-	/* Initialize the volume texture */
-	Output.Source.Init(VTEX_X, VTEX_Y, VTEX_Z, 1, TSF_G8, nullptr);
+openvdb::FloatGrid::Ptr ResampleGrid(const openvdb::BBoxd& WorldAABB, const openvdb::FloatGrid::Ptr Grid, const openvdb::FloatGrid::Ptr ScaleGrid, const uint32 X, const uint32 Y, const uint32 Z) {
+	/* Calculate the down-scale factor of the resampling process */
+	const openvdb::Coord GridSize = Grid->evalActiveVoxelDim();
+	const openvdb::Vec3f ScaleFactor = openvdb::Vec3f(GridSize.x(), GridSize.y(), GridSize.z()) / openvdb::Vec3f(X, Z, Y);
+	const float LargestScaleFactor = std::max(std::max(ScaleFactor.x(), ScaleFactor.y()), ScaleFactor.z());
+
+	/* Pre-filter the input grids for down-sampling, and resample them */
+	const openvdb::FloatGrid::Ptr Filtered = PrefilterGrid(Grid, LargestScaleFactor);
+	const openvdb::FloatGrid::Ptr FilteredScale = PrefilterGrid(ScaleGrid, LargestScaleFactor);
+	return ResampleRegion(WorldAABB, *Filtered, FilteredScale, X, Y, Z);
+}
 
-	/* Create a grid accessor and lock the volume texture data */
-	const openvdb::FloatGrid::ConstAccessor Accessor = DensityGrid.getConstAccessor();
-	uint8* TextureData = Output.Source.LockMip(0);
+FCloudVoxels CreateCloudVoxels(const openvdb::FloatGrid& DensityGrid, const FIntVector& Size) {
+	FCloudVoxels Voxels;
+	Voxels.Init(Size);
 
-	/* Move the density data into a texture */
-	for (int32 z = 0; z < VTEX_Z; ++z) {
-		for (int32 y = 0; y < VTEX_Y; ++y) {
-			for (int32 x = 0; x < VTEX_X; ++x) {
-				/* Sample the density grid */
-				const float Density = Accessor.getValue(openvdb::Coord(x, y, z));
+	/* Convert the density grid data to a signed distance field */
+	const openvdb::FloatGrid::Ptr SdfGrid = openvdb::tools::fogToSdf(DensityGrid, 0.0001f);
 
-				/* Calculate the texture index and write our density data */
-				const int32 index = x + (y * VTEX_X) + (z * VTEX_X * VTEX_Y);
-				TextureData[index] = (uint8)Remap(Density, 0.0f, 1.0f, 0.0f, 255.0f);
+	/* Create the grid accessors */
+	const openvdb::FloatGrid::ConstAccessor DensityAccessor = DensityGrid.getConstAccessor();
+	const openvdb::FloatGrid::ConstAccessor SdfAccessor = SdfGrid->getConstAccessor();
+
+	/* Move the grid data into dense buffers */
+	for (int32 z = 0; z < Size.Z; ++z) {
+		for (int32 y = 0; y < Size.Y; ++y) {
+			for (int32 x = 0; x < Size.X; ++x) {
+				const int32 index = Voxels.Index(x, y, z);
+				Voxels.Density[index] = DensityAccessor.getValue(openvdb::Coord(x, y, z));
+				Voxels.SDF[index] = SdfAccessor.getValue(openvdb::Coord(x, y, z));
 			}
 		}
 	}
 
-	/* Unlock the volume texture data */
-	Output.Source.UnlockMip(0);
+	return Voxels;
+}
+
+void CreateTransmittanceTexture(UVolumeTexture& Output, const FCloudVoxels& Voxels) {
+	/* Bake the spherical harmonics on the CPU */
+	const double StartTime = FPlatformTime::Seconds();
+	TArray<FFloat16Color> SH;
+	const FIntVector Size = BakeTransmittanceSH(Voxels, FTransmittanceBakeSettings(), SH);
+	UE_LOG(LogTemp, Log, TEXT("Baked %dx%dx%d transmittance volume in %.2fs"), Size.X, Size.Y, Size.Z, FPlatformTime::Seconds() - StartTime);
+
+	/* Initialize the volume texture, and copy over the SH data */
+	Output.Source.Init(Size.X, Size.Y, Size.Z, 1, TSF_RGBA16F, (const uint8*)SH.GetData());
 
 	/* Set all the volume texture settings */
 	Output.MipGenSettings = TMGS_NoMipmaps;
-	Output.CompressionSettings = TC_Grayscale;
+	Output.CompressionSettings = TC_HDR;
 	Output.SRGB = false;
 	Output.Filter = TF_Bilinear;
-	Output.AddressMode = TA_Wrap;
+	Output.AddressMode = TA_Clamp;
 
 	/* Update the volume texture resource */
 	Output.UpdateResource();
 }
 
-void CreateSDFTexture(UVolumeTexture& Output, const openvdb::FloatGrid& DensityGrid) {
-	/* Initialize the volume texture */
-	Output.Source.Init(VTEX_X, VTEX_Y, VTEX_Z, 1, TSF_G16, nullptr);
-
-	/* Convert the density grid data to a signed distance field */
-	const openvdb::FloatGrid::Ptr SdfGrid = openvdb::tools::fogToSdf(DensityGrid, 0.0001f);
-
-	/* Create a grid accessor and lock the volume texture data */
-	const openvdb::FloatGrid::ConstAccessor Accessor = SdfGrid->getConstAccessor();
-	uint16* TextureData = (uint16*)Output.Source.LockMip(0);
+TArray<uint32> FindLightCachePages(const FCloudVoxels& Voxels) {
+	using namespace VaporLightCache;
+
+	/* Cloud voxels covered by a page, including the filtering border and some slack for interpolation */
+	constexpr int32 PageVoxels = PageSize * Downsample;
+	constexpr int32 Border = Downsample + 1;
+
+	TArray<uint32> Pages;
+	for (int32 pz = 0; pz < PagesZ; ++pz) {
+		for (int32 py = 0; py < PagesY; ++py) {
+			for (int32 px = 0; px < PagesX; ++px) {
+				/* A page is needed if any of its voxels lie inside the cloud */
+				bool bOccupied = false;
+				const FIntVector Min = FIntVector(px, py, pz) * PageVoxels - Border;
+				const FIntVector Max = FIntVector(px + 1, py + 1, pz + 1) * PageVoxels + Border;
+				for (int32 z = FMath::Max(Min.Z, 0); z < FMath::Min(Max.Z, Voxels.Size.Z) && !bOccupied; ++z) {
+					for (int32 y = FMath::Max(Min.Y, 0); y < FMath::Min(Max.Y, Voxels.Size.Y) && !bOccupied; ++y) {
+						for (int32 x = FMath::Max(Min.X, 0); x < FMath::Min(Max.X, Voxels.Size.X) && !bOccupied; ++x) {
+							bOccupied = Voxels.SDF[Voxels.Index(x, y, z)] <= 1.0f;
+						}
+					}
+				}
+				if (bOccupied) Pages.Add(PackPage(px, py, pz));
+			}
+		}
+	}
 
-	/* Move the SDF data into a texture */
-	for (int32 z = 0; z < VTEX_Z; ++z) {
-		for (int32 y = 0; y < VTEX_Y; ++y) {
-			for (int32 x = 0; x < VTEX_X; ++x) {
-				/* Sample the SDF grid */
-				const float SDF = Accessor.getValue(openvdb::Coord(x, y, z));
+	UE_LOG(LogTemp, Log, TEXT("Light cache uses %d of %d pages"), Pages.Num(), PagesX * PagesY * PagesZ);
+	return Pages;
+}
 
-				/* Calculate the texture index and write our SDF data */
-				const int32 index = x + (y * VTEX_X) + (z * VTEX_X * VTEX_Y);
-				TextureData[index] = (uint16)Remap(SDF, -32.0f, 512.0f, 0.0f, 65535.0f);
+/**
+ * @brief Build a conservative hull around the occupied bricks of the SDF, as a triangle list in volume UVW space.
+ * The occupied bricks are stored too, one bit per brick, so the renderer can tell when the camera is inside the hull.
+ */
+TArray<FVector3f> BuildProxyHull(const FCloudVoxels& Voxels, FIntVector& OutBricks, TArray<uint32>& OutOccupancy) {
+	/* Voxels per hull brick along each axis, and the border around a brick which still counts towards it */
+	constexpr int32 BrickSize = VaporProxyHull::BrickSize;
+	constexpr int32 Border = 1;
+
+	/* Find the bricks which hold any voxel inside or right next to the cloud */
+	const FIntVector Bricks = FIntVector::DivideAndRoundUp(Voxels.Size, BrickSize);
+	TBitArray<> Occupied(false, Bricks.X * Bricks.Y * Bricks.Z);
+	for (int32 bz = 0; bz < Bricks.Z; ++bz) {
+		for (int32 by = 0; by < Bricks.Y; ++by) {
+			for (int32 bx = 0; bx < Bricks.X; ++bx) {
+				bool bOccupied = false;
+				const FIntVector Min = FIntVector(bx, by, bz) * BrickSize - Border;
+				const FIntVector Max = FIntVector(bx + 1, by + 1, bz + 1) * BrickSize + Border;
+				for (int32 z = FMath::Max(Min.Z, 0); z < FMath::Min(Max.Z, Voxels.Size.Z) && !bOccupied; ++z) {
+					for (int32 y = FMath::Max(Min.Y, 0); y < FMath::Min(Max.Y, Voxels.Size.Y) && !bOccupied; ++y) {
+						for (int32 x = FMath::Max(Min.X, 0); x < FMath::Min(Max.X, Voxels.Size.X) && !bOccupied; ++x) {
+							bOccupied = Voxels.SDF[Voxels.Index(x, y, z)] <= 1.0f;
+						}
+					}
+				}
+				Occupied[bx + (by * Bricks.X) + (bz * Bricks.X * Bricks.Y)] = bOccupied;
+			}
+		}
+	}
+	auto IsOccupied = [&](const FIntVector& Brick) {
+		if (Brick.X < 0 || Brick.Y < 0 || Brick.Z < 0 || Brick.X >= Bricks.X || Brick.Y >= Bricks.Y || Brick.Z >= Bricks.Z) return false;
+		return (bool)Occupied[Brick.X + (Brick.Y * Bricks.X) + (Brick.Z * Bricks.X * Bricks.Y)];
+	};
+
+	/* Emit the faces between occupied and empty bricks, wound counter-clockwise around their outward normal */
+	const FIntVector Axes[3] = { FIntVector(1, 0, 0), FIntVector(0, 1, 0), FIntVector(0, 0, 1) };
+	const FVector3f BrickUVW = FVector3f((float)BrickSize) / FVector3f(Voxels.Size);
+	TArray<FVector3f> Triangles;
+	for (int32 bz = 0; bz < Bricks.Z; ++bz) {
+		for (int32 by = 0; by < Bricks.Y; ++by) {
+			for (int32 bx = 0; bx < Bricks.X; ++bx) {
+				const FIntVector Brick(bx, by, bz);
+				if (!IsOccupied(Brick)) continue;
+
+				for (int32 Axis = 0; Axis < 3; ++Axis) {
+					const FIntVector U = Axes[(Axis + 1) % 3], V = Axes[(Axis + 2) % 3];
+					for (int32 Side = 0; Side < 2; ++Side) {
+						if (IsOccupied(Side ? Brick + Axes[Axis] : Brick - Axes[Axis])) continue;
+
+						/* Clamp the face to the volume, the last brick along an axis can be partial */
+						const FIntVector Corner = Brick + Axes[Axis] * Side;
+						const FVector3f P00 = FVector3f::Min(FVector3f(Corner) * BrickUVW, FVector3f::OneVector);
+						const FVector3f P10 = FVector3f::Min(FVector3f(Corner + U) * BrickUVW, FVector3f::OneVector);
+						const FVector3f P01 = FVector3f::Min(FVector3f(Corner + V) * BrickUVW, FVector3f::OneVector);
+						const FVector3f P11 = FVector3f::Min(FVector3f(Corner + U + V) * BrickUVW, FVector3f::OneVector);
+						if (Side) Triangles.Append({ P00, P10, P11, P00, P11, P01 });
+						else Triangles.Append({ P00, P11, P10, P00, P01, P11 });
+					}
+				}
 			}
 		}
 	}
 
-	/* Unlock the volume texture data */
-	Output.Source.UnlockMip(0);
+	OutBricks = Bricks;
+	OutOccupancy.Init(0u, FMath::DivideAndRoundUp(Occupied.Num(), 32));
+	for (TConstSetBitIterator<> It(Occupied); It; ++It) OutOccupancy[It.GetIndex() >> 5] |= 1u << (It.GetIndex() & 31);
 
-	/* Set all the volume texture settings */
-	Output.MipGenSettings = TMGS_NoMipmaps;
-	Output.CompressionSettings = TC_Alpha;
-	Output.SRGB = false;
-	Output.Filter = TF_Bilinear;
-	Output.AddressMode = TA_Wrap;
+	UE_LOG(LogTemp, Log, TEXT("Proxy hull covers %d of %d bricks (%d triangles)"), Occupied.CountSetBits(), Occupied.Num(), Triangles.Num() / 3);
+	return Triangles;
+}
 
-	/* Update the volume texture resource */
-	Output.UpdateResource();
+TArray<FFieldMipError> ValidateFieldMips(const TArray<FCloudVoxels>& Mips) {
+	constexpr int32 NumPoints = 4096;
+	constexpr int32 SamplesPerAxis = 4;
+
+	FRandomStream Random(0x5A4F);
+	const FCloudVoxels& Base = Mips[0];
+	TArray<FFieldMipError> Errors;
+	Errors.SetNum(Mips.Num());
+	for (int32 Mip = 1; Mip < Mips.Num(); ++Mip) {
+		const float Footprint = (float)(1 << Mip);
+
+		/* Only measure points near the cloud, most of the volume is empty and would hide the error */
+		FFieldMipError& Error = Errors[Mip];
+		double MipError = 0.0, BaseError = 0.0;
+		for (int32 Attempt = 0; Attempt < NumPoints * 16 && Error.NumPoints < NumPoints; ++Attempt) {
+			const FVector3f Point(Random.FRand() * Base.Size.X, Random.FRand() * Base.Size.Y, Random.FRand() * Base.Size.Z);
+			const float SDF = Base.SampleSDF(Point);
+			if (SDF > Footprint) continue;
+
+			float Reference = 0.0f;
+			for (int32 i = 0; i < SamplesPerAxis * SamplesPerAxis * SamplesPerAxis; ++i) {
+				const FVector3f Stratum(i % SamplesPerAxis, (i / SamplesPerAxis) % SamplesPerAxis, i / (SamplesPerAxis * SamplesPerAxis));
+				const FVector3f Jitter(Random.FRand(), Random.FRand(), Random.FRand());
+				Reference += Base.SampleDensity(Point + ((Stratum + Jitter) / SamplesPerAxis - 0.5f) * Footprint);
+			}
+			Reference /= SamplesPerAxis * SamplesPerAxis * SamplesPerAxis;
+
+			MipError += FMath::Abs(Mips[Mip].SampleDensity(Point / Footprint) - Reference);
+			BaseError += FMath::Abs(Base.SampleDensity(Point) - Reference);
+			Error.SDFOverestimate = FMath::Max(Error.SDFOverestimate, Mips[Mip].SampleSDF(Point / Footprint) - SDF);
+			++Error.NumPoints;
+		}
+		Error.MipError = (float)(MipError / FMath::Max(Error.NumPoints, 1));
+		Error.BaseError = (float)(BaseError / FMath::Max(Error.NumPoints, 1));
+
+		UE_LOG(LogTemp, Log, TEXT("Field mip %d (%.0f voxel footprint), mean density error %.4f, unfiltered %.4f, SDF overestimate %.2f of %.2f voxels slack, over %d points"),
+			Mip, Footprint, Error.MipError, Error.BaseError, Error.SDFOverestimate, UVaporCloud::GetMipSlack((float)Mip), Error.NumPoints);
+	}
+	return Errors;
 }
 
-UVaporCloud* UCloudscapeFactory::CreateVolumeTextureFromVDB(const FString& Filename, UObject* InParent, FName InName, EObjectFlags Flags) {
+/** @brief Read the cloud grids from a VDB file, and find the AABB of all the grids. */
+bool ReadCloudGrids(const FString& Filename, openvdb::FloatGrid::Ptr& OutProfileGrid, openvdb::FloatGrid::Ptr& OutScaleGrid, openvdb::BBoxd& OutWorldAABB) {
 	/* Init OpenVDB */
 	openvdb::initialize();
 
@@ -212,73 +334,156 @@ UVaporCloud* UCloudscapeFactory::CreateVolumeTextureFromVDB(const FString& Filen
 		File.open();
 	} catch (const std::exception& e) {
 		UE_LOG(LogTemp, Error, TEXT("Error opening VDB file: %s"), UTF8_TO_TCHAR(e.what()));
-		return nullptr;
+		return false;
 	}
 
 	/* Make sure the VDB file has at least 1 grid */
 	if (File.getGrids()->size() == 0ull) {
 		UE_LOG(LogTemp, Error, TEXT("No grids found in VDB file"));
-		return nullptr;
+		return false;
 	}
 
 	/* Just grab the first grid in the file for now */
-	openvdb::FloatGrid::Ptr ProfileGrid = openvdb::gridPtrCast<openvdb::FloatGrid>(File.getGrids()->front());
-	openvdb::FloatGrid::Ptr ScaleGrid = nullptr;
+	OutProfileGrid = openvdb::gridPtrCast<openvdb::FloatGrid>(File.getGrids()->front());
+	OutScaleGrid = nullptr;
 	for (uint32 i = 0; i < File.getGrids()->size(); ++i) {
 		const openvdb::GridBase::Ptr Grid = File.getGrids()->at(i);
 		if (Grid->getName() == "dimensional_profile") {
-			ProfileGrid = openvdb::gridPtrCast<openvdb::FloatGrid>(Grid);
+			OutProfileGrid = openvdb::gridPtrCast<openvdb::FloatGrid>(Grid);
 		}
 		if (Grid->getName() == "density_scale") {
-			ScaleGrid = openvdb::gridPtrCast<openvdb::FloatGrid>(Grid);
+			OutScaleGrid = openvdb::gridPtrCast<openvdb::FloatGrid>(Grid);
 		}
 		UE_LOG(LogTemp, Warning, TEXT("VDB Grid: %s"), UTF8_TO_TCHAR(File.getGrids()->at(i)->getName().c_str()));
 	}
 
 	/* Find the AABB of all the grids */
-	openvdb::BBoxd WorldAABB = openvdb::BBoxd();
+	OutWorldAABB = openvdb::BBoxd();
 	for (uint32 i = 0; i < File.getGrids()->size(); ++i) {
 		const openvdb::GridBase::Ptr Grid = File.getGrids()->at(i);
 		const openvdb::CoordBBox AABB = Grid->evalActiveVoxelBoundingBox();
-		WorldAABB.expand(openvdb::BBoxd(Grid->indexToWorld(AABB.min()), Grid->indexToWorld(AABB.max())));
+		OutWorldAABB.expand(openvdb::BBoxd(Grid->indexToWorld(AABB.min()), Grid->indexToWorld(AABB.max())));
 	}
 
-	/* Change the world X and Z extent to fit our texture dimensions */
+	File.close(); /* The grids stay in memory after closing the file */
+
+	/* Make sure our grid is a float grid */
+	if (!OutProfileGrid) {
+		UE_LOG(LogTemp, Error, TEXT("Grid in VDB file is not a float grid"));
+		return false;
+	}
+	return true;
+}
+
+/** @brief Change the world X and Z extent of an AABB to fit a voxel grid, keeping its height. (the VDB Y axis is up) */
+void FitWorldAABB(openvdb::BBoxd& WorldAABB, const double SizeX, const double SizeY, const double SizeZ) {
 	const double WorldHeight = WorldAABB.extents().y();
-	const double WorldX = ((double)VTEX_X / VTEX_Z) * WorldHeight;
-	const double WorldZ = ((double)VTEX_Y / VTEX_Z) * WorldHeight;
+	const double WorldX = (SizeX / SizeZ) * WorldHeight;
+	const double WorldZ = (SizeY / SizeZ) * WorldHeight;
 	const double WorldXDelta = WorldX - WorldAABB.extents().x();
 	const double WorldZDelta = WorldZ - WorldAABB.extents().z();
 	WorldAABB.min().x() -= WorldXDelta * 0.5;
 	WorldAABB.min().z() -= WorldZDelta * 0.5;
 	WorldAABB.max().x() += WorldXDelta * 0.5;
 	WorldAABB.max().z() += WorldZDelta * 0.5;
+}
 
-	/* Make sure our grid is a float grid */
-	if (!ProfileGrid) {
-		UE_LOG(LogTemp, Error, TEXT("Grid in VDB file is not a float grid"));
-		return nullptr;
-	}
+bool LoadCloudVoxelsFromVDB(const FString& Filename, FCloudVoxels& OutVoxels) {
+	openvdb::FloatGrid::Ptr ProfileGrid, ScaleGrid;
+	openvdb::BBoxd WorldAABB;
+	if (!ReadCloudGrids(Filename, ProfileGrid, ScaleGrid, WorldAABB)) return false;
 
-	/* Create new volume texture assets */
-	UVaporCloud* CloudData = NewObject<UVaporCloud>(InParent, InName, Flags);
-	CloudData->DensityField = NewObject<UVolumeTexture>(CloudData,
-		*FString::Printf(TEXT("%s_DensityField"), *InName.ToString()));
-	CloudData->SignedDistanceField = NewObject<UVolumeTexture>(CloudData,
-		*FString::Printf(TEXT("%s_SignedDistanceField"), *InName.ToString()));
-		
-	/* Get the source volume textures */
-	UVolumeTexture& DensityTexture = *CloudData->DensityField;
-	UVolumeTexture& SDFTexture = *CloudData->SignedDistanceField;
+	/* Change the world X and Z extent to fit our texture dimensions */
+	FitWorldAABB(WorldAABB, VTEX_X, VTEX_Y, VTEX_Z);
 
 	/* Resample the density field */
-	const openvdb::FloatGrid::Ptr ResampledGrid = ResampleGrid(WorldAABB, *ProfileGrid, ScaleGrid, VTEX_X, VTEX_Y, VTEX_Z);
+	const openvdb::FloatGrid::Ptr ResampledGrid = ResampleGrid(WorldAABB, ProfileGrid, ScaleGrid, VTEX_X, VTEX_Y, VTEX_Z);
+
+	/* Create the dense voxel buffers from the resampled density field */
+	OutVoxels = CreateCloudVoxels(*ResampledGrid, FIntVector(VTEX_X, VTEX_Y, VTEX_Z));
+	return true;
+}
+
+bool LoadCloudTilesFromVDB(const FString& Filename, const FIntPoint& NumTiles, TFunctionRef<bool(const FIntPoint& Tile, const int32 LOD, const FCloudVoxels* Voxels)> OnTile) {
+	using namespace VaporCloudscape;
+
+	openvdb::FloatGrid::Ptr ProfileGrid, ScaleGrid;
+	openvdb::BBoxd WorldAABB;
+	if (!ReadCloudGrids(Filename, ProfileGrid, ScaleGrid, WorldAABB)) return false;
+
+	/* Change the world X and Z extent to fit the whole grid of tiles */
+	FitWorldAABB(WorldAABB, (double)NumTiles.X * VTEX_X, (double)NumTiles.Y * VTEX_Y, VTEX_Z);
+	const openvdb::Vec3d TileExtents = WorldAABB.extents() / openvdb::Vec3d(NumTiles.X, 1.0, NumTiles.Y);
+	const double GridVoxelSize = ProfileGrid->voxelSize()[0];
+
+	for (int32 LOD = 0; LOD < NumLODs; ++LOD) {
+		const FIntVector Resolution = GetTileResolution(LOD);
+		const FIntVector Physical = GetPhysicalSize(LOD);
+		const openvdb::Vec3d StepSizes = TileExtents / openvdb::Vec3d(Resolution.X, Resolution.Z, Resolution.Y);
+
+		/* Pre-filter the whole grid once per LOD, instead of once per tile */
+		const float ScaleFactor = (float)(std::max(std::max(StepSizes.x(), StepSizes.y()), StepSizes.z()) / GridVoxelSize);
+		const openvdb::FloatGrid::Ptr Filtered = PrefilterGrid(ProfileGrid, ScaleFactor);
+		const openvdb::FloatGrid::Ptr FilteredScale = PrefilterGrid(ScaleGrid, ScaleFactor);
+
+		for (int32 ty = 0; ty < NumTiles.Y; ++ty) {
+			for (int32 tx = 0; tx < NumTiles.X; ++tx) {
+				/* The tile region, extended by the apron which overlaps the neighbouring tiles */
+				openvdb::BBoxd Region;
+				Region.min() = WorldAABB.min() + openvdb::Vec3d(tx * TileExtents.x() - Apron * StepSizes.x(), 0.0, ty * TileExtents.z() - Apron * StepSizes.z());
+				Region.max() = Region.min() + openvdb::Vec3d(Physical.X * StepSizes.x(), TileExtents.y(), Physical.Y * StepSizes.z());
+				const openvdb::FloatGrid::Ptr Resampled = ResampleRegion(Region, *Filtered, FilteredScale, Physical.X, Physical.Y, Physical.Z);
+
+				/* Skip tiles without any cloud, they have no SDF either */
+				float MaxDensity = 0.0f;
+				for (openvdb::FloatGrid::ValueOnCIter It = Resampled->cbeginValueOn(); It; ++It) MaxDensity = FMath::Max(MaxDensity, *It);
+				if (MaxDensity <= 0.0001f) {
+					if (!OnTile(FIntPoint(tx, ty), LOD, nullptr)) return false;
+					continue;
+				}
 
-	/* Create the volume textures from the resampled density field */
-	CreateDensityTexture(DensityTexture, *ResampledGrid);
-	CreateSDFTexture(SDFTexture, *ResampledGrid);
+				const FCloudVoxels Voxels = CreateCloudVoxels(*Resampled, Physical);
+				if (!OnTile(FIntPoint(tx, ty), LOD, &Voxels)) return false;
+			}
+		}
+	}
+	return true;
+}
+
+UVaporCloud* UCloudscapeFactory::CreateVolumeTextureFromVDB(const FString& Filename, UObject* InParent, FName InName, EObjectFlags Flags) {
+	/* Load and resample the VDB file into dense voxel buffers */
+	FCloudVoxels Voxels;
+	if (!LoadCloudVoxelsFromVDB(Filename, Voxels)) return nullptr;
+
+	/* Create the cloud asset, with a volume texture for the precomputed lighting */
+	UVaporCloud* CloudData = NewObject<UVaporCloud>(InParent, InName, Flags);
+	CloudData->TransmittanceField = NewObject<UVolumeTexture>(CloudData,
+		*FString::Printf(TEXT("%s_TransmittanceField"), *InName.ToString()));
+	CreateTransmittanceTexture(*CloudData->TransmittanceField, Voxels);
+
+	/* Prefilter the field mips, distant samples cover several voxels and would alias at full resolution */
+	TArray<FCloudVoxels> Mips;
+	Mips.Add(Voxels);
+	while (Mips.Num() < UVaporCloud::MaxFieldMips) Mips.Add(Mips.Last().Downsample());
+	ValidateFieldMips(Mips);
+
+	/* Store the density and SDF as compressed fields, they're decoded on a worker thread when the cloud is loaded */
+	TArray<TArray<uint8>> DensityMips;
+	TArray<TArray<uint16>> SDFMips;
+	for (const FCloudVoxels& Mip : Mips) {
+		TArray<uint8>& Density = DensityMips.AddDefaulted_GetRef();
+		TArray<uint16>& SDF = SDFMips.AddDefaulted_GetRef();
+		Density.SetNumUninitialized(Mip.Density.Num());
+		SDF.SetNumUninitialized(Mip.SDF.Num());
+		for (int32 index = 0; index < Mip.Density.Num(); ++index) {
+			Density[index] = Mip.EncodeDensity(index);
+			SDF[index] = Mip.EncodeSDF(index);
+		}
+	}
+	CloudData->SetFields(Voxels.Size, DensityMips, SDFMips);
+	CloudData->LightCachePages = FindLightCachePages(Voxels);
+	CloudData->ProxyHull = BuildProxyHull(Voxels, CloudData->ProxyHullBricks, CloudData->ProxyHullOccupancy);
 
-	File.close(); /* Finally close the VDB file, and return */
 	return CloudData;
 }
 
@@ -0,0 +1,335 @@
+#include "PacketTrace.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Vapor/Public/VaporDensity.h"
+
+#if PLATFORM_CPU_X86_FAMILY
+#include <immintrin.h>
+
+/* Clang and GCC only emit AVX2 inside functions which ask for it, MSVC emits any intrinsic */
+#if defined(__clang__) || defined(__GNUC__)
+#define PACKET_AVX2 __attribute__((target("avx2")))
+#else
+#define PACKET_AVX2
+#endif
+#endif
+
+namespace {
+	constexpr int32 PacketWidth = 8;
+
+	TAutoConsoleVariable<int32> CVarPacketTrace(
+		TEXT("r.Vapor.PacketTrace"),
+		1,
+		TEXT("Trace the path density of offline bakes in ray packets when the CPU has AVX2 \n")
+		TEXT(" 0: OFF, trace every ray on its own;")
+		TEXT(" 1: ON. (default)"),
+		ECVF_Default);
+
+	/* Traversal state of a ray while it waits in the queue */
+	struct FRayState {
+		FVector3f Origin;
+		FVector3f Dir;
+		float Distance = 0.0f;
+		float PathDensity = 0.0f;
+		int32 Steps = 0;
+		int32 Ray = 0;
+	};
+
+	/** @brief Check if the CPU we run on has AVX2, the editor itself may be built for SSE only. */
+	bool HasAVX2() {
+#if PLATFORM_WINDOWS
+		return FPlatformMisc::HasAVX2InstructionSupport();
+#elif PLATFORM_CPU_X86_FAMILY && (defined(__clang__) || defined(__GNUC__))
+		return __builtin_cpu_supports("avx2");
+#else
+		return false;
+#endif
+	}
+
+#if PLATFORM_CPU_X86_FAMILY
+	/** @brief Lerp 8 lanes, in the same order as `FMath::Lerp`. */
+	PACKET_AVX2 FORCEINLINE __m256 Lerp8(const __m256 A, const __m256 B, const __m256 Alpha) {
+		return _mm256_add_ps(A, _mm256_mul_ps(Alpha, _mm256_sub_ps(B, A)));
+	}
+
+	/** @brief Floor 8 lanes into indices clamped to 0..Max. */
+	PACKET_AVX2 FORCEINLINE __m256i FloorClamp8(const __m256 Value, const int32 Max) {
+		const __m256i Index = _mm256_cvttps_epi32(_mm256_floor_ps(Value));
+		return _mm256_min_epi32(_mm256_max_epi32(Index, _mm256_setzero_si256()), _mm256_set1_epi32(Max));
+	}
+
+	/** @brief Trilinearly sample a voxel buffer at 8 points in voxel-space, like `FCloudVoxels::Sample`. */
+	PACKET_AVX2 __m256 SampleVoxels8(const float* Buffer, const FIntVector& Size, const __m256 X, const __m256 Y, const __m256 Z) {
+		const __m256 Half = _mm256_set1_ps(0.5f);
+		const __m256 Zero = _mm256_setzero_ps();
+		const __m256 One = _mm256_set1_ps(1.0f);
+		const __m256 TX = _mm256_sub_ps(X, Half);
+		const __m256 TY = _mm256_sub_ps(Y, Half);
+		const __m256 TZ = _mm256_sub_ps(Z, Half);
+
+		/* Clamped addressing, the upper corner stops at the last voxel */
+		const __m256i X0 = FloorClamp8(TX, Size.X - 1);
+		const __m256i Y0 = FloorClamp8(TY, Size.Y - 1);
+		const __m256i Z0 = FloorClamp8(TZ, Size.Z - 1);
+		const __m256i X1 = _mm256_min_epi32(_mm256_add_epi32(X0, _mm256_set1_epi32(1)), _mm256_set1_epi32(Size.X - 1));
+		const __m256i Y1 = _mm256_min_epi32(_mm256_add_epi32(Y0, _mm256_set1_epi32(1)), _mm256_set1_epi32(Size.Y - 1));
+		const __m256i Z1 = _mm256_min_epi32(_mm256_add_epi32(Z0, _mm256_set1_epi32(1)), _mm256_set1_epi32(Size.Z - 1));
+		const __m256 FX = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(TX, _mm256_cvtepi32_ps(X0)), Zero), One);
+		const __m256 FY = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(TY, _mm256_cvtepi32_ps(Y0)), Zero), One);
+		const __m256 FZ = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(TZ, _mm256_cvtepi32_ps(Z0)), Zero), One);
+
+		/* Buffer index of each row of the 2x2x2 block (x + y * X + z * X * Y) */
+		const __m256i StrideY = _mm256_set1_epi32(Size.X);
+		const __m256i StrideZ = _mm256_set1_epi32(Size.X * Size.Y);
+		const __m256i Row00 = _mm256_add_epi32(_mm256_mullo_epi32(Y0, StrideY), _mm256_mullo_epi32(Z0, StrideZ));
+		const __m256i Row10 = _mm256_add_epi32(_mm256_mullo_epi32(Y1, StrideY), _mm256_mullo_epi32(Z0, StrideZ));
+		const __m256i Row01 = _mm256_add_epi32(_mm256_mullo_epi32(Y0, StrideY), _mm256_mullo_epi32(Z1, StrideZ));
+		const __m256i Row11 = _mm256_add_epi32(_mm256_mullo_epi32(Y1, StrideY), _mm256_mullo_epi32(Z1, StrideZ));
+
+		const __m256 C00 = Lerp8(_mm256_i32gather_ps(Buffer, _mm256_add_epi32(Row00, X0), 4), _mm256_i32gather_ps(Buffer, _mm256_add_epi32(Row00, X1), 4), FX);
+		const __m256 C10 = Lerp8(_mm256_i32gather_ps(Buffer, _mm256_add_epi32(Row10, X0), 4), _mm256_i32gather_ps(Buffer, _mm256_add_epi32(Row10, X1), 4), FX);
+		const __m256 C01 = Lerp8(_mm256_i32gather_ps(Buffer, _mm256_add_epi32(Row01, X0), 4), _mm256_i32gather_ps(Buffer, _mm256_add_epi32(Row01, X1), 4), FX);
+		const __m256 C11 = Lerp8(_mm256_i32gather_ps(Buffer, _mm256_add_epi32(Row11, X0), 4), _mm256_i32gather_ps(Buffer, _mm256_add_epi32(Row11, X1), 4), FX);
+		return Lerp8(Lerp8(C00, C10, FY), Lerp8(C01, C11, FY), FZ);
+	}
+
+	/** @brief Look up the density scale of 8 lanes in the table, like `VaporDensity::SampleLUT`. */
+	PACKET_AVX2 __m256 SampleDensityLUT8(const float* LUT, const float LUTScale, const __m256 ErodedDensity, const __m256 StoredDensity) {
+		using namespace VaporDensity;
+		const __m256 Zero = _mm256_setzero_ps();
+		const __m256 One = _mm256_set1_ps(1.0f);
+		const __m256 X = _mm256_mul_ps(_mm256_sqrt_ps(_mm256_min_ps(_mm256_max_ps(ErodedDensity, Zero), One)), _mm256_set1_ps(LUTSizeX - 1));
+		const __m256 Y = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(StoredDensity, _mm256_set1_ps(LUTScale)), Zero), One), _mm256_set1_ps(LUTSizeY - 1));
+		const __m256i X0 = FloorClamp8(X, LUTSizeX - 2);
+		const __m256i Y0 = FloorClamp8(Y, LUTSizeY - 2);
+		const __m256 FX = _mm256_sub_ps(X, _mm256_cvtepi32_ps(X0));
+		const __m256 FY = _mm256_sub_ps(Y, _mm256_cvtepi32_ps(Y0));
+
+		const __m256i Row0 = _mm256_add_epi32(_mm256_mullo_epi32(Y0, _mm256_set1_epi32(LUTSizeX)), X0);
+		const __m256i Row1 = _mm256_add_epi32(Row0, _mm256_set1_epi32(LUTSizeX));
+		const __m256i Next = _mm256_set1_epi32(1);
+		const __m256 C0 = Lerp8(_mm256_i32gather_ps(LUT, Row0, 4), _mm256_i32gather_ps(LUT, _mm256_add_epi32(Row0, Next), 4), FX);
+		const __m256 C1 = Lerp8(_mm256_i32gather_ps(LUT, Row1, 4), _mm256_i32gather_ps(LUT, _mm256_add_epi32(Row1, Next), 4), FX);
+		return Lerp8(C0, C1, FY);
+	}
+
+	/** @brief Trace the queued rays in packets of 8, rays which outlive their packet are queued again. */
+	PACKET_AVX2 void TracePackets8(const FCloudVoxels& Voxels, const FTransmittanceBakeSettings& Settings, const TArray<float>& LUT, TArray<FRayState>& Queue, TArrayView<float> OutPathDensity, FPacketTraceStats& Stats) {
+		const float LUTScale = VaporDensity::GetLUTScale(Settings.Density);
+		const __m256 Step = _mm256_set1_ps(Settings.Step / UNITS_PER_VOXEL);
+		const __m256 MinSDFStep = _mm256_set1_ps(Settings.MinSDFStep / UNITS_PER_VOXEL);
+		const __m256 WorldStep = _mm256_set1_ps(Settings.Step);
+		const __m256 SDistToEroded = _mm256_set1_ps(-UNITS_PER_VOXEL / Settings.ProfileWidth);
+		const __m256 Zero = _mm256_setzero_ps();
+		const __m256 One = _mm256_set1_ps(1.0f);
+		const __m256 SizeX = _mm256_set1_ps((float)Voxels.Size.X);
+		const __m256 SizeY = _mm256_set1_ps((float)Voxels.Size.Y);
+		const __m256 SizeZ = _mm256_set1_ps((float)Voxels.Size.Z);
+		const __m256i MaxSteps = _mm256_set1_epi32(Settings.MaxSteps);
+
+		int32 Head = 0;
+		while (Head < Queue.Num()) {
+			/* Fill a packet from the front of the queue, lanes without a ray repeat the last one and start inactive */
+			const int32 NumLanes = FMath::Min(PacketWidth, Queue.Num() - Head);
+			alignas(32) float OX[PacketWidth], OY[PacketWidth], OZ[PacketWidth];
+			alignas(32) float DX[PacketWidth], DY[PacketWidth], DZ[PacketWidth];
+			alignas(32) float Distances[PacketWidth], PathDensities[PacketWidth];
+			alignas(32) int32 Steps[PacketWidth], Lanes[PacketWidth];
+			int32 RayIndices[PacketWidth];
+			for (int32 Lane = 0; Lane < PacketWidth; ++Lane) {
+				const FRayState& State = Queue[Head + FMath::Min(Lane, NumLanes - 1)];
+				OX[Lane] = State.Origin.X; OY[Lane] = State.Origin.Y; OZ[Lane] = State.Origin.Z;
+				DX[Lane] = State.Dir.X; DY[Lane] = State.Dir.Y; DZ[Lane] = State.Dir.Z;
+				Distances[Lane] = State.Distance;
+				PathDensities[Lane] = State.PathDensity;
+				Steps[Lane] = State.Steps;
+				Lanes[Lane] = Lane < NumLanes ? -1 : 0;
+				RayIndices[Lane] = State.Ray;
+			}
+			Head += NumLanes;
+			++Stats.NumPackets;
+
+			const __m256 OriginX = _mm256_load_ps(OX), OriginY = _mm256_load_ps(OY), OriginZ = _mm256_load_ps(OZ);
+			const __m256 DirX = _mm256_load_ps(DX), DirY = _mm256_load_ps(DY), DirZ = _mm256_load_ps(DZ);
+			__m256 Distance = _mm256_load_ps(Distances);
+			__m256 PathDensity = _mm256_load_ps(PathDensities);
+			__m256i StepCount = _mm256_load_si256((const __m256i*)Steps);
+			__m256 Active = _mm256_castsi256_ps(_mm256_load_si256((const __m256i*)Lanes));
+			bool bSplit = false;
+
+			for (;;) {
+				const __m256 PX = _mm256_add_ps(OriginX, _mm256_mul_ps(DirX, Distance));
+				const __m256 PY = _mm256_add_ps(OriginY, _mm256_mul_ps(DirY, Distance));
+				const __m256 PZ = _mm256_add_ps(OriginZ, _mm256_mul_ps(DirZ, Distance));
+
+				/* Rays are done once they leave the grid or run out of steps, like `FCloudVoxels::Contains` */
+				const __m256 InsideMin = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(PX, Zero, _CMP_GE_OQ), _mm256_cmp_ps(PY, Zero, _CMP_GE_OQ)), _mm256_cmp_ps(PZ, Zero, _CMP_GE_OQ));
+				const __m256 InsideMax = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(PX, SizeX, _CMP_LE_OQ), _mm256_cmp_ps(PY, SizeY, _CMP_LE_OQ)), _mm256_cmp_ps(PZ, SizeZ, _CMP_LE_OQ));
+				const __m256 HasSteps = _mm256_castsi256_ps(_mm256_cmpgt_epi32(MaxSteps, StepCount));
+				Active = _mm256_and_ps(Active, _mm256_and_ps(_mm256_and_ps(InsideMin, InsideMax), HasSteps));
+
+				const int32 NumActive = FMath::CountBits((uint64)_mm256_movemask_ps(Active));
+				if (NumActive == 0) break;
+
+				/* The rays have diverged, put the rest back into the queue rather than stepping mostly empty lanes */
+				if (NumActive <= PacketWidth / 2 && Head < Queue.Num()) {
+					bSplit = true;
+					break;
+				}
+				Stats.ActiveLaneSteps += NumActive;
+				Stats.TotalLaneSteps += PacketWidth;
+
+				/* No work to be done outside the volume, those lanes just keep stepping */
+				const __m256 SDist = SampleVoxels8(Voxels.SDF.GetData(), Voxels.Size, PX, PY, PZ);
+				const __m256 Outside = _mm256_cmp_ps(SDist, Zero, _CMP_GT_OQ);
+				const __m256 InCloud = _mm256_andnot_ps(Outside, Active);
+
+				/* Only sample the density if any lane is inside the volume */
+				if (_mm256_movemask_ps(InCloud) != 0) {
+					const __m256 DensityScale = SampleVoxels8(Voxels.Density.GetData(), Voxels.Size, PX, PY, PZ);
+					const __m256 ErodedDensity = _mm256_min_ps(One, _mm256_mul_ps(SDist, SDistToEroded));
+					const __m256 Density = SampleDensityLUT8(LUT.GetData(), LUTScale, ErodedDensity, DensityScale);
+					PathDensity = _mm256_add_ps(PathDensity, _mm256_and_ps(InCloud, _mm256_mul_ps(Density, WorldStep)));
+				}
+
+				const __m256 StepSize = _mm256_blendv_ps(Step, _mm256_max_ps(MinSDFStep, SDist), Outside);
+				Distance = _mm256_add_ps(Distance, _mm256_and_ps(Active, StepSize));
+				StepCount = _mm256_sub_epi32(StepCount, _mm256_castps_si256(Active));
+			}
+
+			/* Write out the finished rays, and queue the ones which are still going */
+			_mm256_store_ps(Distances, Distance);
+			_mm256_store_ps(PathDensities, PathDensity);
+			_mm256_store_si256((__m256i*)Steps, StepCount);
+			const int32 ActiveBits = bSplit ? _mm256_movemask_ps(Active) : 0;
+			for (int32 Lane = 0; Lane < NumLanes; ++Lane) {
+				if (ActiveBits & (1 << Lane)) {
+					FRayState State;
+					State.Origin = FVector3f(OX[Lane], OY[Lane], OZ[Lane]);
+					State.Dir = FVector3f(DX[Lane], DY[Lane], DZ[Lane]);
+					State.Distance = Distances[Lane];
+					State.PathDensity = PathDensities[Lane];
+					State.Steps = Steps[Lane];
+					State.Ray = RayIndices[Lane];
+					Queue.Add(State);
+				} else {
+					OutPathDensity[RayIndices[Lane]] = PathDensities[Lane];
+				}
+			}
+			Stats.NumSplits += bSplit ? 1 : 0;
+		}
+
+		/* Avoid the penalty of switching back to SSE code */
+		_mm256_zeroupper();
+	}
+#endif
+}
+
+int32 GetPacketWidth() {
+	static const bool bAVX2 = HasAVX2();
+	return bAVX2 && CVarPacketTrace.GetValueOnAnyThread() != 0 ? PacketWidth : 1;
+}
+
+void TracePathDensityPackets(const FCloudVoxels& Voxels, const FTransmittanceBakeSettings& Settings, TConstArrayView<FPacketRay> Rays, TArrayView<float> OutPathDensity, FPacketTraceStats* OutStats) {
+	check(Rays.Num() == OutPathDensity.Num());
+	FPacketTraceStats Stats;
+
+#if PLATFORM_CPU_X86_FAMILY
+	if (GetPacketWidth() == PacketWidth) {
+		TArray<float> LUT;
+		VaporDensity::BuildLUT(Settings.Density, LUT);
+
+		/* Rays are queued in order, so neighbouring rays share a packet */
+		TArray<FRayState> Queue;
+		Queue.Reserve(Rays.Num() + Rays.Num() / 2);
+		for (int32 i = 0; i < Rays.Num(); ++i) {
+			FRayState& State = Queue.AddDefaulted_GetRef();
+			State.Origin = Rays[i].Origin;
+			State.Dir = Rays[i].Dir;
+			State.Ray = i;
+		}
+		TracePackets8(Voxels, Settings, LUT, Queue, OutPathDensity, Stats);
+		if (OutStats) *OutStats = Stats;
+		return;
+	}
+#endif
+
+	for (int32 i = 0; i < Rays.Num(); ++i) {
+		OutPathDensity[i] = TracePathDensity(Voxels, Settings, Rays[i].Origin, Rays[i].Dir);
+	}
+	if (OutStats) *OutStats = Stats;
+}
+
+#if WITH_EDITOR
+namespace {
+	/** @brief Benchmark the packet trace against `TracePathDensity`, on the rays a transmittance bake of a VDB file would trace. */
+	void BenchmarkPacketTrace(const TArray<FString>& Args) {
+		if (Args.Num() < 1) {
+			UE_LOG(LogTemp, Warning, TEXT("Vapor: Usage: vapor.benchmarkpackets <file.vdb> [rays]"));
+			return;
+		}
+		const int32 MaxRays = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 262144;
+
+		FCloudVoxels Voxels;
+		if (!LoadCloudVoxelsFromVDB(Args[0], Voxels)) {
+			UE_LOG(LogTemp, Error, TEXT("Vapor: Failed to load \"%s\""), *Args[0]);
+			return;
+		}
+
+		/* Trace from the transmittance SH voxels inside the cloud, along the bake directions */
+		const FTransmittanceBakeSettings Settings;
+		const FIntVector Size = FIntVector::DivideAndRoundUp(Voxels.Size, Settings.Downsample);
+		const float Margin = (float)Settings.Downsample * UE_SQRT_3;
+		TArray<FPacketRay> Rays;
+		for (int32 z = 0; z < Size.Z && Rays.Num() < MaxRays; ++z) {
+			for (int32 y = 0; y < Size.Y && Rays.Num() < MaxRays; ++y) {
+				for (int32 x = 0; x < Size.X && Rays.Num() < MaxRays; ++x) {
+					const FVector3f Origin = (FVector3f(x, y, z) + 0.5f) * (float)Settings.Downsample;
+					if (Voxels.SampleSDF(Origin) > Margin) continue;
+					for (int32 i = 0; i < Settings.Directions && Rays.Num() < MaxRays; ++i) {
+						Rays.Add({ Origin, FibonacciSphere(i, Settings.Directions) });
+					}
+				}
+			}
+		}
+		if (Rays.Num() == 0) {
+			UE_LOG(LogTemp, Warning, TEXT("Vapor: \"%s\" holds no cloud to trace"), *Args[0]);
+			return;
+		}
+
+		/* Both run on this thread, so the speed-up is down to the packets alone */
+		TArray<float> Scalar, Packets;
+		Scalar.SetNumUninitialized(Rays.Num());
+		Packets.SetNumUninitialized(Rays.Num());
+		const double ScalarStart = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Rays.Num(); ++i) {
+			Scalar[i] = TracePathDensity(Voxels, Settings, Rays[i].Origin, Rays[i].Dir);
+		}
+		const double ScalarMs = (FPlatformTime::Seconds() - ScalarStart) * 1000.0;
+
+		FPacketTraceStats Stats;
+		const double PacketStart = FPlatformTime::Seconds();
+		TracePathDensityPackets(Voxels, Settings, Rays, Packets, &Stats);
+		const double PacketMs = (FPlatformTime::Seconds() - PacketStart) * 1000.0;
+
+		/* The packets look the density scale up in a table, the scalar trace evaluates it exactly */
+		float MaxPathDensity = 0.0f, MaxError = 0.0f;
+		for (int32 i = 0; i < Rays.Num(); ++i) {
+			MaxPathDensity = FMath::Max(MaxPathDensity, Scalar[i]);
+			MaxError = FMath::Max(MaxError, FMath::Abs(Packets[i] - Scalar[i]));
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("Vapor: Traced %d rays, scalar %.1f ms (%.2f Mrays/s), packets of %d %.1f ms (%.2f Mrays/s), %.2fx"),
+			Rays.Num(), ScalarMs, Rays.Num() / FMath::Max(ScalarMs * 1000.0, UE_DOUBLE_SMALL_NUMBER), GetPacketWidth(),
+			PacketMs, Rays.Num() / FMath::Max(PacketMs * 1000.0, UE_DOUBLE_SMALL_NUMBER), ScalarMs / FMath::Max(PacketMs, UE_DOUBLE_SMALL_NUMBER));
+		UE_LOG(LogTemp, Log, TEXT("Vapor: %lld packets, %lld splits, %.1f%% lane usage, max error %.3f%% of the largest path density"),
+			Stats.NumPackets, Stats.NumSplits, 100.0 * Stats.ActiveLaneSteps / FMath::Max(Stats.TotalLaneSteps, (int64)1),
+			100.0f * MaxError / FMath::Max(MaxPathDensity, UE_SMALL_NUMBER));
+	}
+
+	FAutoConsoleCommand CmdBenchmarkPackets(
+		TEXT("vapor.benchmarkpackets"),
+		TEXT("Trace the path density of a VDB file with and without ray packets, and log the speed-up and the error: <file.vdb> [rays]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkPacketTrace));
+}
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CloudVoxels.h"
+#include "TransmittanceBake.h"
+
+/* Ray of a packet trace, in voxel-space like `TracePathDensity`. */
+struct FPacketRay {
+	FVector3f Origin = FVector3f::ZeroVector;
+	FVector3f Dir = FVector3f::ZeroVector;
+};
+
+/* Lane usage of a packet trace. */
+struct FPacketTraceStats {
+	int64 NumPackets = 0;
+	int64 NumSplits = 0;       /* Packets whose remaining rays went back into the queue */
+	int64 ActiveLaneSteps = 0; /* Steps taken by lanes which still had a ray */
+	int64 TotalLaneSteps = 0;  /* Steps taken by all lanes */
+};
+
+/** @brief Get the number of rays traced together by `TracePathDensityPackets`, 8 if the CPU has AVX2 and 1 otherwise or with `r.Vapor.PacketTrace 0`. */
+int32 GetPacketWidth();
+
+/**
+ * @brief Trace the path density along many rays, in packets of 8 rays with AVX2. (in world units)
+ * This follows `TracePathDensity`, but looks the density scale up in the `VaporDensity` table like the GPU does.
+ * Each lane skips empty space by its own SDF, and the density is only sampled if any lane of the packet is inside the cloud.
+ * Once half the lanes of a packet are done, the rest go back into the queue and are packed together with other rays.
+ * Without AVX2 every ray is traced by `TracePathDensity`.
+ */
+void TracePathDensityPackets(const FCloudVoxels& Voxels, const FTransmittanceBakeSettings& Settings, TConstArrayView<FPacketRay> Rays, TArrayView<float> OutPathDensity, FPacketTraceStats* OutStats = nullptr);
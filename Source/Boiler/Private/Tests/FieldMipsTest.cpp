@@ -0,0 +1,82 @@
+#include "Misc/AutomationTest.h"
+#include "CloudVoxels.h"
+#include "VaporCloud.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVaporFieldMipsTest, "Vapor.FieldMips",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace {
+	/* Spheres of different sizes (xyz center, w radius, in voxels), down to ones thinner than the coarsest mip */
+	const FVector4f Spheres[] = {
+		FVector4f(32.0f, 32.0f, 16.0f, 12.0f),
+		FVector4f(48.0f, 24.0f, 12.0f, 6.0f),
+		FVector4f(16.0f, 44.0f, 20.0f, 3.0f),
+		FVector4f(40.0f, 50.0f, 8.0f, 1.5f),
+	};
+
+	/* Exact signed distance to the spheres, in voxels */
+	float SphereSDF(const FVector3f& Point) {
+		float Distance = UE_BIG_NUMBER;
+		for (const FVector4f& Sphere : Spheres) {
+			Distance = FMath::Min(Distance, FVector3f::Distance(Point, FVector3f(Sphere)) - Sphere.W);
+		}
+		return Distance;
+	}
+
+	/* Field mips of the spheres, built like the importer does */
+	TArray<FCloudVoxels> MakeSphereMips() {
+		FCloudVoxels Voxels;
+		Voxels.Init(FIntVector(64, 64, 32));
+		for (int32 z = 0; z < Voxels.Size.Z; ++z) {
+			for (int32 y = 0; y < Voxels.Size.Y; ++y) {
+				for (int32 x = 0; x < Voxels.Size.X; ++x) {
+					const float SDF = SphereSDF(FVector3f(x + 0.5f, y + 0.5f, z + 0.5f));
+					Voxels.SDF[Voxels.Index(x, y, z)] = SDF;
+					Voxels.Density[Voxels.Index(x, y, z)] = FMath::Clamp(-SDF / 4.0f, 0.0f, 1.0f);
+				}
+			}
+		}
+
+		TArray<FCloudVoxels> Mips;
+		Mips.Add(MoveTemp(Voxels));
+		while (Mips.Num() < UVaporCloud::MaxFieldMips) Mips.Add(Mips.Last().Downsample());
+		return Mips;
+	}
+}
+
+bool FVaporFieldMipsTest::RunTest(const FString& Parameters) {
+	const TArray<FCloudVoxels> Mips = MakeSphereMips();
+
+	{ /* Each mip is closer to the footprint reference than an unfiltered sample, and its SDF stays within the slack */
+		const TArray<FFieldMipError> Errors = ValidateFieldMips(Mips);
+		for (int32 Mip = 1; Mip < Mips.Num(); ++Mip) {
+			const FFieldMipError& Error = Errors[Mip];
+			if (!TestTrue(FString::Printf(TEXT("Mip %d has points near the cloud"), Mip), Error.NumPoints > 0)) continue;
+			TestTrue(FString::Printf(TEXT("Mip %d density is closer to the reference than mip 0"), Mip), Error.MipError < Error.BaseError);
+			TestTrue(FString::Printf(TEXT("Mip %d SDF overestimate is within the slack"), Mip), Error.SDFOverestimate <= UVaporCloud::GetMipSlack((float)Mip));
+		}
+	}
+
+	{ /* Between mips the shader blends two of them, the slack still never lets a skip pass through the surface */
+		FRandomStream Random(0x51AC);
+		const FIntVector Size = Mips[0].Size;
+		for (const float Mip : { 0.0f, 0.5f, 1.0f, 1.5f, 2.0f }) {
+			const int32 Fine = FMath::FloorToInt32(Mip), Coarse = FMath::Min(Fine + 1, Mips.Num() - 1);
+			float WorstSkip = -UE_BIG_NUMBER;
+			for (int32 i = 0; i < 4096; ++i) {
+				const FVector3f Point(Random.FRand() * Size.X, Random.FRand() * Size.Y, Random.FRand() * Size.Z);
+				const float FineSDF = Mips[Fine].SampleSDF(Point / (float)(1 << Fine));
+				const float CoarseSDF = Mips[Coarse].SampleSDF(Point / (float)(1 << Coarse));
+				const float Skip = FMath::Lerp(FineSDF, CoarseSDF, Mip - Fine) - UVaporCloud::GetMipSlack(Mip);
+				WorstSkip = FMath::Max(WorstSkip, Skip - SphereSDF(Point));
+			}
+			TestTrue(FString::Printf(TEXT("Skip distance at mip %.1f stays in front of the surface (%.2f voxels past it)"), Mip, WorstSkip), WorstSkip <= 0.0f);
+		}
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,108 @@
+#include "Misc/AutomationTest.h"
+#include "HAL/IConsoleManager.h"
+#include "PacketTrace.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVaporPacketTraceTest, "Vapor.PacketTrace",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace {
+	/* Ball of cloud in the middle of the grid, with an exact SDF and a density falling off towards its edge */
+	FCloudVoxels MakeBallVoxels() {
+		FCloudVoxels Voxels;
+		Voxels.Init(FIntVector(48, 48, 32));
+		const FVector3f Center(24.0f, 24.0f, 16.0f);
+		for (int32 z = 0; z < Voxels.Size.Z; ++z) {
+			for (int32 y = 0; y < Voxels.Size.Y; ++y) {
+				for (int32 x = 0; x < Voxels.Size.X; ++x) {
+					const float SDF = FVector3f::Distance(FVector3f(x + 0.5f, y + 0.5f, z + 0.5f), Center) - 12.0f;
+					Voxels.SDF[Voxels.Index(x, y, z)] = SDF;
+					Voxels.Density[Voxels.Index(x, y, z)] = FMath::Clamp(-SDF / 6.0f, 0.0f, 1.0f);
+				}
+			}
+		}
+		return Voxels;
+	}
+
+	/*
+	 * Rays which diverge inside every packet, every other ray starts on the edge of the grid and leaves it right away.
+	 * The count is not a multiple of the packet width, so the last packet is partial.
+	 */
+	TArray<FPacketRay> MakeDivergingRays(const FCloudVoxels& Voxels, const int32 NumRays) {
+		TArray<FPacketRay> Rays;
+		for (int32 i = 0; i < NumRays; ++i) {
+			if (i & 1) {
+				Rays.Add({ FVector3f(0.5f, 0.5f + i % Voxels.Size.Y, 0.5f), FVector3f(-1.0f, 0.0f, 0.0f) });
+			} else {
+				Rays.Add({ FVector3f(Voxels.Size) * 0.5f, FibonacciSphere(i, NumRays) });
+			}
+		}
+		return Rays;
+	}
+
+	/* Trace the rays with packets and without, and compare the path densities */
+	void CompareToScalar(FAutomationTestBase& Test, const FString& What, const FCloudVoxels& Voxels, const FTransmittanceBakeSettings& Settings,
+		const TArray<FPacketRay>& Rays, FPacketTraceStats& OutStats, float& OutMaxError) {
+		TArray<float> Packets;
+		Packets.Init(-1.0f, Rays.Num());
+		TracePathDensityPackets(Voxels, Settings, Rays, Packets, &OutStats);
+
+		/* The packets look the density scale up in a table, the scalar trace evaluates it exactly */
+		float MaxPathDensity = 0.0f;
+		OutMaxError = 0.0f;
+		for (int32 i = 0; i < Rays.Num(); ++i) {
+			const float Scalar = TracePathDensity(Voxels, Settings, Rays[i].Origin, Rays[i].Dir);
+			if (Packets[i] < 0.0f) {
+				Test.AddError(FString::Printf(TEXT("%s: ray %d was never written"), *What, i));
+				return;
+			}
+			MaxPathDensity = FMath::Max(MaxPathDensity, Scalar);
+			OutMaxError = FMath::Max(OutMaxError, FMath::Abs(Packets[i] - Scalar));
+		}
+		Test.TestTrue(FString::Printf(TEXT("%s: rays pass through the cloud"), *What), MaxPathDensity > 0.0f);
+		Test.TestTrue(FString::Printf(TEXT("%s: path density within 1%% of the scalar trace (%.4f of %.1f)"), *What, OutMaxError, MaxPathDensity),
+			OutMaxError <= 0.01f * MaxPathDensity);
+	}
+}
+
+bool FVaporPacketTraceTest::RunTest(const FString& Parameters) {
+	const FCloudVoxels Voxels = MakeBallVoxels();
+	FTransmittanceBakeSettings Settings;
+	Settings.Density = 1.0f;
+
+	IConsoleVariable* CVarPacketTrace = IConsoleManager::Get().FindConsoleVariable(TEXT("r.Vapor.PacketTrace"));
+	if (!TestNotNull(TEXT("Packet trace console variable"), CVarPacketTrace)) return false;
+	const int32 PacketTrace = CVarPacketTrace->GetInt();
+
+	{ /* Packets match the scalar trace, diverged rays go back into the queue, and the partial last packet is written out */
+		CVarPacketTrace->Set(1, ECVF_SetByCode);
+		const TArray<FPacketRay> Rays = MakeDivergingRays(Voxels, 8 * 16 + 3);
+		FPacketTraceStats Stats;
+		float MaxError;
+		CompareToScalar(*this, TEXT("Packets"), Voxels, Settings, Rays, Stats, MaxError);
+		if (GetPacketWidth() == 8) {
+			TestTrue(TEXT("Diverged packets were split"), Stats.NumSplits > 0);
+			TestTrue(TEXT("Every ray was packed"), Stats.NumPackets >= FMath::DivideAndRoundUp(Rays.Num(), 8));
+			TestTrue(TEXT("Lane usage is counted"), Stats.ActiveLaneSteps > 0 && Stats.ActiveLaneSteps <= Stats.TotalLaneSteps);
+		} else {
+			AddInfo(TEXT("This CPU has no AVX2, only the scalar fallback was tested"));
+		}
+	}
+
+	{ /* Without packets every ray is traced on its own, and gives exactly the scalar result */
+		CVarPacketTrace->Set(0, ECVF_SetByCode);
+		TestEqual(TEXT("Fallback packet width"), GetPacketWidth(), 1);
+		const TArray<FPacketRay> Rays = MakeDivergingRays(Voxels, 37);
+		FPacketTraceStats Stats;
+		float MaxError;
+		CompareToScalar(*this, TEXT("Fallback"), Voxels, Settings, Rays, Stats, MaxError);
+		TestEqual(TEXT("Fallback traces no packets"), Stats.NumPackets, (int64)0);
+		TestEqual(TEXT("Fallback matches the scalar trace exactly"), MaxError, 0.0f);
+	}
+
+	CVarPacketTrace->Set(PacketTrace, ECVF_SetByCode);
+	return true;
+}
+
+#endif
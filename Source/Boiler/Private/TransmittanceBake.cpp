@@ -0,0 +1,95 @@
+#include "TransmittanceBake.h"
+
+#include "Async/ParallelFor.h"
+#include "Vapor/Public/VaporDensity.h"
+
+/* Real spherical harmonics coefficients. */
+/* Source: <https://en.wikipedia.org/wiki/Table_of_spherical_harmonics#Real_spherical_harmonics> */
+constexpr float SH_C0 = 0.282095f; // k = (0.5 * sqrt(1.0 / PI))
+constexpr float SH_C1 = 0.488603f; // k = (sqrt(3.0 / (4.0 * PI)))
+
+FVector3f FibonacciSphere(const int32 Step, const int32 Steps) {
+	/* Source: <https://stackoverflow.com/questions/9600801/evenly-distributing-n-points-on-a-sphere> */
+	constexpr float GOLDEN_RATIO = 1.618033988749895f;
+	const float Theta = 2.0f * UE_PI * (float)Step / GOLDEN_RATIO;
+	const float Phi = FMath::Acos(1.0f - 2.0f * ((float)Step + 0.5f) / (float)Steps);
+	const float SinPhi = FMath::Sin(Phi);
+	return FVector3f(FMath::Cos(Theta) * SinPhi, FMath::Sin(Theta) * SinPhi, FMath::Cos(Phi)).GetSafeNormal();
+}
+
+/** @brief Rough cloud density at a voxel, mirrors `SampleCloudRough` in "Cloud.ush". */
+static float SampleRoughDensity(const FTransmittanceBakeSettings& Settings, const float SDist, const float DensityScale) {
+	const float DimensionalProfile = FMath::Min(1.0f, -SDist / Settings.ProfileWidth);
+	return VaporDensity::Transform(DimensionalProfile, DensityScale * Settings.Density);
+}
+
+float TracePathDensity(const FCloudVoxels& Voxels, const FTransmittanceBakeSettings& Settings, const FVector3f& Origin, const FVector3f& Dir) {
+	const float Step = Settings.Step / UNITS_PER_VOXEL;
+	const float MinSDFStep = Settings.MinSDFStep / UNITS_PER_VOXEL;
+
+	float Distance = 0.0f;
+	float PathDensity = 0.0f;
+	for (int32 s = 0; s < Settings.MaxSteps; ++s) {
+		const FVector3f SamplePos = Origin + Dir * Distance;
+		if (!Voxels.Contains(SamplePos)) break;
+
+		/* No work to be done outside the volume, just keep stepping */
+		const float SDist = Voxels.SampleSDF(SamplePos);
+		if (SDist > 0.0f) {
+			Distance += FMath::Max(MinSDFStep, SDist);
+			continue;
+		}
+		Distance += Step;
+
+		/* We're inside the volume, accumulate density */
+		const float DensityScale = Voxels.SampleDensity(SamplePos);
+		PathDensity += SampleRoughDensity(Settings, SDist * UNITS_PER_VOXEL, DensityScale) * Settings.Step;
+	}
+
+	return PathDensity;
+}
+
+FIntVector BakeTransmittanceSH(const FCloudVoxels& Voxels, const FTransmittanceBakeSettings& Settings, TArray<FFloat16Color>& OutSH) {
+	const FIntVector Size = FIntVector::DivideAndRoundUp(Voxels.Size, Settings.Downsample);
+	OutSH.SetNumZeroed(Size.X * Size.Y * Size.Z);
+
+	/* Pre-compute the integration directions */
+	TArray<FVector3f> Directions;
+	Directions.SetNum(Settings.Directions);
+	for (int32 i = 0; i < Settings.Directions; ++i) {
+		Directions[i] = FibonacciSphere(i, Settings.Directions);
+	}
+
+	/* Monte-Carlo weight of each direction, (4 * PI / N) */
+	const float Weight = 4.0f * UE_PI / (float)Settings.Directions;
+
+	/* SH voxels this far outside the cloud are never sampled, (except through bilinear filtering) */
+	const float Margin = (float)Settings.Downsample * UE_SQRT_3;
+
+	/* Bake one row of SH voxels per task */
+	ParallelFor(Size.Y * Size.Z, [&](const int32 Row) {
+		const int32 y = Row % Size.Y;
+		const int32 z = Row / Size.Y;
+
+		for (int32 x = 0; x < Size.X; ++x) {
+			const FVector3f Origin = (FVector3f(x, y, z) + 0.5f) * (float)Settings.Downsample;
+
+			/* Skip voxels which lie outside the cloud */
+			if (Voxels.SampleSDF(Origin) > Margin) continue;
+
+			/* Integrate the path density over the sphere */
+			FVector4f SH1 = FVector4f(0.0f, 0.0f, 0.0f, 0.0f);
+			for (const FVector3f& Dir : Directions) {
+				const float PathDensity = TracePathDensity(Voxels, Settings, Origin, Dir) / UNITS_PER_VOXEL;
+				SH1.X += PathDensity * SH_C0;
+				SH1.Y += PathDensity * (SH_C1 * Dir.X);
+				SH1.Z += PathDensity * (SH_C1 * Dir.Y);
+				SH1.W += PathDensity * (SH_C1 * Dir.Z);
+			}
+
+			OutSH[x + (y * Size.X) + (z * Size.X * Size.Y)] = FFloat16Color(FLinearColor(SH1.X * Weight, SH1.Y * Weight, SH1.Z * Weight, SH1.W * Weight));
+		}
+	});
+
+	return Size;
+}
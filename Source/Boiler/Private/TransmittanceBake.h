@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CloudVoxels.h"
+
+/* Settings used while baking the transmittance volume, these mirror the `UVaporComponent` defaults. */
+struct FTransmittanceBakeSettings {
+	/* Number of voxels of the cloud grid covered by a single SH voxel */
+	int32 Downsample = 4;
+	/* Number of directions integrated per SH voxel (Fibonacci sphere) */
+	int32 Directions = 64;
+	/* Maximum number of steps taken along a single direction */
+	int32 MaxSteps = 512;
+
+	float Density = 0.01f;
+	float ProfileWidth = 16000.0f; // cm
+	float Step = 800.0f; // cm
+	float MinSDFStep = 200.0f; // cm
+};
+
+/**
+ * @brief Bake an L1 spherical harmonics volume of the path density around each voxel.
+ * Each SH voxel stores { L00, L1-1, L10, L11 } of the path density (in voxels) for the directions (x, y, z).
+ * @return The size of the baked SH volume.
+ */
+FIntVector BakeTransmittanceSH(const FCloudVoxels& Voxels, const FTransmittanceBakeSettings& Settings, TArray<FFloat16Color>& OutSH);
+
+/** @brief Trace the path density along a ray through the cloud, using the SDF to skip empty space. (in world units) */
+float TracePathDensity(const FCloudVoxels& Voxels, const FTransmittanceBakeSettings& Settings, const FVector3f& Origin, const FVector3f& Dir);
+
+/** @brief Generate equidistant points on the unit sphere. */
+FVector3f FibonacciSphere(const int32 Step, const int32 Steps);
@@ -0,0 +1,31 @@
+#pragma once
+
+#if WITH_EDITOR
+
+#include "CoreMinimal.h"
+#include "Factories/Factory.h"
+#include "Vapor/Public/VaporCloudSequence.h"
+
+#include "CloudSequenceFactory.generated.h"
+
+/**
+ * Responsible for importing animated cloud sequences.
+ * A ".vdbseq" file lists one VDB file per line, relative to the sequence file, optionally preceded by a "fps=24" line.
+ */
+UCLASS()
+class UCloudSequenceFactory : public UFactory {
+	GENERATED_UCLASS_BODY()
+
+public:
+	FText GetDisplayName() const override;
+
+	virtual UObject* FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags, const FString& Filename,
+		const TCHAR* Parms, FFeedbackContext* Warn, bool& bOutOperationCanceled) override;
+
+	virtual bool FactoryCanImport(const FString& Filename) override;
+
+private:
+	UVaporCloudSequence* CreateSequenceFromVDBs(const FString& Filename, UObject* InParent, FName InName, EObjectFlags Flags, bool& bOutOperationCanceled);
+};
+
+#endif // WITH_EDITOR
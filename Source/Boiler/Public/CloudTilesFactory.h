@@ -0,0 +1,31 @@
+#pragma once
+
+#if WITH_EDITOR
+
+#include "CoreMinimal.h"
+#include "Factories/Factory.h"
+#include "Vapor/Public/VaporCloudscape.h"
+
+#include "CloudTilesFactory.generated.h"
+
+/**
+ * Responsible for importing world-scale tiled cloudscapes.
+ * A ".vdbtiles" file has a "tiles=10 10" line with the number of tiles, and a "source=world.vdb" line relative to itself.
+ */
+UCLASS()
+class UCloudTilesFactory : public UFactory {
+	GENERATED_UCLASS_BODY()
+
+public:
+	FText GetDisplayName() const override;
+
+	virtual UObject* FactoryCreateFile(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags, const FString& Filename,
+		const TCHAR* Parms, FFeedbackContext* Warn, bool& bOutOperationCanceled) override;
+
+	virtual bool FactoryCanImport(const FString& Filename) override;
+
+private:
+	UVaporCloudscape* CreateCloudscapeFromVDB(const FString& Filename, UObject* InParent, FName InName, EObjectFlags Flags, bool& bOutOperationCanceled);
+};
+
+#endif // WITH_EDITOR
@@ -0,0 +1,84 @@
+#include "Misc/AutomationTest.h"
+#include "VaporCostStats.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVaporCostStatsTest, "Vapor.CostStats",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FVaporCostStatsTest::RunTest(const FString& Parameters) {
+	using namespace VaporCostStats;
+
+	{ /* Without any rays the summary stays empty */
+		TArray<uint32> Counters;
+		Counters.SetNumZeroed(NumCounters);
+		const FVaporCostSummary Summary = FVaporCostSummary::FromCounters(Counters.GetData());
+		TestEqual(TEXT("Empty rays"), Summary.NumRays, 0);
+		TestEqual(TEXT("Empty p95"), Summary.P95[PrimarySteps], 0);
+		TestEqual(TEXT("Empty max"), Summary.Max[PrimarySteps], 0);
+		TestEqual(TEXT("Empty opaque"), Summary.TerminationPct[Opaque], 0.0f);
+	}
+
+	{ /* 100 rays, most take few steps, a handful take more and one runs past the last bin */
+		TArray<uint32> Counters;
+		Counters.SetNumZeroed(NumCounters);
+		uint32* Steps = &Counters[PrimarySteps * NumBins];
+		Steps[0] = 90;
+		Steps[2] = 5;
+		Steps[5] = 4;
+		Steps[NumBins - 1] = 1;
+		Counters[TotalOffset + PrimarySteps] = 1234;
+
+		/* Every ray skips once or twice */
+		Counters[SDFSkips * NumBins + 0] = 100;
+		Counters[TotalOffset + SDFSkips] = 150;
+
+		Counters[TerminationOffset + Missed] = 10;
+		Counters[TerminationOffset + Exited] = 60;
+		Counters[TerminationOffset + Opaque] = 25;
+		Counters[TerminationOffset + Exhausted] = 5;
+
+		const FVaporCostSummary Summary = FVaporCostSummary::FromCounters(Counters.GetData());
+		TestEqual(TEXT("Rays are counted by their termination"), Summary.NumRays, 100);
+		TestEqual(TEXT("Mean steps"), Summary.Mean[PrimarySteps], 12.34f, 1e-4f);
+		TestEqual(TEXT("Mean skips"), Summary.Mean[SDFSkips], 1.5f, 1e-4f);
+
+		/* The 95th ray falls into the third bin, reported by its upper edge */
+		TestEqual(TEXT("P95 steps"), Summary.P95[PrimarySteps], 3 * BinWidth);
+		TestEqual(TEXT("Max steps is the upper edge of the last bin"), Summary.Max[PrimarySteps], NumBins * BinWidth);
+		TestEqual(TEXT("P95 skips"), Summary.P95[SDFSkips], BinWidth);
+		TestEqual(TEXT("Max skips"), Summary.Max[SDFSkips], BinWidth);
+		TestEqual(TEXT("Metrics without counts have no p95"), Summary.P95[CacheLookups], 0);
+		TestEqual(TEXT("Metrics without counts have no max"), Summary.Max[CacheLookups], 0);
+
+		TestEqual(TEXT("Missed %"), Summary.TerminationPct[Missed], 10.0f, 1e-4f);
+		TestEqual(TEXT("Exited %"), Summary.TerminationPct[Exited], 60.0f, 1e-4f);
+		TestEqual(TEXT("Opaque %"), Summary.TerminationPct[Opaque], 25.0f, 1e-4f);
+		TestEqual(TEXT("Exhausted %"), Summary.TerminationPct[Exhausted], 5.0f, 1e-4f);
+	}
+
+	{ /* The percentile is rounded up, 94 of 99 rays is not 95% */
+		TArray<uint32> Counters;
+		Counters.SetNumZeroed(NumCounters);
+		Counters[PrimarySteps * NumBins + 0] = 94;
+		Counters[PrimarySteps * NumBins + 7] = 5;
+		Counters[TerminationOffset + Exited] = 99;
+		const FVaporCostSummary Summary = FVaporCostSummary::FromCounters(Counters.GetData());
+		TestEqual(TEXT("Rounded up p95"), Summary.P95[PrimarySteps], 8 * BinWidth);
+		TestEqual(TEXT("Rounded up max"), Summary.Max[PrimarySteps], 8 * BinWidth);
+	}
+
+	{ /* The per-pixel cost unpacks into its counts and termination */
+		const uint32 Packed = 37u | (12u << 9) | (300u << 18) | ((uint32)Opaque << 28);
+		int32 Counts[NumMetrics], Termination;
+		UnpackCost(Packed, Counts, Termination);
+		TestEqual(TEXT("Unpacked steps"), Counts[PrimarySteps], 37);
+		TestEqual(TEXT("Unpacked skips"), Counts[SDFSkips], 12);
+		TestEqual(TEXT("Unpacked lookups"), Counts[CacheLookups], 300);
+		TestEqual(TEXT("Unpacked termination"), Termination, (int32)Opaque);
+	}
+
+	return true;
+}
+
+#endif
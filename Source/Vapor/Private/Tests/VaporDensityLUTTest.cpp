@@ -0,0 +1,74 @@
+#include "Misc/AutomationTest.h"
+#include "VaporDensity.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVaporDensityLUTTest, "Vapor.DensityLUT",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace {
+	/* Eroded densities to check, evenly spaced and down to the steep start of the curve near zero */
+	TArray<float> GetErodedDensities() {
+		TArray<float> Values;
+		for (int32 i = 0; i <= 256; ++i) Values.Add((float)i / 256.0f);
+		for (int32 i = 0; i <= 64; ++i) Values.Add(FMath::Pow(10.0f, -6.0f + 4.0f * i / 64.0f));
+		return Values;
+	}
+}
+
+bool FVaporDensityLUTTest::RunTest(const FString& Parameters) {
+	const TArray<float> ErodedDensities = GetErodedDensities();
+
+	{ /* The table stays within a fraction of a percent of the reference curve, for thin and thick clouds */
+		for (const float Density : { 0.25f, 0.5f, 1.0f, 2.0f, 4.0f, 8.0f }) {
+			TArray<float> LUT;
+			VaporDensity::BuildLUT(Density, LUT);
+			TestEqual(TEXT("Table size"), LUT.Num(), VaporDensity::LUTSizeX * VaporDensity::LUTSizeY);
+
+			double MaxError = 0.0, SumError = 0.0;
+			int32 NumSamples = 0;
+			for (int32 s = 0; s <= 128; ++s) {
+				const float StoredDensity = (float)s / 128.0f;
+				for (const float Eroded : ErodedDensities) {
+					const float Reference = VaporDensity::Transform(Eroded, StoredDensity * Density);
+					const double Error = FMath::Abs(VaporDensity::SampleLUT(LUT, Density, Eroded, StoredDensity) - Reference);
+					MaxError = FMath::Max(MaxError, Error);
+					SumError += Error;
+					NumSamples++;
+				}
+			}
+			AddInfo(FString::Printf(TEXT("Density %.2f: max error %.5f, mean error %.6f"), Density, MaxError, SumError / NumSamples));
+			TestTrue(FString::Printf(TEXT("Density %.2f max error is below 0.005"), Density), MaxError < 0.005);
+			TestTrue(FString::Printf(TEXT("Density %.2f mean error is below 0.001"), Density), SumError / NumSamples < 0.001);
+		}
+	}
+
+	{ /* Stored densities past 1 / Density saturate, the table holds the saturated row */
+		TArray<float> LUT;
+		VaporDensity::BuildLUT(4.0f, LUT);
+		TestEqual(TEXT("Saturated density"), VaporDensity::SampleLUT(LUT, 4.0f, 0.5f, 0.9f), VaporDensity::Transform(0.5f, 1.0f), 1e-3f);
+	}
+
+	{ /* Time both on the CPU, for reference next to the GPU instruction counts in the readme */
+		constexpr int32 NumSamples = 1 << 20;
+		TArray<float> LUT;
+		VaporDensity::BuildLUT(1.0f, LUT);
+		FRandomStream Random(0xD315);
+		TArray<FVector2f> Inputs;
+		Inputs.SetNumUninitialized(NumSamples);
+		for (FVector2f& Input : Inputs) Input = FVector2f(Random.FRand(), Random.FRand());
+
+		float Sum = 0.0f;
+		const double ReferenceStart = FPlatformTime::Seconds();
+		for (const FVector2f& Input : Inputs) Sum += VaporDensity::Transform(Input.X, Input.Y);
+		const double LUTStart = FPlatformTime::Seconds();
+		for (const FVector2f& Input : Inputs) Sum += VaporDensity::SampleLUT(LUT, 1.0f, Input.X, Input.Y);
+		const double End = FPlatformTime::Seconds();
+		AddInfo(FString::Printf(TEXT("%d samples: pow %.2f ms, table %.2f ms (checksum %.1f)"),
+			NumSamples, (LUTStart - ReferenceStart) * 1000.0, (End - LUTStart) * 1000.0, Sum));
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,55 @@
+#include "Misc/AutomationTest.h"
+#include "VDBLoader.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVaporNoiseLodTest, "Vapor.NoiseLod",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace {
+	/* Deviation of a channel from its mean, at full resolution and averaged over the texels of a noise mip. (RMS) */
+	void GetNoiseDeviation(const TArray<uint8>& Texels, const int32 Channel, const float Mean, const int32 Mip, double& OutFull, double& OutMip) {
+		using namespace VaporNoise;
+		const int32 Block = 1 << Mip;
+		const int32 MipRes = Resolution / Block;
+
+		double FullSum = 0.0, MipSum = 0.0;
+		for (int32 bz = 0; bz < MipRes; ++bz) for (int32 by = 0; by < MipRes; ++by) for (int32 bx = 0; bx < MipRes; ++bx) {
+			/* A mip texel is the plain average of its block, like `TMGS_SimpleAverage` */
+			double BlockSum = 0.0;
+			for (int32 z = 0; z < Block; ++z) for (int32 y = 0; y < Block; ++y) for (int32 x = 0; x < Block; ++x) {
+				const int32 Index = (bx * Block + x) + (by * Block + y) * Resolution + (bz * Block + z) * Resolution * Resolution;
+				const double Value = Texels[Index * 4 + Channel] / 255.0;
+				FullSum += FMath::Square(Value - Mean);
+				BlockSum += Value;
+			}
+			MipSum += FMath::Square(BlockSum / (Block * Block * Block) - Mean);
+		}
+		OutFull = FMath::Sqrt(FullSum / (Resolution * Resolution * Resolution));
+		OutMip = FMath::Sqrt(MipSum / (MipRes * MipRes * MipRes));
+	}
+}
+
+bool FVaporNoiseLodTest::RunTest(const FString& Parameters) {
+	using namespace VaporNoise;
+
+	TArray<uint8> Texels;
+	FVector4f Mean;
+	if (!TestTrue(TEXT("Noise loaded"), ReadAlligatorNoise(Texels, Mean))) return false;
+	TestEqual(TEXT("Noise texel count"), Texels.Num(), Resolution * Resolution * Resolution * 4);
+
+	/* Past the cutoff the shader swaps an octave for its mean, which should only drop detail the mip already averaged away. */
+	/* The high frequency grids fade at the HF cutoff, the low frequency ones at the LF cutoff. */
+	const float CutoffLods[4] = { HFCutoffLod, HFCutoffLod, LFCutoffLod, LFCutoffLod };
+	for (int32 Channel = 0; Channel < 4; ++Channel) {
+		double Full, Culled;
+		GetNoiseDeviation(Texels, Channel, Mean[Channel], (int32)CutoffLods[Channel], Full, Culled);
+		AddInfo(FString::Printf(TEXT("Noise grid %d: deviation %.4f at full resolution, %.4f at mip %d"), Channel, Full, Culled, (int32)CutoffLods[Channel]));
+
+		TestTrue(FString::Printf(TEXT("Noise grid %d has detail"), Channel), Full > 0.01);
+		TestTrue(FString::Printf(TEXT("Noise grid %d is mostly its mean past the cutoff"), Channel), Culled <= 0.5 * Full);
+	}
+	return true;
+}
+
+#endif
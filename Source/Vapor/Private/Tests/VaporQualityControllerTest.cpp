@@ -0,0 +1,82 @@
+#include "Misc/AutomationTest.h"
+#include "VaporQualityController.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVaporQualityControllerTest, "Vapor.QualityController",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace {
+	/* Synthetic GPU cost of the march at a quality level, measured a couple frames late like the GPU timer */
+	struct FSyntheticGpu {
+		float BaseMs = 6.0f;
+		float QualityMs = 7.0f;
+		float Lagged[2] = { 1.0f, 1.0f };
+
+		float Measure(const float Quality) {
+			const float Ms = BaseMs + QualityMs * Lagged[0];
+			Lagged[0] = Lagged[1];
+			Lagged[1] = Quality;
+			return Ms;
+		}
+	};
+}
+
+bool FVaporQualityControllerTest::RunTest(const FString& Parameters) {
+	constexpr float TargetMs = 10.0f;
+
+	{ /* Over budget, the quality drops until the time is inside the tolerance band and then holds still */
+		FVaporQualityController Controller;
+		FSyntheticGpu Gpu;
+		TArray<float> History;
+		for (int32 Frame = 0; Frame < 400; ++Frame) {
+			History.Add(Controller.Update(Gpu.Measure(Controller.GetQuality()), TargetMs));
+		}
+		TestTrue(TEXT("Quality dropped below the best"), Controller.GetQuality() < 1.0f);
+		TestTrue(TEXT("Filtered time is inside the tolerance band"), FMath::Abs(Controller.GetFilteredMs() / TargetMs - 1.0f) <= Controller.Tolerance);
+
+		int32 NumChanges = 0;
+		for (int32 Frame = 200; Frame < History.Num(); ++Frame) {
+			NumChanges += History[Frame] != History[Frame - 1] ? 1 : 0;
+		}
+		TestEqual(TEXT("Quality changes once settled"), NumChanges, 0);
+	}
+
+	{ /* Noise inside the tolerance band never changes the quality */
+		FVaporQualityController Controller;
+		for (int32 Frame = 0; Frame < 200; ++Frame) {
+			const float Noise = (Frame % 2 == 0) ? 0.08f : -0.08f;
+			Controller.Update(TargetMs * (1.0f + Noise), TargetMs);
+		}
+		TestEqual(TEXT("Quality under noise"), Controller.GetQuality(), 1.0f);
+	}
+
+	{ /* Quality recovers slower than it drops */
+		FVaporQualityController Controller;
+		for (int32 Frame = 0; Frame < 8; ++Frame) Controller.Update(TargetMs * 2.0f, TargetMs);
+		const float Dropped = Controller.GetQuality();
+		TestTrue(TEXT("Quality drops when twice over budget"), Dropped <= 1.0f - Controller.DecreaseRate * 0.5f);
+
+		float Previous = Dropped;
+		for (int32 Frame = 0; Frame < 64; ++Frame) {
+			const float Quality = Controller.Update(TargetMs * 0.5f, TargetMs);
+			TestTrue(TEXT("Quality recovers by at most the increase rate per frame"), Quality - Previous <= Controller.IncreaseRate + UE_KINDA_SMALL_NUMBER);
+			Previous = Quality;
+		}
+		TestTrue(TEXT("Quality recovers when under budget"), Previous > Dropped);
+	}
+
+	{ /* Without a target the controller leaves the quality alone, and a reset goes back to the best quality */
+		FVaporQualityController Controller;
+		for (int32 Frame = 0; Frame < 8; ++Frame) Controller.Update(TargetMs * 2.0f, TargetMs);
+		const float Dropped = Controller.GetQuality();
+		TestEqual(TEXT("Quality without a target"), Controller.Update(TargetMs * 4.0f, 0.0f), Dropped);
+		Controller.Reset();
+		TestEqual(TEXT("Quality after a reset"), Controller.GetQuality(), 1.0f);
+		TestTrue(TEXT("Measurements are forgotten after a reset"), Controller.GetFilteredMs() < 0.0f);
+	}
+
+	return true;
+}
+
+#endif
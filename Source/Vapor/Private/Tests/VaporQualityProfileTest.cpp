@@ -0,0 +1,84 @@
+#include "Misc/AutomationTest.h"
+#include "VaporQualityProfile.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVaporQualityProfileTest, "Vapor.QualityProfile",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace {
+	/* Synthetic GPU cost of each tier, measured a couple frames late like the GPU timer */
+	constexpr float TierMs[] = { 1.0f, 2.0f, 3.0f, 4.0f };
+	constexpr int32 NumTiers = UE_ARRAY_COUNT(TierMs);
+	constexpr int32 Lag = 2;
+
+	/** @brief Render frames until the profile finishes, timing every frame at the tier it rendered. Returns the number of frames. */
+	int32 RunProfile(FVaporQualityProfile& Profile, const int32 MaxFrames, const bool bTwoViews) {
+		TArray<float> InFlight;
+		for (int32 Frame = 0; Frame < MaxFrames; ++Frame) {
+			while (InFlight.Num() > Lag) {
+				Profile.AddMeasurement(InFlight[0]);
+				InFlight.RemoveAt(0);
+			}
+			if (Profile.Finish()) return Frame;
+
+			for (int32 View = 0; View < (bTwoViews ? 2 : 1); ++View) {
+				const int32 Tier = Profile.BeginFrame(Frame);
+				if (Tier >= 0) Profile.SetInstructions(Tier, 1000 * (Tier + 1));
+				Profile.OnTimed(Tier);
+				InFlight.Add(Tier >= 0 ? TierMs[Tier] : 100.0f);
+			}
+		}
+		return MaxFrames;
+	}
+}
+
+bool FVaporQualityProfileTest::RunTest(const FString& Parameters) {
+	constexpr int32 FramesPerTier = 16;
+
+	{ /* Every tier is measured for its frames after the warm-up, and the lagged measurements of the previous tier are left out */
+		FVaporQualityProfile Profile;
+		Profile.Start(NumTiers, FramesPerTier);
+		const int32 NumFrames = RunProfile(Profile, 1000, false);
+		TestTrue(TEXT("Profile finished"), NumFrames < 1000);
+		TestFalse(TEXT("Profile stopped"), Profile.IsRunning());
+		TestEqual(TEXT("Number of tiers"), Profile.GetResults().Num(), NumTiers);
+		for (int32 Tier = 0; Tier < Profile.GetResults().Num(); ++Tier) {
+			const FVaporTierProfile& Result = Profile.GetResults()[Tier];
+			TestEqual(*FString::Printf(TEXT("Frames of tier %d"), Tier), Result.NumFrames, FramesPerTier);
+			TestEqual(*FString::Printf(TEXT("Mean of tier %d"), Tier), Result.GetMeanMs(), TierMs[Tier], UE_KINDA_SMALL_NUMBER);
+			TestEqual(*FString::Printf(TEXT("Min of tier %d"), Tier), Result.MinMs, TierMs[Tier], UE_KINDA_SMALL_NUMBER);
+			TestEqual(*FString::Printf(TEXT("Instructions of tier %d"), Tier), Result.NumInstructions, (uint32)(1000 * (Tier + 1)));
+		}
+		TestFalse(TEXT("Finish only returns true once"), Profile.Finish());
+	}
+
+	{ /* Views of the same frame render the same tier, and both of their measurements count */
+		FVaporQualityProfile Profile;
+		Profile.Start(NumTiers, FramesPerTier);
+		RunProfile(Profile, 1000, true);
+		for (int32 Tier = 0; Tier < Profile.GetResults().Num(); ++Tier) {
+			const FVaporTierProfile& Result = Profile.GetResults()[Tier];
+			TestEqual(*FString::Printf(TEXT("Frames of tier %d with two views"), Tier), Result.NumFrames, FramesPerTier * 2);
+			TestEqual(*FString::Printf(TEXT("Mean of tier %d with two views"), Tier), Result.GetMeanMs(), TierMs[Tier], UE_KINDA_SMALL_NUMBER);
+		}
+	}
+
+	{ /* Without a profile every measurement goes to the quality controller */
+		FVaporQualityProfile Profile;
+		TestEqual(TEXT("Tier without a profile"), Profile.BeginFrame(0), -1);
+		Profile.OnTimed(-1);
+		TestFalse(TEXT("Measurement outside the profile"), Profile.AddMeasurement(5.0f));
+		TestFalse(TEXT("Nothing to finish"), Profile.Finish());
+	}
+
+	{ /* Requests are taken once */
+		FVaporQualityProfile::Request(32);
+		TestEqual(TEXT("Requested frames"), FVaporQualityProfile::ConsumeRequest(), 32);
+		TestEqual(TEXT("Request after it was taken"), FVaporQualityProfile::ConsumeRequest(), 0);
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,105 @@
+#include "Misc/AutomationTest.h"
+#include "UObject/Package.h"
+#include "VaporCloudSequence.h"
+#include "VaporSequenceStreamer.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVaporSequenceStreamerTest, "Vapor.SequenceStreamer",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace {
+	/* Transient sequence whose density is filled with the frame index, the payloads stay resident */
+	UVaporCloudSequence* CreateTestSequence(const int32 NumFrames, const float FrameRate) {
+		UVaporCloudSequence* Sequence = NewObject<UVaporCloudSequence>(GetTransientPackage());
+		Sequence->FrameRate = FrameRate;
+		Sequence->FrameSize = FIntVector(4, 4, 4);
+
+		const int32 NumVoxels = Sequence->FrameSize.X * Sequence->FrameSize.Y * Sequence->FrameSize.Z;
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame) {
+			TArray<uint8> Density;
+			TArray<uint16> SDF;
+			Density.Init((uint8)Frame, NumVoxels);
+			SDF.Init(0, NumVoxels);
+			Sequence->AddFrame(Density, SDF);
+		}
+		return Sequence;
+	}
+}
+
+bool FVaporSequenceStreamerTest::RunTest(const FString& Parameters) {
+	constexpr float FrameRate = 10.0f;
+	constexpr int32 NumFrames = 8;
+
+	{ /* Frame timing wraps around when looping, and holds the last frame otherwise */
+		int32 Frame, Next;
+		float Blend;
+		FVaporSequenceStreamer::GetFrameTiming(1.25, FrameRate, NumFrames, true, Frame, Next, Blend);
+		TestEqual(TEXT("Looped frame"), Frame, 4);
+		TestEqual(TEXT("Looped next frame"), Next, 5);
+		TestEqual(TEXT("Looped blend"), Blend, 0.5f, UE_KINDA_SMALL_NUMBER);
+
+		FVaporSequenceStreamer::GetFrameTiming(0.75, FrameRate, NumFrames, true, Frame, Next, Blend);
+		TestEqual(TEXT("Last frame blends towards the first when looping"), Next, 0);
+
+		FVaporSequenceStreamer::GetFrameTiming(5.0, FrameRate, NumFrames, false, Frame, Next, Blend);
+		TestEqual(TEXT("Finished frame"), Frame, NumFrames - 1);
+		TestEqual(TEXT("Finished next frame"), Next, NumFrames - 1);
+		TestEqual(TEXT("Finished blend"), Blend, 0.0f);
+
+		FVaporSequenceStreamer::GetFrameTiming(-1.0, FrameRate, NumFrames, false, Frame, Next, Blend);
+		TestEqual(TEXT("Frame before the start"), Frame, 0);
+	}
+
+	UVaporCloudSequence* Sequence = CreateTestSequence(NumFrames, FrameRate);
+
+	{ /* Playing in order prefetches every frame before it's displayed */
+		FVaporSequenceStreamer Streamer;
+		Streamer.SetSequence(Sequence);
+		FVaporSequenceState State;
+		for (int32 Step = 0; Step < NumFrames * 2; ++Step) {
+			const double Time = Step * 0.5 / FrameRate;
+			if (!TestTrue(TEXT("Frame is displayed"), Streamer.Update(Time, true, State))) return false;
+
+			const int32 Frame = Step / 2;
+			TestEqual(TEXT("Displayed frame"), State.Current.Frame, Frame);
+			TestEqual(TEXT("Displayed payload"), (int32)(*State.Current.Payload)[0], Frame);
+			if (Step % 2 == 1 && Frame + 1 < NumFrames) {
+				TestEqual(TEXT("Blends towards the next frame"), State.Next.Frame, Frame + 1);
+				TestEqual(TEXT("Blend"), State.Blend, 0.5f, UE_KINDA_SMALL_NUMBER);
+			}
+		}
+		TestEqual(TEXT("Prefetch hits"), Streamer.GetStats().Hits, NumFrames - 1);
+		TestEqual(TEXT("Prefetch hit rate"), Streamer.GetStats().GetHitRate(), 1.0f);
+
+		/* Looping back to the first frame resets the statistics */
+		Streamer.Update(NumFrames / FrameRate, true, State);
+		TestEqual(TEXT("Statistics after looping"), Streamer.GetStats().Hits + Streamer.GetStats().Misses, 0);
+		TestEqual(TEXT("Looped frame"), State.Current.Frame, 0);
+	}
+
+	{ /* Seeking past the prefetch window misses, and the new frame is displayed once it's loaded */
+		FVaporSequenceStreamer Streamer;
+		Streamer.SetSequence(Sequence);
+		FVaporSequenceState State;
+		Streamer.Update(0.0, false, State);
+		Streamer.Update((FVaporSequenceStreamer::RingSize + 2) / FrameRate, false, State);
+		TestEqual(TEXT("Prefetch misses"), Streamer.GetStats().Misses, 1);
+		TestEqual(TEXT("Prefetch hit rate"), Streamer.GetStats().GetHitRate(), 0.0f);
+		TestEqual(TEXT("Displayed frame after seeking"), State.Current.Frame, FVaporSequenceStreamer::RingSize + 2);
+	}
+
+	{ /* Switching sequences drops the frames and the statistics */
+		FVaporSequenceStreamer Streamer;
+		FVaporSequenceState State;
+		Streamer.SetSequence(Sequence);
+		Streamer.Update(0.25, true, State);
+		Streamer.SetSequence(nullptr);
+		TestFalse(TEXT("Nothing to display without a sequence"), Streamer.Update(0.25, true, State));
+		TestEqual(TEXT("Statistics after switching"), Streamer.GetStats().Hits, 0);
+	}
+
+	return true;
+}
+
+#endif
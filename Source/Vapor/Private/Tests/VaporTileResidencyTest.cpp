@@ -0,0 +1,113 @@
+#include "Misc/AutomationTest.h"
+#include "VaporTileResidency.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVaporTileResidencyTest, "Vapor.TileResidency",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+namespace {
+	/* Update the residency and complete every load straight away, like a stream which is never late */
+	void UpdateAndLoad(FVaporTileResidency& Residency, const FVector2D& Camera) {
+		TArray<FVaporTileLoad> Loads;
+		Residency.Update(Camera, Loads);
+		for (const FVaporTileLoad& Load : Loads) Residency.CompleteLoad(Load);
+	}
+
+	/* Check that no atlas slot is used by two resident tiles */
+	bool HasUniqueSlots(const FVaporTileResidency& Residency, const int32 NumTiles) {
+		TSet<int32> Used[VaporCloudscape::NumLODs];
+		for (int32 Tile = 0; Tile < NumTiles; ++Tile) {
+			const int32 LOD = Residency.GetResidentLOD(Tile);
+			if (LOD == INDEX_NONE) continue;
+			bool bAlreadyUsed = false;
+			Used[LOD].Add(Residency.GetResidentSlot(Tile), &bAlreadyUsed);
+			if (bAlreadyUsed) return false;
+		}
+		return true;
+	}
+}
+
+bool FVaporTileResidencyTest::RunTest(const FString& Parameters) {
+	using namespace VaporCloudscape;
+
+	FVaporTileSettings Settings;
+	Settings.NumTiles = FIntPoint(16, 16);
+	const int32 NumTiles = Settings.NumTiles.X * Settings.NumTiles.Y;
+
+	{ /* The slot budget covers the coarsest LOD first, and never goes over the budget */
+		int32 Slots[NumLODs];
+		FVaporTileResidency::ComputeSlotBudget(Settings, GetTileBytes(NumLODs - 1) * 10, Slots);
+		TestEqual(TEXT("Coarsest slots of a small budget"), Slots[NumLODs - 1], 10);
+		TestEqual(TEXT("Finest slots of a small budget"), Slots[0], 0);
+
+		for (const int64 Budget : { 64ll << 20, 512ll << 20, 2048ll << 20 }) {
+			FVaporTileResidency::ComputeSlotBudget(Settings, Budget, Slots);
+			FVaporTileResidency Residency;
+			Residency.Init(Settings, Slots);
+			TestTrue(TEXT("Allocated bytes are within the budget"), Residency.GetAllocatedBytes() <= Budget);
+		}
+	}
+
+	{ /* Flying over the cloudscape keeps the tiles near the camera detailed, within the slots */
+		int32 Slots[NumLODs];
+		FVaporTileResidency::ComputeSlotBudget(Settings, 2048ll << 20, Slots);
+		Settings.EmptyTiles.Init(false, NumTiles);
+		Settings.EmptyTiles[8 * Settings.NumTiles.X + 9] = true;
+		FVaporTileResidency Residency;
+		Residency.Init(Settings, Slots);
+
+		for (int32 Step = 0; Step <= 32; ++Step) {
+			const FVector2D Camera = FVector2D(Step * 0.25 + 4.5, 8.5) * Settings.TileSize;
+			for (int32 Frame = 0; Frame < 4; ++Frame) UpdateAndLoad(Residency, Camera);
+
+			for (int32 LOD = 0; LOD < NumLODs; ++LOD) {
+				TestTrue(TEXT("Used slots are within the slots"), Residency.GetUsedSlots(LOD) <= Residency.GetNumSlots(LOD));
+			}
+			TestTrue(TEXT("Used bytes are within the allocation"), Residency.GetUsedBytes() <= Residency.GetAllocatedBytes());
+			TestTrue(TEXT("Resident tiles have their own slot"), HasUniqueSlots(Residency, NumTiles));
+			TestEqual(TEXT("Empty tile"), Residency.GetResidentLOD(8 * Settings.NumTiles.X + 9), (int32)INDEX_NONE);
+
+			const FIntPoint CameraTile((int32)(Camera.X / Settings.TileSize), (int32)(Camera.Y / Settings.TileSize));
+			if (CameraTile != FIntPoint(9, 8)) {
+				TestEqual(TEXT("Tile under the camera"), Residency.GetResidentLOD(CameraTile.X + CameraTile.Y * Settings.NumTiles.X), 0);
+			}
+		}
+		Settings.EmptyTiles.Reset();
+	}
+
+	{ /* Tiles hold on to their LOD a little past its distance, and keep it until the coarser LOD is loaded */
+		FVaporTileSettings RowSettings = Settings;
+		RowSettings.NumTiles = FIntPoint(4, 1);
+		const int32 RowSlots[NumLODs] = { 4, 4, 4 };
+		FVaporTileResidency Residency;
+		Residency.Init(RowSettings, RowSlots);
+
+		const float LOD0Distance = RowSettings.LODDistances[0];
+		auto CameraAt = [&RowSettings](const float Distance) { return FVector2D(RowSettings.TileSize + Distance, RowSettings.TileSize * 0.5f); };
+
+		UpdateAndLoad(Residency, CameraAt(LOD0Distance * 0.5f));
+		TestEqual(TEXT("LOD inside the distance"), Residency.GetResidentLOD(0), 0);
+
+		TArray<FVaporTileLoad> Loads;
+		Residency.Update(CameraAt(LOD0Distance * (1.0f + RowSettings.Hysteresis * 0.5f)), Loads);
+		TestEqual(TEXT("LOD inside the hysteresis"), Residency.GetResidentLOD(0), 0);
+		TestFalse(TEXT("No load inside the hysteresis"), Loads.ContainsByPredicate([](const FVaporTileLoad& Pending) { return Pending.Tile == 0; }));
+
+		Loads.Reset();
+		Residency.Update(CameraAt(LOD0Distance * (1.0f + RowSettings.Hysteresis * 2.0f)), Loads);
+		const FVaporTileLoad* Load = Loads.FindByPredicate([](const FVaporTileLoad& Pending) { return Pending.Tile == 0; });
+		if (TestNotNull(TEXT("Load past the hysteresis"), Load)) {
+			TestEqual(TEXT("Loaded LOD past the hysteresis"), Load->LOD, 1);
+			TestEqual(TEXT("LOD while loading"), Residency.GetResidentLOD(0), 0);
+			const int32 UsedSlots = Residency.GetUsedSlots(0);
+			TestTrue(TEXT("Load completes"), Residency.CompleteLoad(*Load));
+			TestEqual(TEXT("LOD once loaded"), Residency.GetResidentLOD(0), 1);
+			TestEqual(TEXT("Finer slot is freed"), Residency.GetUsedSlots(0), UsedSlots - 1);
+		}
+	}
+
+	return true;
+}
+
+#endif
@@ -12,11 +12,9 @@ THIRD_PARTY_INCLUDES_START
 #include "openvdb/Grid.h"
 THIRD_PARTY_INCLUDES_END
 
-constexpr uint32 NOISE_RESOLUTION_X = 128;
-constexpr uint32 NOISE_RESOLUTION_Y = 128;
-constexpr uint32 NOISE_RESOLUTION_Z = 128;
+bool ReadAlligatorNoise(TArray<uint8>& OutTexels, FVector4f& OutMean) {
+	using namespace VaporNoise;
 
-UVolumeTexture* LoadAlligatorNoise() {
 	/* Init OpenVDB */
 	openvdb::initialize();
 
@@ -34,13 +32,13 @@ UVolumeTexture* LoadAlligatorNoise() {
 		File.open();
 	} catch (const std::exception& e) {
 		UE_LOG(LogTemp, Error, TEXT("Error opening VDB file: %s"), UTF8_TO_TCHAR(e.what()));
-		return nullptr;
+		return false;
 	}
 
 	/* Make sure the VDB file has at least 1 grid */
 	if (File.getGrids()->size() == 0ull) {
 		UE_LOG(LogTemp, Error, TEXT("No grids found in VDB file"));
-		return nullptr;
+		return false;
 	}
 
 	/* Get the noise grid pointers */
@@ -55,16 +53,12 @@ UVolumeTexture* LoadAlligatorNoise() {
 	const openvdb::FloatGrid::ConstAccessor AccessorB = LFAlligator->getConstAccessor();
 	const openvdb::FloatGrid::ConstAccessor AccessorA = LFCurlyWorley->getConstAccessor();
 
-	/* Create new volume texture asset (marked as root to avoid garbage collection) */
-	UVolumeTexture* NewTexture = NewObject<UVolumeTexture>(GetTransientPackage(), "Noise Texture", RF_MarkAsRootSet);
-
-	/* Initialize the volume texture */
-	NewTexture->Source.Init(NOISE_RESOLUTION_X, NOISE_RESOLUTION_Y, NOISE_RESOLUTION_Z, 1, TSF_BGRA8, nullptr);
-	uint8* TextureData = (uint8*)NewTexture->Source.LockMip(0);
+	OutTexels.SetNumUninitialized(Resolution * Resolution * Resolution * 4);
+	FVector4d Sum = FVector4d::Zero();
 
-	for (uint32 z = 0; z < NOISE_RESOLUTION_Z; ++z) {
-		for (uint32 y = 0; y < NOISE_RESOLUTION_Y; ++y) {
-			for (uint32 x = 0; x < NOISE_RESOLUTION_X; ++x) {
+	for (int32 z = 0; z < Resolution; ++z) {
+		for (int32 y = 0; y < Resolution; ++y) {
+			for (int32 x = 0; x < Resolution; ++x) {
 				/* Sample the noise grid */
 				const float ValueR = AccessorR.getValue(openvdb::Coord(x, z, y));
 				const float ValueG = AccessorG.getValue(openvdb::Coord(x, z, y));
@@ -72,20 +66,35 @@ UVolumeTexture* LoadAlligatorNoise() {
 				const float ValueA = AccessorA.getValue(openvdb::Coord(x, z, y));
 
 				/* Set the value inside our resampled grid */
-				const int32 Index = x + (y * NOISE_RESOLUTION_X) + (z * NOISE_RESOLUTION_X * NOISE_RESOLUTION_Y);
-				TextureData[Index * 4 + 0] = (uint8)(ValueR * 255.0f);
-				TextureData[Index * 4 + 1] = (uint8)(ValueG * 255.0f);
-				TextureData[Index * 4 + 2] = (uint8)(ValueB * 255.0f);
-				TextureData[Index * 4 + 3] = (uint8)(ValueA * 255.0f);
+				const int32 Index = x + (y * Resolution) + (z * Resolution * Resolution);
+				OutTexels[Index * 4 + 0] = (uint8)(ValueR * 255.0f);
+				OutTexels[Index * 4 + 1] = (uint8)(ValueG * 255.0f);
+				OutTexels[Index * 4 + 2] = (uint8)(ValueB * 255.0f);
+				OutTexels[Index * 4 + 3] = (uint8)(ValueA * 255.0f);
+				Sum += FVector4d(OutTexels[Index * 4 + 0], OutTexels[Index * 4 + 1], OutTexels[Index * 4 + 2], OutTexels[Index * 4 + 3]);
 			}
 		}
 	}
+	OutMean = FVector4f(Sum / (255.0 * Resolution * Resolution * Resolution));
+
+	File.close(); /* Finally close the VDB file */
+	return true;
+}
+
+UVolumeTexture* LoadAlligatorNoise(FVector4f& OutMean) {
+	using namespace VaporNoise;
 
-	/* Unlock the volume texture data */
-	NewTexture->Source.UnlockMip(0);
+	TArray<uint8> Texels;
+	if (!ReadAlligatorNoise(Texels, OutMean)) return nullptr;
+
+	/* Create new volume texture asset (marked as root to avoid garbage collection) */
+	UVolumeTexture* NewTexture = NewObject<UVolumeTexture>(GetTransientPackage(), "Noise Texture", RF_MarkAsRootSet);
+
+	/* Initialize the volume texture */
+	NewTexture->Source.Init(Resolution, Resolution, Resolution, 1, TSF_BGRA8, Texels.GetData());
 
 	/* Set all the volume texture settings */
-	NewTexture->MipGenSettings = TMGS_NoMipmaps;
+	NewTexture->MipGenSettings = TMGS_SimpleAverage; /* Prefiltered octaves for distant samples */
 	//NewTexture->CompressionSettings = TC_BC7;
 	NewTexture->CompressionNone = true;
 	NewTexture->SRGB = false;
@@ -95,7 +104,5 @@ UVolumeTexture* LoadAlligatorNoise() {
 	/* Update the volume texture resource */
 	NewTexture->UpdateResource();
 	NewTexture->CreateResource();
-
-	File.close(); /* Finally close the VDB file, and return */
 	return NewTexture;
 }
\ No newline at end of file
@@ -2,4 +2,17 @@
 
 #include "Rendering/SlateRenderer.h" /* FTextureRHIRef */
 
-UVolumeTexture* LoadAlligatorNoise();
+/* Noise texture layout, must match "Cloud.ush". */
+namespace VaporNoise {
+	constexpr int32 Resolution = 128;
+
+	/* Noise mips past which the high (first two grids) and low (last two grids) frequency erosion octaves have faded to their mean */
+	constexpr float HFCutoffLod = 3.0f;
+	constexpr float LFCutoffLod = 5.0f;
+}
+
+/* Read the noise channels from the VDB file as they're stored in the noise texture, (4 bytes per texel in grid order, x + y * X + z * X * Y) and the mean of each channel. */
+bool ReadAlligatorNoise(TArray<uint8>& OutTexels, FVector4f& OutMean);
+
+/* Load the noise texture, with the mean of each channel which distant samples fade towards. */
+UVolumeTexture* LoadAlligatorNoise(FVector4f& OutMean);
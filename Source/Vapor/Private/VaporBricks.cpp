@@ -0,0 +1,148 @@
+#include "VaporBricks.h"
+
+#include "Async/ParallelFor.h"
+#include "Compression/OodleDataCompression.h"
+#include <atomic>
+
+namespace {
+	/* Mermaid decodes several times faster than Kraken, at a slightly lower ratio */
+	constexpr FOodleDataCompression::ECompressor Compressor = FOodleDataCompression::ECompressor::Mermaid;
+	constexpr FOodleDataCompression::ECompressionLevel CompressionLevel = FOodleDataCompression::ECompressionLevel::Optimal2;
+
+	/* Bricks which don't compress are stored raw, this is flagged in the top bit of their end offset */
+	constexpr uint64 RawBrick = 1ull << 63;
+
+	/** @brief Get the voxel range of a brick, clipped to the field. */
+	void GetBrickRange(const int32 Brick, const FIntVector& Size, FIntVector& OutMin, FIntVector& OutSize) {
+		using namespace VaporBricks;
+		const FIntVector NumBricks = GetNumBricks(Size);
+		OutMin = FIntVector(Brick % NumBricks.X, (Brick / NumBricks.X) % NumBricks.Y, Brick / (NumBricks.X * NumBricks.Y)) * BrickSize;
+		OutSize = FIntVector(FMath::Min(BrickSize, Size.X - OutMin.X), FMath::Min(BrickSize, Size.Y - OutMin.Y), FMath::Min(BrickSize, Size.Z - OutMin.Z));
+	}
+
+	/** @brief Predict a voxel from its neighbour along X, or Y and Z at the start of a row. (within the brick) */
+	template<typename T>
+	FORCEINLINE T Predict(const T* Brick, const int32 X, const int32 Y, const int32 Z, const FIntVector& Size) {
+		const int32 Index = X + (Y * Size.X) + (Z * Size.X * Size.Y);
+		if (X > 0) return Brick[Index - 1];
+		if (Y > 0) return Brick[Index - Size.X];
+		if (Z > 0) return Brick[Index - Size.X * Size.Y];
+		return 0;
+	}
+
+	/** @brief Gather a brick from the field, and replace every voxel by its delta to the predicted voxel. */
+	template<typename T>
+	void EncodeBrick(const T* Voxels, const FIntVector& FieldSize, const FIntVector& Min, const FIntVector& Size, TArray<uint8>& OutBytes) {
+		const int32 NumVoxels = Size.X * Size.Y * Size.Z;
+		TArray<T> Brick;
+		Brick.SetNumUninitialized(NumVoxels);
+		for (int32 z = 0; z < Size.Z; ++z) for (int32 y = 0; y < Size.Y; ++y) {
+			const T* Row = Voxels + Min.X + ((int64)(Min.Y + y) * FieldSize.X) + ((int64)(Min.Z + z) * FieldSize.X * FieldSize.Y);
+			FMemory::Memcpy(&Brick[(y * Size.X) + (z * Size.X * Size.Y)], Row, Size.X * sizeof(T));
+		}
+
+		/* Split the deltas into byte planes, the high bytes are almost all 0x00 or 0xFF */
+		OutBytes.SetNumUninitialized(NumVoxels * sizeof(T));
+		for (int32 z = 0, i = 0; z < Size.Z; ++z) for (int32 y = 0; y < Size.Y; ++y) for (int32 x = 0; x < Size.X; ++x, ++i) {
+			const T Delta = (T)(Brick[i] - Predict(Brick.GetData(), x, y, z, Size));
+			for (int32 b = 0; b < (int32)sizeof(T); ++b) OutBytes[i + b * NumVoxels] = (uint8)(Delta >> (b * 8));
+		}
+	}
+
+	/** @brief Undo the byte planes and deltas of a brick, and scatter it into the destination. */
+	template<typename T>
+	void DecodeBrick(const uint8* Bytes, const FIntVector& Min, const FIntVector& Size, uint8* Dest, const uint32 RowPitch, const uint32 DepthPitch) {
+		const int32 NumVoxels = Size.X * Size.Y * Size.Z;
+		for (int32 z = 0, i = 0; z < Size.Z; ++z) for (int32 y = 0; y < Size.Y; ++y) {
+			T* Row = (T*)(Dest + (Min.Z + z) * (uint64)DepthPitch + (Min.Y + y) * (uint64)RowPitch) + Min.X;
+			const T* PrevRow = (T*)((uint8*)Row - RowPitch);
+			const T* PrevSlice = (T*)((uint8*)Row - DepthPitch);
+			for (int32 x = 0; x < Size.X; ++x, ++i) {
+				T Delta = 0;
+				for (int32 b = 0; b < (int32)sizeof(T); ++b) Delta |= (T)(Bytes[i + b * NumVoxels] << (b * 8));
+				/* Same prediction as `Predict`, but reading the already decoded voxels from the destination */
+				const T Prediction = x > 0 ? Row[x - 1] : y > 0 ? PrevRow[0] : z > 0 ? PrevSlice[0] : 0;
+				Row[x] = (T)(Prediction + Delta);
+			}
+		}
+	}
+}
+
+TArray64<uint8> VaporBricks::Compress(const uint8* Voxels, const FIntVector& Size, const int32 BytesPerVoxel) {
+	check(BytesPerVoxel == 1 || BytesPerVoxel == 2);
+	const FIntVector NumBricks = GetNumBricks(Size);
+	const int32 TotalBricks = NumBricks.X * NumBricks.Y * NumBricks.Z;
+
+	/* Compress the bricks in parallel, this is most of the import time */
+	TArray<TArray64<uint8>> Compressed;
+	TArray<bool> Raw;
+	Compressed.SetNum(TotalBricks);
+	Raw.SetNumZeroed(TotalBricks);
+	ParallelFor(TotalBricks, [&](const int32 Brick) {
+		FIntVector Min, BrickSize;
+		GetBrickRange(Brick, Size, Min, BrickSize);
+		TArray<uint8> Bytes;
+		if (BytesPerVoxel == 1) EncodeBrick<uint8>(Voxels, Size, Min, BrickSize, Bytes);
+		else EncodeBrick<uint16>((const uint16*)Voxels, Size, Min, BrickSize, Bytes);
+
+		Compressed[Brick].SetNumUninitialized(FOodleDataCompression::CompressedBufferSizeNeeded(Bytes.Num()));
+		const int64 CompressedSize = FOodleDataCompression::Compress(Compressed[Brick].GetData(), Compressed[Brick].Num(), Bytes.GetData(), Bytes.Num(), Compressor, CompressionLevel);
+		if (CompressedSize <= 0 || CompressedSize >= Bytes.Num()) {
+			Compressed[Brick] = TArray64<uint8>(Bytes.GetData(), Bytes.Num());
+			Raw[Brick] = true;
+		} else {
+			Compressed[Brick].SetNum(CompressedSize);
+		}
+	});
+
+	/* Write the brick end offsets, followed by the bricks */
+	TArray64<uint8> Payload;
+	Payload.SetNumUninitialized(TotalBricks * sizeof(uint64));
+	for (int32 Brick = 0; Brick < TotalBricks; ++Brick) {
+		Payload.Append(Compressed[Brick]);
+		((uint64*)Payload.GetData())[Brick] = (uint64)(Payload.Num() - TotalBricks * sizeof(uint64)) | (Raw[Brick] ? RawBrick : 0);
+	}
+	return Payload;
+}
+
+bool VaporBricks::Decompress(const uint8* Payload, const int64 PayloadSize, const FIntVector& Size, const int32 BytesPerVoxel, uint8* Dest, const uint32 RowPitch, const uint32 DepthPitch) {
+	check(BytesPerVoxel == 1 || BytesPerVoxel == 2);
+	const FIntVector NumBricks = GetNumBricks(Size);
+	const int32 TotalBricks = NumBricks.X * NumBricks.Y * NumBricks.Z;
+	const int64 HeaderSize = TotalBricks * sizeof(uint64);
+	if (PayloadSize < HeaderSize) return false;
+	const uint64* Offsets = (const uint64*)Payload;
+	const uint8* Bricks = Payload + HeaderSize;
+
+	/* Bricks write disjoint regions of the destination, so they can be decoded independently */
+	std::atomic<bool> bCorrupt = false;
+	ParallelFor(TotalBricks, [&](const int32 Brick) {
+		FIntVector Min, BrickSize;
+		GetBrickRange(Brick, Size, Min, BrickSize);
+		const int64 NumBytes = (int64)BrickSize.X * BrickSize.Y * BrickSize.Z * BytesPerVoxel;
+		const int64 Begin = Brick > 0 ? (int64)(Offsets[Brick - 1] & ~RawBrick) : 0;
+		const int64 End = (int64)(Offsets[Brick] & ~RawBrick);
+		if (End < Begin || HeaderSize + End > PayloadSize) {
+			bCorrupt = true;
+			return;
+		}
+
+		const uint8* Bytes = Bricks + Begin;
+		TArray<uint8> Scratch;
+		if (!(Offsets[Brick] & RawBrick)) {
+			Scratch.SetNumUninitialized(NumBytes);
+			if (!FOodleDataCompression::Decompress(Scratch.GetData(), NumBytes, Bytes, End - Begin)) {
+				bCorrupt = true;
+				return;
+			}
+			Bytes = Scratch.GetData();
+		} else if (End - Begin != NumBytes) {
+			bCorrupt = true;
+			return;
+		}
+
+		if (BytesPerVoxel == 1) DecodeBrick<uint8>(Bytes, Min, BrickSize, Dest, RowPitch, DepthPitch);
+		else DecodeBrick<uint16>(Bytes, Min, BrickSize, Dest, RowPitch, DepthPitch);
+	});
+	return !bCorrupt;
+}
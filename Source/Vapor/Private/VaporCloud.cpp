@@ -1,7 +1,159 @@
 #include "VaporCloud.h"
 
 #include "Engine/VolumeTexture.h"
+#include "Serialization/CustomVersion.h"
+#include "AssetRegistry/IAssetRegistry.h"
+#include "VaporBricks.h"
+
+namespace {
+	/* Versions of the cloud asset format, so clouds imported before a change still load */
+	struct FVaporCloudVersion {
+		enum Type {
+			Initial = 0,
+			CompressedFields = 1, /* Density and SDF stored as compressed bricks */
+			FieldMips = 2, /* Prefiltered mips of the compressed fields */
+			LatestVersion = FieldMips
+		};
+
+		static const FGuid GUID;
+	};
+
+	const FGuid FVaporCloudVersion::GUID(0x3A1C7E52, 0x9B4D4F18, 0x8E6A0D27, 0xC5F4B913);
+	FCustomVersionRegistration GRegisterVaporCloudVersion(FVaporCloudVersion::GUID, FVaporCloudVersion::LatestVersion, TEXT("VaporCloud"));
+
+	/** @brief Store a compressed payload, it's never inlined so it stays on disk until the cloud is rendered. */
+	void StorePayload(TIndirectArray<FByteBulkData>& Payloads, const TArray64<uint8>& Payload) {
+		FByteBulkData& BulkData = *new FByteBulkData();
+		Payloads.Add(&BulkData);
+		BulkData.SetBulkDataFlags(BULKDATA_Force_NOT_InlinePayload);
+		BulkData.Lock(LOCK_READ_WRITE);
+		FMemory::Memcpy(BulkData.Realloc(Payload.Num()), Payload.GetData(), Payload.Num());
+		BulkData.Unlock();
+	}
+
+	/** @brief Read a payload from disk, and decode it into a dense field. Returns false if the payload is corrupt. */
+	bool DecodePayload(FByteBulkData& BulkData, const FIntVector& Size, const int32 BytesPerVoxel, double& OutReadSeconds, double& OutDecodeSeconds) {
+		const double StartTime = FPlatformTime::Seconds();
+		TArray64<uint8> Payload;
+		Payload.SetNumUninitialized(BulkData.GetBulkDataSize());
+		void* Data = Payload.GetData();
+		BulkData.GetCopy(&Data, false);
+		const double DecodeTime = FPlatformTime::Seconds();
+		OutReadSeconds += DecodeTime - StartTime;
+
+		TArray64<uint8> Field;
+		Field.SetNumUninitialized((int64)Size.X * Size.Y * Size.Z * BytesPerVoxel);
+		const bool bValid = VaporBricks::Decompress(Payload.GetData(), Payload.Num(), Size, BytesPerVoxel, Field.GetData(), Size.X * BytesPerVoxel, Size.X * Size.Y * BytesPerVoxel);
+		OutDecodeSeconds += FPlatformTime::Seconds() - DecodeTime;
+		return bValid;
+	}
+
+	/** @brief Log the compression ratio, and the read and decode throughput, of every cloud asset in the project. */
+	void ReportCompression() {
+		TArray<FAssetData> Assets;
+		IAssetRegistry::GetChecked().GetAssetsByClass(UVaporCloud::StaticClass()->GetClassPathName(), Assets);
+
+		int64 TotalRaw = 0, TotalCompressed = 0;
+		double TotalRead = 0.0, TotalDecode = 0.0;
+		for (const FAssetData& Asset : Assets) {
+			UVaporCloud* Cloud = Cast<UVaporCloud>(Asset.GetAsset());
+			if (Cloud == nullptr || !Cloud->HasCompressedFields()) {
+				UE_LOG(LogTemp, Log, TEXT("Vapor: %s is not compressed, re-import it to compress its fields"), *Asset.AssetName.ToString());
+				continue;
+			}
+
+			double ReadSeconds = 0.0, DecodeSeconds = 0.0;
+			bool bValid = true;
+			for (int32 Mip = 0; Mip < Cloud->NumFieldMips && bValid; ++Mip) {
+				const FIntVector MipSize = UVaporCloud::GetMipSize(Cloud->FieldSize, Mip);
+				bValid &= DecodePayload(Cloud->DensityBricks[Mip], MipSize, sizeof(uint8), ReadSeconds, DecodeSeconds);
+				bValid &= DecodePayload(Cloud->SDFBricks[Mip], MipSize, sizeof(uint16), ReadSeconds, DecodeSeconds);
+			}
+			if (!bValid) {
+				/* A corrupt cloud would skew the throughput, so it's left out of the totals */
+				UE_LOG(LogTemp, Warning, TEXT("Vapor: %s has corrupt field bricks, re-import it"), *Asset.AssetName.ToString());
+				continue;
+			}
+			const int64 RawBytes = Cloud->GetFieldBytes();
+			UE_LOG(LogTemp, Log, TEXT("Vapor: %s %.2f MB -> %.2f MB (%.1fx), read %.2f ms, decoded %.2f ms (%.0f MB/s)"),
+				*Asset.AssetName.ToString(), RawBytes / (1024.0f * 1024.0f), Cloud->CompressedBytes / (1024.0f * 1024.0f),
+				(float)RawBytes / FMath::Max(Cloud->CompressedBytes, (int64)1), ReadSeconds * 1000.0, DecodeSeconds * 1000.0,
+				RawBytes / (1024.0 * 1024.0) / FMath::Max(DecodeSeconds, UE_DOUBLE_SMALL_NUMBER));
+
+			TotalRaw += RawBytes;
+			TotalCompressed += Cloud->CompressedBytes;
+			TotalRead += ReadSeconds;
+			TotalDecode += DecodeSeconds;
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("Vapor: All clouds %.2f MB -> %.2f MB (%.1fx), read %.0f MB/s, decoded %.0f MB/s"),
+			TotalRaw / (1024.0f * 1024.0f), TotalCompressed / (1024.0f * 1024.0f), (float)TotalRaw / FMath::Max(TotalCompressed, (int64)1),
+			TotalCompressed / (1024.0 * 1024.0) / FMath::Max(TotalRead, UE_DOUBLE_SMALL_NUMBER),
+			TotalRaw / (1024.0 * 1024.0) / FMath::Max(TotalDecode, UE_DOUBLE_SMALL_NUMBER));
+	}
+
+	FAutoConsoleCommand CmdReportCompression(
+		TEXT("vapor.reportcompression"),
+		TEXT("Log the compression ratio and load throughput of every cloud asset in the project"),
+		FConsoleCommandDelegate::CreateStatic(&ReportCompression));
+}
 
 UVaporCloud::UVaporCloud(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer) {
 
 }
+
+void UVaporCloud::SetFields(const FIntVector& Size, const TArray<TArray<uint8>>& DensityMips, const TArray<TArray<uint16>>& SDFMips) {
+	check(DensityMips.Num() == SDFMips.Num() && DensityMips.Num() > 0);
+	FieldSize = Size;
+	NumFieldMips = DensityMips.Num();
+	CompressedBytes = 0;
+	DensityBricks.Empty(NumFieldMips);
+	SDFBricks.Empty(NumFieldMips);
+
+	int64 DensityBytes = 0, SDFBytes = 0;
+	for (int32 Mip = 0; Mip < NumFieldMips; ++Mip) {
+		const FIntVector MipSize = GetMipSize(Size, Mip);
+		const int64 NumVoxels = (int64)MipSize.X * MipSize.Y * MipSize.Z;
+		check(DensityMips[Mip].Num() == NumVoxels && SDFMips[Mip].Num() == NumVoxels);
+
+		const TArray64<uint8> DensityPayload = VaporBricks::Compress(DensityMips[Mip].GetData(), MipSize, sizeof(uint8));
+		const TArray64<uint8> SDFPayload = VaporBricks::Compress((const uint8*)SDFMips[Mip].GetData(), MipSize, sizeof(uint16));
+		StorePayload(DensityBricks, DensityPayload);
+		StorePayload(SDFBricks, SDFPayload);
+		DensityBytes += DensityPayload.Num();
+		SDFBytes += SDFPayload.Num();
+	}
+	CompressedBytes = DensityBytes + SDFBytes;
+
+	const int64 RawBytes = GetFieldBytes();
+	UE_LOG(LogTemp, Log, TEXT("Vapor: Compressed %d cloud field mips, %.2f MB -> %.2f MB (%.1fx), density %.2f MB, SDF %.2f MB"),
+		NumFieldMips, RawBytes / (1024.0f * 1024.0f), CompressedBytes / (1024.0f * 1024.0f), (float)RawBytes / FMath::Max(CompressedBytes, (int64)1),
+		DensityBytes / (1024.0f * 1024.0f), SDFBytes / (1024.0f * 1024.0f));
+}
+
+void UVaporCloud::Serialize(FArchive& Ar) {
+	Super::Serialize(Ar);
+	Ar.UsingCustomVersion(FVaporCloudVersion::GUID);
+
+	const int32 Version = Ar.CustomVer(FVaporCloudVersion::GUID);
+	if (Version < FVaporCloudVersion::CompressedFields) return;
+
+	/* Clouds compressed before the field mips have a single mip */
+	int32 NumPayloads = DensityBricks.Num();
+	if (Version >= FVaporCloudVersion::FieldMips) Ar << NumPayloads;
+	else NumPayloads = NumFieldMips = 1;
+	if (Ar.IsLoading()) {
+		DensityBricks.Empty(NumPayloads);
+		SDFBricks.Empty(NumPayloads);
+		for (int32 i = 0; i < NumPayloads; ++i) {
+			DensityBricks.Add(new FByteBulkData());
+			SDFBricks.Add(new FByteBulkData());
+		}
+	}
+
+	/* Only the payload headers are read on load, the fields are read when the cloud is first rendered */
+	for (int32 i = 0; i < NumPayloads; ++i) {
+		DensityBricks[i].Serialize(Ar, this, i * 2);
+		SDFBricks[i].Serialize(Ar, this, i * 2 + 1);
+	}
+}
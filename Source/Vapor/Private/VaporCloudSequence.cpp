@@ -0,0 +1,38 @@
+#include "VaporCloudSequence.h"
+
+UVaporCloudSequence::UVaporCloudSequence(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer) {
+
+}
+
+void UVaporCloudSequence::AddFrame(const TArray<uint8>& Density, const TArray<uint16>& SDF) {
+	const int64 NumVoxels = (int64)FrameSize.X * FrameSize.Y * FrameSize.Z;
+	check(Density.Num() == NumVoxels && SDF.Num() == NumVoxels);
+
+	/* Store the frame in a separate payload, which is never inlined into the package export */
+	FByteBulkData* Payload = new FByteBulkData();
+	Payload->SetBulkDataFlags(BULKDATA_Force_NOT_InlinePayload);
+	Payload->Lock(LOCK_READ_WRITE);
+	uint8* Data = (uint8*)Payload->Realloc(GetFrameBytes());
+	FMemory::Memcpy(Data, Density.GetData(), NumVoxels * sizeof(uint8));
+	FMemory::Memcpy(Data + NumVoxels * sizeof(uint8), SDF.GetData(), NumVoxels * sizeof(uint16));
+	Payload->Unlock();
+
+	Frames.Add(Payload);
+	NumFrames = Frames.Num();
+}
+
+void UVaporCloudSequence::Serialize(FArchive& Ar) {
+	Super::Serialize(Ar);
+
+	int32 NumPayloads = Frames.Num();
+	Ar << NumPayloads;
+	if (Ar.IsLoading()) {
+		Frames.Empty(NumPayloads);
+		for (int32 i = 0; i < NumPayloads; ++i) Frames.Add(new FByteBulkData());
+	}
+
+	/* Only the payload headers are read on load, the frame data is streamed in by `FVaporSequenceStreamer` */
+	for (int32 i = 0; i < NumPayloads; ++i) {
+		Frames[i].Serialize(Ar, this, i);
+	}
+}
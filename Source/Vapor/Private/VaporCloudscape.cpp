@@ -0,0 +1,48 @@
+#include "VaporCloudscape.h"
+
+UVaporCloudscape::UVaporCloudscape(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer) {
+
+}
+
+void UVaporCloudscape::Init(const FIntPoint& InNumTiles) {
+	NumTiles = InNumTiles;
+	EmptyTiles.Init(true, GetNumTiles());
+	TilePayloads.Empty(GetNumTiles() * VaporCloudscape::NumLODs);
+	for (int32 i = 0; i < GetNumTiles() * VaporCloudscape::NumLODs; ++i) {
+		FByteBulkData* Payload = new FByteBulkData();
+		Payload->SetBulkDataFlags(BULKDATA_Force_NOT_InlinePayload);
+		TilePayloads.Add(Payload);
+	}
+}
+
+void UVaporCloudscape::SetTile(const int32 Tile, const int32 LOD, const TArray<uint8>& Density, const TArray<uint16>& SDF) {
+	const FIntVector Size = VaporCloudscape::GetPhysicalSize(LOD);
+	const int64 NumVoxels = (int64)Size.X * Size.Y * Size.Z;
+	check(Density.Num() == NumVoxels && SDF.Num() == NumVoxels);
+
+	/* Store the tile in a separate payload, which is never inlined into the package export */
+	FByteBulkData& Payload = TilePayloads[GetPayloadIndex(Tile, LOD)];
+	Payload.Lock(LOCK_READ_WRITE);
+	uint8* Data = (uint8*)Payload.Realloc(VaporCloudscape::GetTileBytes(LOD));
+	FMemory::Memcpy(Data, Density.GetData(), NumVoxels * sizeof(uint8));
+	FMemory::Memcpy(Data + NumVoxels * sizeof(uint8), SDF.GetData(), NumVoxels * sizeof(uint16));
+	Payload.Unlock();
+
+	EmptyTiles[Tile] = false;
+}
+
+void UVaporCloudscape::Serialize(FArchive& Ar) {
+	Super::Serialize(Ar);
+
+	int32 NumPayloads = TilePayloads.Num();
+	Ar << NumPayloads;
+	if (Ar.IsLoading()) {
+		TilePayloads.Empty(NumPayloads);
+		for (int32 i = 0; i < NumPayloads; ++i) TilePayloads.Add(new FByteBulkData());
+	}
+
+	/* Only the payload headers are read on load, the tile data is streamed in by `FVaporTileStreamer` */
+	for (int32 i = 0; i < NumPayloads; ++i) {
+		TilePayloads[i].Serialize(Ar, this, i);
+	}
+}
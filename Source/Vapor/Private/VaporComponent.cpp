@@ -1,6 +1,8 @@
 #include "VaporComponent.h"
 
 #include "VaporExtension.h"
+#include "VaporQualityController.h"
+#include "VaporTileResidency.h"
 
 UVaporComponent::UVaporComponent(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer) {
 
@@ -27,11 +29,25 @@ void UVaporComponent::IntoRenderData(FCloudscapeRenderData& RenderData) const {
 	RenderData.PrimaryNearStep = PrimaryNearStep;
 	RenderData.PrimaryStepPerDistance = PrimaryStepPerDistance;
 	RenderData.PrimaryMinSDFStep = PrimaryMinSDFStep;
-	RenderData.DirectScattering = DirectScattering;
-	RenderData.MultiScattering = MultiScattering;
-	RenderData.AmbientScattering = AmbientScattering;
 	RenderData.SecondaryStep = SecondaryStep;
 	RenderData.SecondaryExtinctThreshold = SecondaryExtinctThreshold / 100.0f;
 	RenderData.NoiseFreq = NoiseFrequency;
 	RenderData.WindSpeed = WindSpeed;
 }
+
+void UVaporComponent::IntoQualityBounds(FVaporQualityBounds& Bounds) const {
+	Bounds.Best.PrimaryNearStep = PrimaryNearStep;
+	Bounds.Best.PrimaryStepPerDistance = PrimaryStepPerDistance;
+	Bounds.Best.SecondaryStep = SecondaryStep;
+	Bounds.Best.ResolutionScale = 1.0f;
+	Bounds.Cheapest.PrimaryNearStep = FMath::Max(PrimaryNearStep, MaxPrimaryNearStep);
+	Bounds.Cheapest.PrimaryStepPerDistance = FMath::Max(PrimaryStepPerDistance, MaxPrimaryStepPerDistance);
+	Bounds.Cheapest.SecondaryStep = FMath::Max(SecondaryStep, MaxSecondaryStep);
+	Bounds.Cheapest.ResolutionScale = FMath::Clamp(MinResolutionScale, 0.25f, 1.0f);
+}
+
+void UVaporComponent::IntoTileSettings(FVaporTileSettings& Settings) const {
+	Settings.LODDistances[0] = LOD0Distance;
+	Settings.LODDistances[1] = FMath::Max(LOD0Distance, LOD1Distance);
+	Settings.LODDistances[2] = FMath::Max3(LOD0Distance, LOD1Distance, StreamingDistance);
+}
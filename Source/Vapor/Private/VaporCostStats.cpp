@@ -0,0 +1,212 @@
+#include "VaporCostStats.h"
+
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "ImageUtils.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+DECLARE_STATS_GROUP(TEXT("Vapor"), STATGROUP_Vapor, STATCAT_Advanced);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Mean Primary Steps"), STAT_VaporMeanSteps, STATGROUP_Vapor);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("P95 Primary Steps"), STAT_VaporP95Steps, STATGROUP_Vapor);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Max Primary Steps"), STAT_VaporMaxSteps, STATGROUP_Vapor);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Mean SDF Skips"), STAT_VaporMeanSkips, STATGROUP_Vapor);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Mean Cache Lookups"), STAT_VaporMeanLookups, STATGROUP_Vapor);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Opaque Rays %"), STAT_VaporOpaquePct, STATGROUP_Vapor);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Exhausted Rays %"), STAT_VaporExhaustedPct, STATGROUP_Vapor);
+
+CSV_DEFINE_CATEGORY(Vapor, true);
+
+namespace {
+	/* Filename of the requested dump, empty if there is none */
+	FCriticalSection DumpLock;
+	FString PendingDump;
+
+	const TCHAR* MetricNames[VaporCostStats::NumMetrics] = { TEXT("PrimarySteps"), TEXT("SDFSkips"), TEXT("CacheLookups") };
+	const TCHAR* TerminationNames[VaporCostStats::NumTerminations] = { TEXT("Missed"), TEXT("Exited"), TEXT("Opaque"), TEXT("Exhausted") };
+
+	/** @brief Map the loop iterations of a pixel to a color, from blue (none) over green and yellow to red (the full step budget). */
+	FColor HeatColor(const float Cost) {
+		static const FLinearColor Ramp[] = {
+			FLinearColor(0.0f, 0.0f, 0.5f), FLinearColor(0.0f, 0.5f, 1.0f), FLinearColor(0.0f, 1.0f, 0.0f),
+			FLinearColor(1.0f, 1.0f, 0.0f), FLinearColor(1.0f, 0.0f, 0.0f)
+		};
+		const float Scaled = FMath::Clamp(Cost, 0.0f, 1.0f) * (UE_ARRAY_COUNT(Ramp) - 1);
+		const int32 Index = FMath::Min(FMath::FloorToInt32(Scaled), (int32)UE_ARRAY_COUNT(Ramp) - 2);
+		return FMath::Lerp(Ramp[Index], Ramp[Index + 1], Scaled - Index).ToFColor(true);
+	}
+
+	/** @brief Save the heatmap and the histogram of a dumped frame. (any thread) */
+	void WriteDump(const FString& Filename, const TArray<uint32>& Cost, const FIntPoint Size, const int32 MaxSteps, const TArray<uint32>& Counters) {
+		using namespace VaporCostStats;
+		IFileManager::Get().MakeDirectory(*FPaths::GetPath(Filename), true);
+
+		/* Rays which miss are black, rays which ran out of steps are magenta */
+		TArray<FColor> Heatmap;
+		Heatmap.SetNumUninitialized(Cost.Num());
+		for (int32 i = 0; i < Cost.Num(); ++i) {
+			int32 Counts[NumMetrics], Termination;
+			UnpackCost(Cost[i], Counts, Termination);
+			if (Termination == Missed) Heatmap[i] = FColor::Black;
+			else if (Termination == Exhausted) Heatmap[i] = FColor::Magenta;
+			else Heatmap[i] = HeatColor((float)(Counts[PrimarySteps] + Counts[SDFSkips]) / MaxSteps);
+		}
+		const FString ImageFile = Filename + TEXT(".png");
+		if (!FImageUtils::SaveImageByExtension(*ImageFile, FImageView(Heatmap.GetData(), Size.X, Size.Y))) {
+			UE_LOG(LogTemp, Error, TEXT("Vapor: Failed to write %s"), *ImageFile);
+		}
+
+		/* One row per bin, with the count of each metric */
+		FString Csv = TEXT("Bin");
+		for (const TCHAR* Name : MetricNames) Csv += FString::Printf(TEXT(",%s"), Name);
+		Csv += TEXT("\n");
+		for (int32 Bin = 0; Bin < NumBins; ++Bin) {
+			Csv += FString::FromInt(Bin * BinWidth);
+			for (int32 Metric = 0; Metric < NumMetrics; ++Metric) Csv += FString::Printf(TEXT(",%u"), Counters[Metric * NumBins + Bin]);
+			Csv += TEXT("\n");
+		}
+		const FString CsvFile = Filename + TEXT(".csv");
+		if (!FFileHelper::SaveStringToFile(Csv, *CsvFile)) {
+			UE_LOG(LogTemp, Error, TEXT("Vapor: Failed to write %s"), *CsvFile);
+		}
+		UE_LOG(LogTemp, Display, TEXT("Vapor: Dumped the march cost of %dx%d rays to %s"), Size.X, Size.Y, *ImageFile);
+	}
+
+	void DumpCostCommand(const TArray<FString>& Args) {
+		const FString Filename = Args.Num() > 0 ? Args[0]
+			: FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Vapor"), FString::Printf(TEXT("Cost_%s"), *FDateTime::Now().ToString()));
+		VaporCostStats::RequestDump(Filename);
+	}
+
+	FAutoConsoleCommand CmdDumpCost(
+		TEXT("vapor.dumpcost"),
+		TEXT("Save a heatmap and a histogram of the march cost of the next frame. Optional: <Filename> (without extension)"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&DumpCostCommand));
+}
+
+void VaporCostStats::RequestDump(const FString& Filename) {
+	FScopeLock Lock(&DumpLock);
+	PendingDump = Filename;
+}
+
+FVaporCostSummary FVaporCostSummary::FromCounters(const uint32* Counters) {
+	using namespace VaporCostStats;
+	FVaporCostSummary Summary;
+	for (int32 Termination = 0; Termination < NumTerminations; ++Termination) {
+		Summary.NumRays += Counters[TerminationOffset + Termination];
+	}
+	if (Summary.NumRays == 0) return Summary;
+
+	for (int32 Termination = 0; Termination < NumTerminations; ++Termination) {
+		Summary.TerminationPct[Termination] = 100.0f * Counters[TerminationOffset + Termination] / Summary.NumRays;
+	}
+	for (int32 Metric = 0; Metric < NumMetrics; ++Metric) {
+		Summary.Mean[Metric] = (float)Counters[TotalOffset + Metric] / Summary.NumRays;
+
+		/* Walk the histogram for the percentile and the highest bin */
+		const uint32* Bins = &Counters[Metric * NumBins];
+		const uint32 P95Rays = (uint32)FMath::CeilToInt64(Summary.NumRays * 0.95);
+		uint32 Rays = 0;
+		for (int32 Bin = 0; Bin < NumBins; ++Bin) {
+			if (Bins[Bin] == 0) continue;
+			Rays += Bins[Bin];
+			if (Rays >= P95Rays && Summary.P95[Metric] == 0) Summary.P95[Metric] = (Bin + 1) * BinWidth;
+			Summary.Max[Metric] = (Bin + 1) * BinWidth;
+		}
+	}
+	return Summary;
+}
+
+bool FVaporCostStats::Begin(const bool bEnabled) {
+	check(!bMeasuring);
+
+	/* All frames are still in flight, skip this one, a pending dump waits for the next */
+	FFrame& Frame = Frames[WriteIndex];
+	if (Frame.bPending) return false;
+
+	FScopeLock Lock(&DumpLock);
+	if (!bEnabled && PendingDump.IsEmpty()) return false;
+	Frame.DumpFilename = MoveTemp(PendingDump);
+	PendingDump.Reset();
+	bMeasuring = true;
+	return true;
+}
+
+void FVaporCostStats::End(FRDGBuilder& GraphBuilder, FRDGBufferRef Counters, FRDGTextureRef Cost, const int32 MaxSteps) {
+	check(bMeasuring);
+	FFrame& Frame = Frames[WriteIndex];
+	if (!Frame.Counters.IsValid()) Frame.Counters = MakeUnique<FRHIGPUBufferReadback>(TEXT("Vapor Cost Counters"));
+	AddEnqueueCopyPass(GraphBuilder, Frame.Counters.Get(), Counters, VaporCostStats::NumCounters * sizeof(uint32));
+
+	/* The cost texture is only read back for dumps */
+	if (!Frame.DumpFilename.IsEmpty()) {
+		Frame.Cost = MakeUnique<FRHIGPUTextureReadback>(TEXT("Vapor Cost"));
+		Frame.CostSize = Cost->Desc.Extent;
+		AddEnqueueCopyPass(GraphBuilder, Frame.Cost.Get(), Cost);
+	}
+	Frame.MaxSteps = MaxSteps;
+	Frame.bPending = true;
+	WriteIndex = (WriteIndex + 1) % NumFrames;
+	bMeasuring = false;
+}
+
+void FVaporCostStats::Poll() {
+	using namespace VaporCostStats;
+	for (;;) {
+		FFrame& Frame = Frames[ReadIndex];
+		if (!Frame.bPending || !Frame.Counters->IsReady()) return;
+		if (Frame.Cost.IsValid() && !Frame.Cost->IsReady()) return;
+
+		TArray<uint32> Counters;
+		Counters.SetNumUninitialized(NumCounters);
+		FMemory::Memcpy(Counters.GetData(), Frame.Counters->Lock(NumCounters * sizeof(uint32)), NumCounters * sizeof(uint32));
+		Frame.Counters->Unlock();
+
+		/* Publish the frame as stats, and as CSV profiler stats */
+		const FVaporCostSummary Summary = FVaporCostSummary::FromCounters(Counters.GetData());
+		SET_FLOAT_STAT(STAT_VaporMeanSteps, Summary.Mean[PrimarySteps]);
+		SET_DWORD_STAT(STAT_VaporP95Steps, Summary.P95[PrimarySteps]);
+		SET_DWORD_STAT(STAT_VaporMaxSteps, Summary.Max[PrimarySteps]);
+		SET_FLOAT_STAT(STAT_VaporMeanSkips, Summary.Mean[SDFSkips]);
+		SET_FLOAT_STAT(STAT_VaporMeanLookups, Summary.Mean[CacheLookups]);
+		SET_FLOAT_STAT(STAT_VaporOpaquePct, Summary.TerminationPct[Opaque]);
+		SET_FLOAT_STAT(STAT_VaporExhaustedPct, Summary.TerminationPct[Exhausted]);
+		CSV_CUSTOM_STAT(Vapor, MeanSteps, Summary.Mean[PrimarySteps], ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(Vapor, P95Steps, Summary.P95[PrimarySteps], ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(Vapor, MeanSkips, Summary.Mean[SDFSkips], ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(Vapor, MeanLookups, Summary.Mean[CacheLookups], ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(Vapor, ExhaustedPct, Summary.TerminationPct[Exhausted], ECsvCustomStatOp::Set);
+
+		if (Frame.Cost.IsValid()) {
+			UE_LOG(LogTemp, Display, TEXT("Vapor: March cost of %d rays"), Summary.NumRays);
+			for (int32 Metric = 0; Metric < NumMetrics; ++Metric) {
+				UE_LOG(LogTemp, Display, TEXT("Vapor:   %-14s mean %7.2f  p95 %4d  max %4d"), MetricNames[Metric], Summary.Mean[Metric], Summary.P95[Metric], Summary.Max[Metric]);
+			}
+			for (int32 Termination = 0; Termination < NumTerminations; ++Termination) {
+				UE_LOG(LogTemp, Display, TEXT("Vapor:   %-14s %6.2f%%"), TerminationNames[Termination], Summary.TerminationPct[Termination]);
+			}
+
+			/* Copy the cost out of the readback, and leave the image encoding to a worker */
+			int32 RowPitch = 0;
+			const uint32* Src = (const uint32*)Frame.Cost->Lock(RowPitch);
+			TArray<uint32> Cost;
+			Cost.SetNumUninitialized(Frame.CostSize.X * Frame.CostSize.Y);
+			for (int32 y = 0; y < Frame.CostSize.Y; ++y) {
+				FMemory::Memcpy(&Cost[y * Frame.CostSize.X], Src + (int64)y * RowPitch, Frame.CostSize.X * sizeof(uint32));
+			}
+			Frame.Cost->Unlock();
+			Frame.Cost.Reset();
+
+			AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask,
+				[Filename = MoveTemp(Frame.DumpFilename), Cost = MoveTemp(Cost), Size = Frame.CostSize, MaxSteps = Frame.MaxSteps, Counters = MoveTemp(Counters)]() {
+					WriteDump(Filename, Cost, Size, MaxSteps, Counters);
+				});
+		}
+		Frame.DumpFilename.Reset();
+		Frame.bPending = false;
+		ReadIndex = (ReadIndex + 1) % NumFrames;
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderGraphUtils.h"
+#include "RHIGPUReadback.h"
+
+/**
+ * March cost counters of the `STATS` permutation of "CloudMarchCS.usf", must match "CostStats.ush".
+ * Each metric has a histogram of its per-pixel count, followed by the number of rays which ended in each way,
+ * and the total count of each metric.
+ */
+namespace VaporCostStats {
+	/* Histogram bins of each metric, counts past the last bin fall into it */
+	constexpr int32 NumBins = 64;
+	constexpr int32 BinWidth = 8;
+
+	enum EMetric : int32 {
+		PrimarySteps, /* Density samples which took a step */
+		SDFSkips,     /* Samples outside the cloud which skipped ahead by the SDF */
+		CacheLookups, /* Light cache or precomputed lighting lookups */
+		NumMetrics
+	};
+
+	enum ETermination : int32 {
+		Missed,    /* The ray missed the bounds or the proxy hull */
+		Exited,    /* The ray left the bounds */
+		Opaque,    /* The ray terminated early, the cloud became opaque */
+		Exhausted, /* The ray ran out of steps */
+		NumTerminations
+	};
+
+	constexpr int32 TerminationOffset = NumMetrics * NumBins;
+	constexpr int32 TotalOffset = TerminationOffset + NumTerminations;
+	constexpr int32 NumCounters = TotalOffset + NumMetrics;
+
+	/** @brief Unpack the per-pixel cost of the cost texture, into the metric counts and the termination. */
+	inline void UnpackCost(const uint32 Packed, int32 OutCounts[NumMetrics], int32& OutTermination) {
+		OutCounts[PrimarySteps] = Packed & 0x1FF;
+		OutCounts[SDFSkips] = (Packed >> 9) & 0x1FF;
+		OutCounts[CacheLookups] = (Packed >> 18) & 0x3FF;
+		OutTermination = (Packed >> 28) & 0x3;
+	}
+
+	/** @brief Dump the cost of the next frame with stats into a heatmap and a histogram, next to `Filename`. (any thread) */
+	void RequestDump(const FString& Filename);
+}
+
+/* Summary of the march cost counters of a frame. */
+struct FVaporCostSummary {
+	int32 NumRays = 0;
+	float Mean[VaporCostStats::NumMetrics] = {};
+	int32 P95[VaporCostStats::NumMetrics] = {};  /* Upper edge of the bin holding the 95th percentile */
+	int32 Max[VaporCostStats::NumMetrics] = {};  /* Upper edge of the highest bin */
+	float TerminationPct[VaporCostStats::NumTerminations] = {};
+
+	/** @brief Summarize the read back counters of a frame. */
+	static FVaporCostSummary FromCounters(const uint32* Counters);
+};
+
+/* Reads the march cost counters back without stalling, and publishes them as stats, CSV profiler stats and dumps. */
+class FVaporCostStats {
+	/* Number of frames which can be in flight before we skip measuring */
+	static constexpr int32 NumFrames = 4;
+
+	struct FFrame {
+		TUniquePtr<FRHIGPUBufferReadback> Counters;
+		TUniquePtr<FRHIGPUTextureReadback> Cost;
+		FIntPoint CostSize = FIntPoint::ZeroValue;
+		int32 MaxSteps = 0;
+		FString DumpFilename; /* Empty unless this frame is dumped */
+		bool bPending = false;
+	};
+
+	FFrame Frames[NumFrames];
+	int32 WriteIndex = 0;
+	int32 ReadIndex = 0;
+	bool bMeasuring = false;
+
+public:
+	/** @brief Check if this frame is measured, because stats are enabled or a dump is requested. (render thread) */
+	bool Begin(const bool bEnabled);
+
+	/** @brief Queue the readback of the counters, and of the cost texture if the frame is dumped. Only call this if `Begin` returned true. (render thread) */
+	void End(FRDGBuilder& GraphBuilder, FRDGBufferRef Counters, FRDGTextureRef Cost, const int32 MaxSteps);
+
+	/** @brief Read back the finished frames, and publish them. (render thread) */
+	void Poll();
+};
@@ -0,0 +1,29 @@
+#include "VaporDensity.h"
+
+void VaporDensity::BuildLUT(const float Density, TArray<float>& OutLUT) {
+	OutLUT.SetNumUninitialized(LUTSizeX * LUTSizeY);
+
+	/* Texel centers sit on the ends of both axes, so the GPU never filters past them */
+	const float InvLUTScale = 1.0f / GetLUTScale(Density);
+	for (int32 y = 0; y < LUTSizeY; ++y) {
+		const float StoredDensity = (float)y / (LUTSizeY - 1) * InvLUTScale;
+		for (int32 x = 0; x < LUTSizeX; ++x) {
+			/* The x axis is the square root of the eroded density, the steep start of the power keeps its precision */
+			const float SqrtEroded = (float)x / (LUTSizeX - 1);
+			OutLUT[x + y * LUTSizeX] = Transform(SqrtEroded * SqrtEroded, StoredDensity * Density);
+		}
+	}
+}
+
+float VaporDensity::SampleLUT(const TArray<float>& LUT, const float Density, const float ErodedDensity, const float StoredDensity) {
+	const float X = FMath::Sqrt(FMath::Clamp(ErodedDensity, 0.0f, 1.0f)) * (LUTSizeX - 1);
+	const float Y = FMath::Clamp(StoredDensity * GetLUTScale(Density), 0.0f, 1.0f) * (LUTSizeY - 1);
+	const int32 X0 = FMath::Min(FMath::FloorToInt32(X), LUTSizeX - 2);
+	const int32 Y0 = FMath::Min(FMath::FloorToInt32(Y), LUTSizeY - 2);
+	const float FX = X - X0;
+	const float FY = Y - Y0;
+
+	const float* Row0 = &LUT[Y0 * LUTSizeX];
+	const float* Row1 = Row0 + LUTSizeX;
+	return FMath::Lerp(FMath::Lerp(Row0[X0], Row0[X0 + 1], FX), FMath::Lerp(Row1[X0], Row1[X0 + 1], FX), FY);
+}
@@ -9,11 +9,23 @@
 #include "VaporComponent.h"
 #include "Misc/Optional.h"
 #include "VaporCloud.h"
+#include "VaporCloudSequence.h"
+#include "VaporCloudscape.h"
+#include "VaporDensity.h"
 #include "VDBLoader.h"
+#include "VaporCloudTextures.h"
+#include "VaporTrace.h"
+#include "PixelShaderUtils.h"
+#include "SystemTextures.h"
+#include "CommonRenderResources.h"
 #include <RenderTargetPool.h>
 
 IMPLEMENT_GLOBAL_SHADER(FCloudShader, "/Plugins/Vapor/CloudMarchCS.usf", "MainCS", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FCloudCompositeShader, "/Plugins/Vapor/CloudCompositePS.usf", "MainPS", SF_Pixel);
+IMPLEMENT_GLOBAL_SHADER(FCloudHullVS, "/Plugins/Vapor/CloudHull.usf", "MainVS", SF_Vertex);
+IMPLEMENT_GLOBAL_SHADER(FCloudHullPS, "/Plugins/Vapor/CloudHull.usf", "MainPS", SF_Pixel);
 IMPLEMENT_GLOBAL_SHADER(FBakeShader, "/Plugins/Vapor/CloudBakeCS.usf", "MainCS", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FBeerShadowMapShader, "/Plugins/Vapor/BeerShadowMapCS.usf", "MainCS", SF_Compute);
 
 IMPLEMENT_UNIFORM_BUFFER_STRUCT(FCloudscapeRenderData, "Cloud");
 
@@ -25,8 +37,95 @@ namespace {
 		TEXT(" 0: OFF;")
 		TEXT(" 1: ON."),
 		ECVF_RenderThreadSafe);
+
+	TAutoConsoleVariable<int32> CVarQuality(
+		TEXT("r.Vapor.Quality"),
+		-1,
+		TEXT("Vapor Cloud Rendering quality tier \n")
+		TEXT(" -1: Follow sg.EffectsQuality; (default)")
+		TEXT(" 0: Low, 64 steps, direct scattering only;")
+		TEXT(" 1: Medium, 128 steps, no multi-scattering;")
+		TEXT(" 2: High, 192 steps;")
+		TEXT(" 3: Epic, 256 steps."),
+		ECVF_Scalability | ECVF_RenderThreadSafe);
+
+	TAutoConsoleVariable<float> CVarTargetMs(
+		TEXT("r.Vapor.TargetMs"),
+		0.0f,
+		TEXT("GPU time budget of Vapor Cloud Rendering in milliseconds \n")
+		TEXT(" 0: OFF, use the component quality settings; (default)")
+		TEXT(" >0: Adjust the step sizes and resolution scale within the component bounds to meet the budget."),
+		ECVF_RenderThreadSafe);
+
+	TAutoConsoleVariable<int32> CVarTileBudgetMB(
+		TEXT("r.Vapor.TileBudgetMB"),
+		512,
+		TEXT("VRAM budget of the tiled cloudscape atlases in megabytes \n")
+		TEXT(" The coarsest LOD is covered first, the rest of the budget goes to the finer LODs."),
+		ECVF_Scalability | ECVF_RenderThreadSafe);
+
+	TAutoConsoleVariable<int32> CVarProxyHull(
+		TEXT("r.Vapor.ProxyHull"),
+		1,
+		TEXT("Rasterize the proxy hull of the cloud asset to start and stop each ray at the hull \n")
+		TEXT(" 0: OFF, march the full bounding box;")
+		TEXT(" 1: ON. (default)"),
+		ECVF_RenderThreadSafe);
+
+	TAutoConsoleVariable<float> CVarLODBias(
+		TEXT("r.Vapor.LODBias"),
+		0.0f,
+		TEXT("Bias of the footprint LOD, in mips. Positive values pick coarser field mips and drop the erosion noise sooner, \n")
+		TEXT("negative values keep full detail further away. (default: 0)"),
+		ECVF_RenderThreadSafe);
+
+	TAutoConsoleVariable<int32> CVarStats(
+		TEXT("r.Vapor.Stats"),
+		0,
+		TEXT("Count the primary steps, SDF skips, light cache lookups and early terminations of the cloud march \n")
+		TEXT(" 0: OFF; (default)")
+		TEXT(" 1: ON, shown in \"stat vapor\" and recorded by the CSV profiler."),
+		ECVF_RenderThreadSafe);
+
+	/* Distance the proxy hull pre-pass is cleared to, must match `HULL_MISS` in "Common.ush" */
+	constexpr float HullMiss = 1e30f;
+
+	/** @brief Get the active cloud quality tier. */
+	int32 GetQualityTier() {
+		int32 Quality = CVarQuality.GetValueOnRenderThread();
+		if (Quality < 0) {
+			static const TConsoleVariableData<int32>* CVarEffectsQuality = IConsoleManager::Get().FindTConsoleVariableDataInt(TEXT("sg.EffectsQuality"));
+			Quality = CVarEffectsQuality ? CVarEffectsQuality->GetValueOnAnyThread() : FCloudShader::NumQualityTiers - 1;
+		}
+		return FMath::Clamp(Quality, 0, FCloudShader::NumQualityTiers - 1);
+	}
+
+	/** @brief Fit a Beer shadow map slice looking along `Dir` tightly around the cloud bounds. */
+	void FitShadowMapSlice(FBeerShadowMapParameters& Out, const int32 Slice, const FVector3f& Dir, const FVector3f& BoundsMin, const FVector3f& BoundsMax) {
+		FVector3f AxisU, AxisV;
+		Dir.FindBestAxisVectors(AxisU, AxisV);
+
+		/* Project the corners of the bounds onto the axes of the slice */
+		FVector3f Min(UE_BIG_NUMBER), Max(-UE_BIG_NUMBER);
+		for (int32 i = 0; i < 8; ++i) {
+			const FVector3f Corner((i & 1) ? BoundsMax.X : BoundsMin.X, (i & 2) ? BoundsMax.Y : BoundsMin.Y, (i & 4) ? BoundsMax.Z : BoundsMin.Z);
+			const FVector3f Projected(Corner | AxisU, Corner | AxisV, Corner | Dir);
+			Min = FVector3f::Min(Min, Projected);
+			Max = FVector3f::Max(Max, Projected);
+		}
+		const FVector3f Size = FVector3f::Max(Max - Min, FVector3f(1.0f));
+
+		/* The rays start on the plane nearest to the light, the axes map the bounds onto 0..1 */
+		const FVector3f Origin = AxisU * Min.X + AxisV * Min.Y + Dir * Min.Z;
+		Out.ShadowMapOrigin[Slice] = FVector4f(Origin, Size.Z);
+		Out.ShadowMapAxisU[Slice] = FVector4f(AxisU / Size.X, 0.0f);
+		Out.ShadowMapAxisV[Slice] = FVector4f(AxisV / Size.Y, 0.0f);
+		Out.ShadowMapDir[Slice] = FVector4f(Dir, 0.0f);
+	}
 }
 
+DECLARE_GPU_STAT_NAMED(VaporCloudRendering, TEXT("Vapor Cloud Rendering"));
+
 enum ERenderTarget {
 	ESceneColor  = 0, /* [0] "SceneColor" */
 	EWorldNormal = 1, /* [1]  "GBufferA"  */
@@ -37,18 +136,219 @@ enum ERenderTarget {
 
 FVaporExtension::FVaporExtension(const FAutoRegister& AutoRegister) : FSceneViewExtensionBase(AutoRegister) {
 	UE_LOG(LogTemp, Log, TEXT("Vapor: Custom SceneViewExtension registered"));
+}
 
-	// Create 8-bit 2 channel unorm cache grid texture.
-	const FPooledRenderTargetDesc CacheDataDesc = FPooledRenderTargetDesc::CreateVolumeDesc(
-		512 / 2, 512 / 2, 64 / 2, PF_R8G8, FClearValueBinding::None,
+void FVaporExtension::AllocateLightCache(FRHICommandListImmediate& RHICmdList) {
+	using namespace VaporLightCache;
+	LightCacheAtlas.SafeRelease();
+	LightCachePageTable.SafeRelease();
+	LightCacheDirty = false;
+
+	const int32 NumPages = LightCachePages.Num();
+	if (NumPages == 0) return;
+
+	/* Both layouts store 16-bit path densities, pages pay for their border so past ~50% occupancy a dense cache is smaller */
+	const int64 SparseBytes = (int64)NumPages * PhysicalPageSize * PhysicalPageSize * PhysicalPageSize * 4;
+	const int64 DenseBytes = (int64)ResolutionX * ResolutionY * ResolutionZ * 4;
+	LightCacheDense = SparseBytes >= DenseBytes;
+
+	/* Fit the allocated pages into a roughly cubic atlas, the dense cache is a single atlas of every voxel */
+	FIntVector AtlasSize;
+	if (LightCacheDense) {
+		LightCacheAtlasPages = FIntVector(PagesX, PagesY, PagesZ);
+		AtlasSize = FIntVector(ResolutionX, ResolutionY, ResolutionZ);
+	} else {
+		const int32 AtlasPagesXY = FMath::CeilToInt32(FMath::Pow((float)NumPages, 1.0f / 3.0f));
+		LightCacheAtlasPages = FIntVector(AtlasPagesXY, AtlasPagesXY, FMath::DivideAndRoundUp(NumPages, AtlasPagesXY * AtlasPagesXY));
+		AtlasSize = LightCacheAtlasPages * PhysicalPageSize;
+	}
+
+	// Create 2 channel 16-bit unorm cache atlas texture.
+	const FPooledRenderTargetDesc AtlasDesc = FPooledRenderTargetDesc::CreateVolumeDesc(
+		AtlasSize.X, AtlasSize.Y, AtlasSize.Z, PF_G16R16, FClearValueBinding::None,
 		TexCreate_None, TexCreate_ShaderResource | TexCreate_UAV, false
 	);
-	GRenderTargetPool.FindFreeElement(
-		FRHICommandListExecutor::GetImmediateCommandList(),
-		CacheDataDesc,
-		PersistentCacheData,
-		TEXT("Density Cache Data Texture")
+	GRenderTargetPool.FindFreeElement(RHICmdList, AtlasDesc, LightCacheAtlas, TEXT("Light Cache Atlas"));
+
+	// Create the page table texture, which maps logical pages to atlas pages.
+	const FPooledRenderTargetDesc PageTableDesc = FPooledRenderTargetDesc::CreateVolumeDesc(
+		PagesX, PagesY, PagesZ, PF_R32_UINT, FClearValueBinding::None,
+		TexCreate_None, TexCreate_ShaderResource, false
 	);
+	GRenderTargetPool.FindFreeElement(RHICmdList, PageTableDesc, LightCachePageTable, TEXT("Light Cache Page Table"));
+
+	/* Fill in and upload the page table, the dense cache leaves it empty */
+	TArray<uint32> PageTable;
+	PageTable.SetNumZeroed(PagesX * PagesY * PagesZ);
+	for (int32 i = 0; i < (LightCacheDense ? 0 : NumPages); ++i) {
+		const uint32 Page = LightCachePages[i];
+		const int32 X = Page & 0x3FF, Y = (Page >> 10) & 0x3FF, Z = (Page >> 20) & 0x3FF;
+		const int32 AX = i % LightCacheAtlasPages.X;
+		const int32 AY = (i / LightCacheAtlasPages.X) % LightCacheAtlasPages.Y;
+		const int32 AZ = i / (LightCacheAtlasPages.X * LightCacheAtlasPages.Y);
+		PageTable[X + (Y * PagesX) + (Z * PagesX * PagesY)] = PackPage(AX, AY, AZ) | 0x80000000u;
+	}
+	RHICmdList.UpdateTexture3D(LightCachePageTable->GetRHI(), 0,
+		FUpdateTextureRegion3D(0, 0, 0, 0, 0, 0, PagesX, PagesY, PagesZ),
+		PagesX * sizeof(uint32), PagesX * PagesY * sizeof(uint32), (const uint8*)PageTable.GetData());
+
+	UE_LOG(LogTemp, Log, TEXT("Vapor: Light cache allocated %d of %d pages (%.2f MB, %s)"),
+		NumPages, PagesX * PagesY * PagesZ, (float)FMath::Min(SparseBytes, DenseBytes) / (1024.0f * 1024.0f), LightCacheDense ? TEXT("dense") : TEXT("sparse"));
+}
+
+int32 FVaporExtension::UploadSequenceFrame(FRHICommandListImmediate& RHICmdList, const FVaporSequenceFrame& Frame, const int32 KeepSlot) {
+	/* The frame is already resident if it was the next frame before, or another view uploaded it */
+	for (int32 i = 0; i < 2; ++i) {
+		if (SequenceGPUFrames[i] == Frame.Id) return i;
+	}
+
+	const int32 Slot = KeepSlot == 0 ? 1 : 0;
+	const FIntVector Size = Frame.Size;
+	const int64 NumVoxels = (int64)Size.X * Size.Y * Size.Z;
+	if (!SequenceDensity[Slot].IsValid() || SequenceDensity[Slot]->GetDesc().GetSize() != Size) {
+		// Create 8-bit density and 16-bit SDF textures, the same formats as the cloud asset fields.
+		const FPooledRenderTargetDesc DensityDesc = FPooledRenderTargetDesc::CreateVolumeDesc(
+			Size.X, Size.Y, Size.Z, PF_G8, FClearValueBinding::None,
+			TexCreate_None, TexCreate_ShaderResource, false
+		);
+		GRenderTargetPool.FindFreeElement(RHICmdList, DensityDesc, SequenceDensity[Slot], TEXT("Sequence Density Texture"));
+		const FPooledRenderTargetDesc SDFDesc = FPooledRenderTargetDesc::CreateVolumeDesc(
+			Size.X, Size.Y, Size.Z, PF_G16, FClearValueBinding::None,
+			TexCreate_None, TexCreate_ShaderResource, false
+		);
+		GRenderTargetPool.FindFreeElement(RHICmdList, SDFDesc, SequenceSDF[Slot], TEXT("Sequence SDF Texture"));
+	}
+
+	/* Upload the density followed by the SDF of the payload */
+	const uint8* Payload = Frame.Payload->GetData();
+	RHICmdList.UpdateTexture3D(SequenceDensity[Slot]->GetRHI(), 0,
+		FUpdateTextureRegion3D(0, 0, 0, 0, 0, 0, Size.X, Size.Y, Size.Z),
+		Size.X * sizeof(uint8), Size.X * Size.Y * sizeof(uint8), Payload);
+	RHICmdList.UpdateTexture3D(SequenceSDF[Slot]->GetRHI(), 0,
+		FUpdateTextureRegion3D(0, 0, 0, 0, 0, 0, Size.X, Size.Y, Size.Z),
+		Size.X * sizeof(uint16), Size.X * Size.Y * sizeof(uint16), Payload + NumVoxels * sizeof(uint8));
+
+	SequenceGPUFrames[Slot] = Frame.Id;
+	return Slot;
+}
+
+void FVaporExtension::UploadCloudFields(FRHICommandListImmediate& RHICmdList, const FVaporCloudFields& Fields) {
+	/* Corrupt fields are dropped, rather than rendering a half decoded cloud or the previous one */
+	if (!Fields.bValid) {
+		FieldDensity.SafeRelease();
+		FieldSDF.SafeRelease();
+		UE_LOG(LogTemp, Error, TEXT("Vapor: Cloud fields are corrupt, try re-importing the cloud"));
+		return;
+	}
+
+	const FIntVector Size = Fields.Size;
+	const int32 NumMips = Fields.DensityMips.Num();
+	if (!FieldDensity.IsValid() || FieldDensity->GetDesc().GetSize() != Size || FieldDensity->GetDesc().NumMips != NumMips) {
+		// Create 8-bit density and 16-bit SDF textures, the same formats as the volume texture fields.
+		const FPooledRenderTargetDesc DensityDesc = FPooledRenderTargetDesc::CreateVolumeDesc(
+			Size.X, Size.Y, Size.Z, PF_G8, FClearValueBinding::None,
+			TexCreate_None, TexCreate_ShaderResource, false, NumMips
+		);
+		GRenderTargetPool.FindFreeElement(RHICmdList, DensityDesc, FieldDensity, TEXT("Cloud Density Texture"));
+		const FPooledRenderTargetDesc SDFDesc = FPooledRenderTargetDesc::CreateVolumeDesc(
+			Size.X, Size.Y, Size.Z, PF_G16, FClearValueBinding::None,
+			TexCreate_None, TexCreate_ShaderResource, false, NumMips
+		);
+		GRenderTargetPool.FindFreeElement(RHICmdList, SDFDesc, FieldSDF, TEXT("Cloud SDF Texture"));
+	}
+
+	/* The fields were decoded on a worker thread, all that's left is copying them into the textures */
+	const double StartTime = FPlatformTime::Seconds();
+	int64 RawBytes = 0;
+	for (int32 Mip = 0; Mip < NumMips; ++Mip) {
+		const FIntVector MipSize = UVaporCloud::GetMipSize(Size, Mip);
+		const FUpdateTextureRegion3D Region(0, 0, 0, 0, 0, 0, MipSize.X, MipSize.Y, MipSize.Z);
+		RHICmdList.UpdateTexture3D(FieldDensity->GetRHI(), Mip, Region,
+			MipSize.X * sizeof(uint8), MipSize.X * MipSize.Y * sizeof(uint8), Fields.DensityMips[Mip].GetData());
+		RHICmdList.UpdateTexture3D(FieldSDF->GetRHI(), Mip, Region,
+			MipSize.X * sizeof(uint16), MipSize.X * MipSize.Y * sizeof(uint16), Fields.SDFMips[Mip].GetData());
+		RawBytes += Fields.DensityMips[Mip].Num() + Fields.SDFMips[Mip].Num();
+	}
+	const double UploadMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	const float RawMB = (float)RawBytes / (1024.0f * 1024.0f);
+	const float CompressedMB = (float)Fields.CompressedBytes / (1024.0f * 1024.0f);
+	UE_LOG(LogTemp, Log, TEXT("Vapor: Loaded cloud fields, %.2f MB from %.2f MB on disk (%.1fx), read %.2f ms, decoded %.2f ms (%.0f MB/s), uploaded %.2f ms"),
+		RawMB, CompressedMB, RawMB / FMath::Max(CompressedMB, UE_SMALL_NUMBER), Fields.ReadMs, Fields.DecodeMs, RawMB / FMath::Max(Fields.DecodeMs / 1000.0, UE_DOUBLE_SMALL_NUMBER), UploadMs);
+}
+
+void FVaporExtension::UpdateTileAtlas(FRHICommandListImmediate& RHICmdList, const int32 Slots[VaporCloudscape::NumLODs], const TArray<FVaporTileUpload>& Uploads, const TArray<uint32>& Table, const FIntPoint NumTiles) {
+	using namespace VaporCloudscape;
+
+	/* (Re)allocate the atlases when the slot counts change */
+	FIntVector AtlasSlots[NumLODs];
+	for (int32 LOD = 0; LOD < NumLODs; ++LOD) {
+		AtlasSlots[LOD] = GetAtlasSlots(LOD, Slots[LOD]);
+		const FIntVector AtlasSize = AtlasSlots[LOD] * GetPhysicalSize(LOD);
+		if (TileDensityAtlas[LOD].IsValid() && TileDensityAtlas[LOD]->GetDesc().GetSize() == AtlasSize) continue;
+
+		// Create 8-bit density and 16-bit SDF atlases, the same formats as the cloud asset fields.
+		const FPooledRenderTargetDesc DensityDesc = FPooledRenderTargetDesc::CreateVolumeDesc(
+			AtlasSize.X, AtlasSize.Y, AtlasSize.Z, PF_G8, FClearValueBinding::None,
+			TexCreate_None, TexCreate_ShaderResource, false
+		);
+		GRenderTargetPool.FindFreeElement(RHICmdList, DensityDesc, TileDensityAtlas[LOD], TEXT("Tile Density Atlas"));
+		const FPooledRenderTargetDesc SDFDesc = FPooledRenderTargetDesc::CreateVolumeDesc(
+			AtlasSize.X, AtlasSize.Y, AtlasSize.Z, PF_G16, FClearValueBinding::None,
+			TexCreate_None, TexCreate_ShaderResource, false
+		);
+		GRenderTargetPool.FindFreeElement(RHICmdList, SDFDesc, TileSDFAtlas[LOD], TEXT("Tile SDF Atlas"));
+
+		UE_LOG(LogTemp, Log, TEXT("Vapor: Tile atlas LOD %d allocated %d slots (%.2f MB)"),
+			LOD, Slots[LOD], (float)AtlasSize.X * AtlasSize.Y * AtlasSize.Z * 3 / (1024.0f * 1024.0f));
+	}
+
+	/* Upload the streamed in tiles into their slots, the density followed by the SDF of the payload */
+	for (const FVaporTileUpload& Upload : Uploads) {
+		const FIntVector Size = GetPhysicalSize(Upload.LOD);
+		const FIntVector Offset = GetSlotCoord(Upload.Slot, AtlasSlots[Upload.LOD]) * Size;
+		const int64 NumVoxels = (int64)Size.X * Size.Y * Size.Z;
+		const uint8* Payload = Upload.Payload->GetData();
+		RHICmdList.UpdateTexture3D(TileDensityAtlas[Upload.LOD]->GetRHI(), 0,
+			FUpdateTextureRegion3D(Offset.X, Offset.Y, Offset.Z, 0, 0, 0, Size.X, Size.Y, Size.Z),
+			Size.X * sizeof(uint8), Size.X * Size.Y * sizeof(uint8), Payload);
+		RHICmdList.UpdateTexture3D(TileSDFAtlas[Upload.LOD]->GetRHI(), 0,
+			FUpdateTextureRegion3D(Offset.X, Offset.Y, Offset.Z, 0, 0, 0, Size.X, Size.Y, Size.Z),
+			Size.X * sizeof(uint16), Size.X * Size.Y * sizeof(uint16), Payload + NumVoxels * sizeof(uint8));
+	}
+
+	/* Upload the tile table, after the tiles it points to */
+	if (Table.Num() != NumTiles.X * NumTiles.Y || Table.Num() == 0) return;
+	if (!TileTableTexture.IsValid() || TileTableTexture->GetDesc().Extent != NumTiles) {
+		const FPooledRenderTargetDesc TableDesc = FPooledRenderTargetDesc::Create2DDesc(
+			NumTiles, PF_R32_UINT, FClearValueBinding::None,
+			TexCreate_None, TexCreate_ShaderResource, false
+		);
+		GRenderTargetPool.FindFreeElement(RHICmdList, TableDesc, TileTableTexture, TEXT("Tile Table"));
+	}
+	RHICmdList.UpdateTexture2D(TileTableTexture->GetRHI(), 0,
+		FUpdateTextureRegion2D(0, 0, 0, 0, NumTiles.X, NumTiles.Y),
+		NumTiles.X * sizeof(uint32), (const uint8*)Table.GetData());
+}
+
+void FVaporExtension::UpdateDensityLUT(FRHICommandListImmediate& RHICmdList, const float Density) {
+	if (DensityLUT.IsValid() && Density == DensityLUTDensity) return;
+	DensityLUTDensity = Density;
+
+	TArray<float> LUT;
+	VaporDensity::BuildLUT(Density, LUT);
+
+	const FIntPoint Size(VaporDensity::LUTSizeX, VaporDensity::LUTSizeY);
+	if (!DensityLUT.IsValid()) {
+		const FPooledRenderTargetDesc LUTDesc = FPooledRenderTargetDesc::Create2DDesc(
+			Size, PF_R32_FLOAT, FClearValueBinding::None,
+			TexCreate_None, TexCreate_ShaderResource, false
+		);
+		GRenderTargetPool.FindFreeElement(RHICmdList, LUTDesc, DensityLUT, TEXT("Density LUT"));
+	}
+	RHICmdList.UpdateTexture2D(DensityLUT->GetRHI(), 0,
+		FUpdateTextureRegion2D(0, 0, 0, 0, Size.X, Size.Y),
+		Size.X * sizeof(float), (const uint8*)LUT.GetData());
 }
 
 void FVaporExtension::BeginRenderViewFamily(FSceneViewFamily& ViewFamily) {
@@ -63,8 +363,12 @@ void FVaporExtension::BeginRenderViewFamily(FSceneViewFamily& ViewFamily) {
 	if (!VaporInstance || !SunInstance) return;
 
 	/* Fill in the render data struct */
-	FCloudscapeRenderData Data {};
-	VaporInstance->GetComponent()->IntoRenderData(Data);
+	FVaporFrameInputs Frame;
+	Frame.Component = VaporInstance->GetComponent();
+	Frame.Time = World->GetTimeSeconds();
+	Frame.ViewOrigin = ViewFamily.Views.Num() > 0 ? ViewFamily.Views[0]->ViewMatrices.GetViewOrigin() : VaporInstance->GetActorLocation();
+	FCloudscapeRenderData& Data = Frame.Data;
+	Frame.Component->IntoRenderData(Data);
 	Data.Position = (FVector3f)VaporInstance->GetActorLocation();
 	Data.SunDir = -(FVector3f)SunInstance->GetComponent()->GetDirection();
 	Data.SunLuminance = (FVector3f)SunInstance->GetComponent()->GetColoredLightBrightness();
@@ -74,24 +378,189 @@ void FVaporExtension::BeginRenderViewFamily(FSceneViewFamily& ViewFamily) {
 		Data.AmbientLuminance *= AtmosphereTransmitance;
 	}
 
+	/* Record the frame while a trace is being captured (see `vapor.trace.start`) */
+	if (VaporTrace::IsCapturing() && ViewFamily.Views.Num() > 0) VaporTrace::CaptureFrame(Frame, *ViewFamily.Views[0]);
+
+	SetupFrame(Frame);
+}
+
+void FVaporExtension::SetupFrame(const FVaporFrameInputs& Frame) {
+	const UVaporComponent* Component = Frame.Component;
+
+	/* Stream in the frames of the cloud sequence, cloudscapes take precedence */
+	const UVaporCloudscape* Cloudscape = Component->Cloudscape;
+	const UVaporCloudSequence* CloudSequence = Cloudscape ? nullptr : Component->CloudSequence.Get();
+	FVaporSequenceState Sequence;
+	SequenceStreamer.SetSequence(CloudSequence);
+	if (CloudSequence) SequenceStreamer.Update(Frame.Time, Component->LoopSequence, Sequence);
+
+	/* The cloudscape bounds are replaced by the tile grid below */
+	FCloudscapeRenderData Data = Frame.Data;
+	Data.BoundsMin = Data.Position - FVector3f(VaporCloudscape::TileWorldSize, VaporCloudscape::TileWorldSize, VaporCloudscape::TileWorldHeight) * 0.5f;
+	Data.BoundsMax = Data.Position + FVector3f(VaporCloudscape::TileWorldSize, VaporCloudscape::TileWorldSize, VaporCloudscape::TileWorldHeight) * 0.5f;
+
+	/* Stream the tiles of the cloudscape in and out around the camera */
+	FVaporTileSettings TileSettings;
+	Component->IntoTileSettings(TileSettings);
+	const bool bTilesReset = TileStreamer.SetCloudscape(Cloudscape, TileSettings, (int64)FMath::Max(CVarTileBudgetMB.GetValueOnGameThread(), 0) * 1024 * 1024);
+	TArray<FVaporTileUpload> Uploads;
+	if (Cloudscape) {
+		const FVector3f WorldSize = Cloudscape->GetWorldSize();
+		const FVector3f Camera = (FVector3f)Frame.ViewOrigin;
+		Data.TilesOrigin = Data.Position - WorldSize * 0.5f;
+		Data.NumTiles = Cloudscape->NumTiles;
+		Data.BoundsMin = Data.TilesOrigin;
+		Data.BoundsMax = Data.TilesOrigin + WorldSize;
+		TileStreamer.Update(FVector2D(Camera.X - Data.TilesOrigin.X, Camera.Y - Data.TilesOrigin.Y), Uploads);
+
+		/* The light cache covers the area around the camera, snapped to whole pages so the lighting doesn't swim */
+		const float PageWorldSize = VaporLightCache::PageSize * VaporLightCache::Downsample * 800.0f;
+		Data.Position.X = FMath::RoundToFloat(Camera.X / PageWorldSize) * PageWorldSize;
+		Data.Position.Y = FMath::RoundToFloat(Camera.Y / PageWorldSize) * PageWorldSize;
+	}
+
+	/* Stream the compressed fields in when the cloud asset changes, they're read and decoded without blocking the game or render thread */
+	UVaporCloud* CloudAsset = Component->CloudAsset;
+	const bool bCompressedFields = !Cloudscape && !CloudSequence && CloudAsset && CloudAsset->HasCompressedFields();
+	FieldLoader.SetCloud(bCompressedFields ? CloudAsset : nullptr);
+	TSharedPtr<FVaporCloudFields, ESPMode::ThreadSafe> Fields = FieldLoader.Update();
+
+	/* Initialize the noise texture if it's not initialized yet */
+	if (NoiseTexture == nullptr) {
+		NoiseTexture = LoadAlligatorNoise(NoiseMean);
+	}
+	Data.NoiseMean = NoiseMean;
+
 	{ /* Lock and update the render data */
 		FScopeLock Lock(&RenderDataLock);
-		DebugMode = VaporInstance->GetComponent()->Debug;
+		DebugMode = Component->Debug;
+		PrecomputedLighting = Component->LightingMode == ECloudLightingMode::Precomputed;
+		ShadowMapLighting = Component->LightingMode == ECloudLightingMode::ShadowMap;
+		DirectScattering = Component->DirectScattering;
+		MultiScattering = Component->MultiScattering;
+		AmbientScattering = Component->AmbientScattering;
+		Component->IntoQualityBounds(QualityBounds);
 		RenderData = MoveTemp(Data);
+		SequenceState = MoveTemp(Sequence);
+
+		/* Queue the tile uploads for the render thread, uploads from before a reset point at stale slots */
+		TiledCloudscape = Cloudscape != nullptr;
+		if (bTilesReset) TileUploads.Reset();
+		TileUploads.Append(MoveTemp(Uploads));
+		TileTable = TileStreamer.GetTileTable();
+		TileTableSize = Cloudscape ? Cloudscape->NumTiles : FIntPoint::ZeroValue;
+		FMemory::Memcpy(TileSlots, TileStreamer.GetSlots(), sizeof(TileSlots));
+
+		/* Queue the decoded fields for uploading, nothing is rendered until they're ready */
+		CompressedFields = bCompressedFields && FieldLoader.IsLoaded();
+		if (Fields.IsValid()) PendingFields = MoveTemp(Fields);
+
+		/* Re-allocate the light cache when the cloud asset changes */
+		const UObject* CacheCloud = Cloudscape ? (const UObject*)Cloudscape : CloudSequence ? (const UObject*)CloudSequence : CloudAsset;
+		if (CacheCloud != LightCacheCloud) {
+			LightCacheCloud = CacheCloud;
+			LightCachePages.Reset();
+			if (CacheCloud == CloudAsset && CloudAsset && CloudAsset->LightCachePages.Num() > 0) {
+				LightCachePages = CloudAsset->LightCachePages;
+			} else if (CacheCloud) {
+				/* Cloudscapes, sequences, and assets imported before the sparse cache allocate every page, which makes the cache dense */
+				using namespace VaporLightCache;
+				for (int32 z = 0; z < PagesZ; ++z) for (int32 y = 0; y < PagesY; ++y) for (int32 x = 0; x < PagesX; ++x) {
+					LightCachePages.Add(PackPage(x, y, z));
+				}
+			}
+			LightCacheDirty = true;
+
+			/* Only cloud assets have a proxy hull, sequences and cloudscapes march their full bounds */
+			/* Clouds imported before the brick occupancy was stored can't tell when the camera is inside their hull, and march their full bounds too */
+			ProxyHull.Reset();
+			ProxyHullOccupancy.Reset();
+			if (CacheCloud == CloudAsset && CloudAsset && CloudAsset->ProxyHullBricks != FIntVector::ZeroValue) {
+				ProxyHull = CloudAsset->ProxyHull;
+				ProxyHullSize = CloudAsset->FieldSize;
+				ProxyHullBricks = CloudAsset->ProxyHullBricks;
+				ProxyHullOccupancy = CloudAsset->ProxyHullOccupancy;
+			}
+		}
 	}
 
-	/* Get the different textures from the cloud asset */
-	if (VaporInstance->GetComponent()->CloudAsset) {
-		DensityTexture = VaporInstance->GetComponent()->CloudAsset->DensityField->GetResource();
-		if (DensityTexture == nullptr) DensityTexture = VaporInstance->GetComponent()->CloudAsset->DensityField->CreateResource();
-		SDFTexture = VaporInstance->GetComponent()->CloudAsset->SignedDistanceField->GetResource();
-		if (SDFTexture == nullptr) SDFTexture = VaporInstance->GetComponent()->CloudAsset->SignedDistanceField->CreateResource();
+	/* Get the different textures from the cloud asset, sequences and cloudscapes are streamed in instead */
+	if (CloudSequence || Cloudscape) {
+		DensityTexture = nullptr;
+		SDFTexture = nullptr;
+		TransmittanceTexture = nullptr;
+	} else if (CloudAsset) {
+		/* Compressed fields are decoded into textures on the render thread instead */
+		DensityTexture = nullptr;
+		SDFTexture = nullptr;
+		if (!bCompressedFields) {
+			DensityTexture = CloudAsset->DensityField->GetResource();
+			if (DensityTexture == nullptr) DensityTexture = CloudAsset->DensityField->CreateResource();
+			SDFTexture = CloudAsset->SignedDistanceField->GetResource();
+			if (SDFTexture == nullptr) SDFTexture = CloudAsset->SignedDistanceField->CreateResource();
+		}
+		TransmittanceTexture = nullptr;
+		if (UVolumeTexture* TransmittanceField = CloudAsset->TransmittanceField) {
+			TransmittanceTexture = TransmittanceField->GetResource();
+			if (TransmittanceTexture == nullptr) TransmittanceTexture = TransmittanceField->CreateResource();
+		}
 	}
+}
 
-	/* Initialize the noise texture if it's not initialized yet */
-	if (NoiseTexture == nullptr) {
-		NoiseTexture = LoadAlligatorNoise();
+bool FVaporExtension::UploadFrame(FRHICommandListImmediate& RHICmdList, FVaporFrameResources& Out) {
+	/* Grab the sequence frames to display, and the tiles to upload */
+	FVaporSequenceState Sequence;
+	TArray<FVaporTileUpload> Uploads;
+	TArray<uint32> Table;
+	FIntPoint NumTiles;
+	int32 Slots[VaporCloudscape::NumLODs];
+	bool bTiled, bFields;
+	float Density;
+	TSharedPtr<FVaporCloudFields, ESPMode::ThreadSafe> Fields;
+	{
+		FScopeLock Lock(&RenderDataLock);
+		Density = RenderData.Density;
+		Sequence = SequenceState;
+		Fields = MoveTemp(PendingFields);
+		bFields = CompressedFields;
+		Uploads = MoveTemp(TileUploads);
+		Table = TileTable;
+		NumTiles = TileTableSize;
+		FMemory::Memcpy(Slots, TileSlots, sizeof(Slots));
+		bTiled = TiledCloudscape;
+	}
+	const bool bSequence = Sequence.Current.Payload.IsValid() && Sequence.Next.Payload.IsValid();
+	Out.bTiled = bTiled;
+	Out.bSequence = bSequence;
+	Out.bFields = bFields;
+
+	/* The density scale is looked up in a table, which only changes with the component density */
+	UpdateDensityLUT(RHICmdList, Density);
+
+	/* Upload the decoded fields of a newly assigned cloud asset */
+	if (Fields.IsValid()) {
+		UploadCloudFields(RHICmdList, *Fields);
+		Fields.Reset();
 	}
+	if (bFields && !FieldSDF.IsValid()) return false;
+
+	/* Make sure the cloud textures are set */
+	if (!bTiled && !bSequence && !bFields && (DensityTexture == nullptr || SDFTexture == nullptr)) return false;
+
+	/* Upload the streamed in tiles and the tile table */
+	if (bTiled) {
+		UpdateTileAtlas(RHICmdList, Slots, Uploads, Table, NumTiles);
+		if (!TileTableTexture.IsValid()) return false;
+	}
+
+	/* Upload the sequence frames, double-buffered so the next frame is resident before we blend towards it */
+	if (bSequence) {
+		const int32 KeepSlot = SequenceGPUFrames[0] == Sequence.Next.Id ? 0 : SequenceGPUFrames[1] == Sequence.Next.Id ? 1 : INDEX_NONE;
+		Out.CurrentSlot = UploadSequenceFrame(RHICmdList, Sequence.Current, KeepSlot);
+		Out.NextSlot = UploadSequenceFrame(RHICmdList, Sequence.Next, Out.CurrentSlot);
+	}
+	Out.Sequence = MoveTemp(Sequence);
+	return true;
 }
 
 void FVaporExtension::PrePostProcessPass_RenderThread(FRDGBuilder& GraphBuilder, const FSceneView& InView, const FPostProcessingInputs& Inputs) {
@@ -104,59 +573,294 @@ void FVaporExtension::PrePostProcessPass_RenderThread(FRDGBuilder& GraphBuilder,
 	/* Start the render graph event scope */
 	RDG_EVENT_SCOPE(GraphBuilder, "Vapor Render Pass");
 
-	/* Make sure the cloud textures are set */
-	if (DensityTexture == nullptr || SDFTexture == nullptr) return;
-
-	/* Make sure the persistent cache texture is valid */
-	if (PersistentCacheData.IsValid() == false) return;
+	/* Upload the cloud fields, tiles and sequence frames of this frame */
+	FVaporFrameResources Frame;
+	if (!UploadFrame(GraphBuilder.RHICmdList, Frame)) return;
+	const bool bTiled = Frame.bTiled, bSequence = Frame.bSequence, bFields = Frame.bFields;
+	const FVaporSequenceState& Sequence = Frame.Sequence;
+	const int32 CurrentSlot = Frame.CurrentSlot, NextSlot = Frame.NextSlot;
 
 	/* Convert the scene color texture to a screen pass texture */
 	FRDGTexture* SceneColor = Inputs.SceneTextures->GetContents()->SceneColorTexture;
 	FRDGTexture* SceneDepth = Inputs.SceneTextures->GetContents()->SceneDepthTexture;
-	const FIntPoint ViewSize = SceneColor->Desc.Extent;
+	/* Scene textures can be larger than the view, split screen and screen percentage only render into part of them */
+	const FIntRect ViewRect = InView.ViewRect;
+	const FIntPoint ViewSize = ViewRect.Size();
+
+	/* Profile every quality tier in turn when requested by `vapor.profilequality` */
+	if (const int32 ProfileFrames = FVaporQualityProfile::ConsumeRequest()) {
+		QualityProfile.Start(FCloudShader::NumQualityTiers, ProfileFrames);
+	}
+	const int32 ProfileTier = QualityProfile.BeginFrame(GFrameCounterRenderThread);
+
+	/* Feed the GPU time measurements of earlier frames into the quality profile, or the quality controller */
+	const float TargetMs = CVarTargetMs.GetValueOnRenderThread();
+	float GpuMs = 0.0f;
+	while (GPUTimer.Poll(GpuMs)) {
+		if (QualityProfile.AddMeasurement(GpuMs)) continue;
+		QualityController.Update(GpuMs, TargetMs);
+	}
+	if (QualityProfile.Finish()) QualityProfile.Log();
+
+	/* The profile measures the tiers at the best settings of the component */
+	if (TargetMs <= 0.0f || ProfileTier >= 0) QualityController.Reset();
+
+	/* Publish the march cost of earlier frames */
+	CostStats.Poll();
 
 	TUniformBufferRef<FCloudscapeRenderData> CloudRenderData;
+	FVaporMarchSettings MarchSettings;
+	FRDGBufferRef LightCachePageList = nullptr;
+	FVaporShadowMapKey ShadowMapKey;
+	bool bShadowMapLighting = false;
+	FRDGBufferRef HullVertices = nullptr;
+	FVector3f HullMin = FVector3f::ZeroVector, HullExtent = FVector3f::ZeroVector;
+	bool bHullCameraInside = false;
 	{ /* Create cloud render data uniform buffer */
 		FScopeLock Lock(&RenderDataLock);
-		RenderData.DensityTexture = GraphBuilder.RegisterExternalTexture(CreateRenderTarget(DensityTexture->GetTextureRHI(), TEXT("Density Texture")));
-		RenderData.SDFTexture = GraphBuilder.RegisterExternalTexture(CreateRenderTarget(SDFTexture->GetTextureRHI(), TEXT("SDF Texture")));
+		MarchSettings = FVaporMarchSettings::Lerp(QualityBounds.Cheapest, QualityBounds.Best, QualityController.GetQuality());
+		RenderData.PrimaryNearStep = MarchSettings.PrimaryNearStep;
+		RenderData.PrimaryStepPerDistance = MarchSettings.PrimaryStepPerDistance;
+		RenderData.SecondaryStep = MarchSettings.SecondaryStep;
+
+		/* Tiled cloudscapes are too large for a single shadow map, they keep the light cache */
+		bShadowMapLighting = ShadowMapLighting && !bTiled;
+		if (bShadowMapLighting) {
+			/* The shadow map replaces the light cache, release it until the lighting mode changes back */
+			if (LightCacheAtlas.IsValid()) {
+				LightCacheAtlas.SafeRelease();
+				LightCachePageTable.SafeRelease();
+				LightCachePageListBuffer.SafeRelease();
+				LightCacheDirty = true;
+			}
+			ShadowMapKey.Cloud = LightCacheCloud;
+			ShadowMapKey.Field = bFields ? FieldDensity->GetRHI() : DensityTexture ? DensityTexture->GetTextureRHI() : nullptr;
+			ShadowMapKey.SunDir = RenderData.SunDir;
+			ShadowMapKey.BoundsMin = RenderData.BoundsMin;
+			ShadowMapKey.BoundsMax = RenderData.BoundsMax;
+			ShadowMapKey.Absorption = RenderData.Absorption;
+			ShadowMapKey.Density = RenderData.Density;
+			ShadowMapKey.ProfileWidth = RenderData.ProfileWidth;
+			ShadowMapKey.SecondaryStep = RenderData.SecondaryStep;
+			ShadowMapKey.SecondaryExtinctThreshold = RenderData.SecondaryExtinctThreshold;
+		} else if (LightCacheDirty) {
+			AllocateLightCache(GraphBuilder.RHICmdList);
+
+			/* Upload the atlas page list once, it only changes with the pages */
+			LightCachePageListBuffer.SafeRelease();
+			if (LightCachePages.Num() > 0) {
+				FRDGBufferRef PageList = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), LightCachePages.Num()), TEXT("Light Cache Page List"));
+				GraphBuilder.QueueBufferUpload(PageList, LightCachePages.GetData(), LightCachePages.Num() * sizeof(uint32));
+				LightCachePageListBuffer = GraphBuilder.ConvertToExternalBuffer(PageList);
+			}
+		}
+		if (!bShadowMapLighting && LightCachePageListBuffer.IsValid()) {
+			LightCachePageList = GraphBuilder.RegisterExternalBuffer(LightCachePageListBuffer);
+		}
+		/* Upload the proxy hull triangles */
+		if (ProxyHull.Num() > 0 && !bTiled && !bSequence && CVarProxyHull.GetValueOnRenderThread() != 0) {
+			HullVertices = CreateStructuredBuffer(GraphBuilder, TEXT("Vapor Proxy Hull"), sizeof(FVector3f), ProxyHull.Num(), ProxyHull.GetData(), ProxyHull.Num() * sizeof(FVector3f));
+			HullMin = RenderData.BoundsMin;
+			HullExtent = RenderData.BoundsMax - RenderData.BoundsMin;
+
+			/* The hull distances are lower bounds per triangle, they can't prove the camera is outside, so the bricks decide */
+			const FVector3f CameraUVW = FVector3f((InView.ViewMatrices.GetViewOrigin() - FVector(HullMin)) / FVector(HullExtent));
+			bHullCameraInside = VaporProxyHull::IsNearOccupied(ProxyHullBricks, ProxyHullOccupancy, CameraUVW * FVector3f(ProxyHullSize));
+		}
+		if (bTiled) {
+			/* Cloudscapes only sample the tile atlases */
+			RenderData.FrameBlend = 0.0f;
+			RenderData.DensityTexture = GSystemTextures.GetVolumetricBlackDummy(GraphBuilder);
+			RenderData.SDFTexture = RenderData.DensityTexture;
+			RenderData.DensityTextureNext = RenderData.DensityTexture;
+			RenderData.SDFTextureNext = RenderData.DensityTexture;
+		} else if (bSequence) {
+			RenderData.FrameBlend = Sequence.Blend;
+			RenderData.DensityTexture = GraphBuilder.RegisterExternalTexture(SequenceDensity[CurrentSlot]);
+			RenderData.SDFTexture = GraphBuilder.RegisterExternalTexture(SequenceSDF[CurrentSlot]);
+			RenderData.DensityTextureNext = GraphBuilder.RegisterExternalTexture(SequenceDensity[NextSlot]);
+			RenderData.SDFTextureNext = GraphBuilder.RegisterExternalTexture(SequenceSDF[NextSlot]);
+		} else if (bFields) {
+			/* Static clouds bind the same field twice, and never blend */
+			RenderData.FrameBlend = 0.0f;
+			RenderData.DensityTexture = GraphBuilder.RegisterExternalTexture(FieldDensity);
+			RenderData.SDFTexture = GraphBuilder.RegisterExternalTexture(FieldSDF);
+			RenderData.DensityTextureNext = RenderData.DensityTexture;
+			RenderData.SDFTextureNext = RenderData.SDFTexture;
+		} else {
+			/* Clouds imported before the compressed fields use volume textures */
+			RenderData.FrameBlend = 0.0f;
+			RenderData.DensityTexture = GraphBuilder.RegisterExternalTexture(CreateRenderTarget(DensityTexture->GetTextureRHI(), TEXT("Density Texture")));
+			RenderData.SDFTexture = GraphBuilder.RegisterExternalTexture(CreateRenderTarget(SDFTexture->GetTextureRHI(), TEXT("SDF Texture")));
+			RenderData.DensityTextureNext = RenderData.DensityTexture;
+			RenderData.SDFTextureNext = RenderData.SDFTexture;
+		}
+
+		/* Bind the tile atlases, or dummies if this is not a tiled cloudscape */
+		FRDGTextureRef TileDensity[VaporCloudscape::NumLODs], TileSDF[VaporCloudscape::NumLODs];
+		FVector3f TileInvSize[VaporCloudscape::NumLODs];
+		for (int32 LOD = 0; LOD < VaporCloudscape::NumLODs; ++LOD) {
+			TileDensity[LOD] = bTiled ? GraphBuilder.RegisterExternalTexture(TileDensityAtlas[LOD]) : GSystemTextures.GetVolumetricBlackDummy(GraphBuilder);
+			TileSDF[LOD] = bTiled ? GraphBuilder.RegisterExternalTexture(TileSDFAtlas[LOD]) : TileDensity[LOD];
+			TileInvSize[LOD] = bTiled ? FVector3f(1.0f) / FVector3f(TileDensityAtlas[LOD]->GetDesc().GetSize()) : FVector3f::ZeroVector;
+		}
+		RenderData.TileTable = bTiled ? GraphBuilder.RegisterExternalTexture(TileTableTexture) : GSystemTextures.GetZeroUIntDummy(GraphBuilder);
+		RenderData.TileDensityAtlas0 = TileDensity[0];
+		RenderData.TileDensityAtlas1 = TileDensity[1];
+		RenderData.TileDensityAtlas2 = TileDensity[2];
+		RenderData.TileSDFAtlas0 = TileSDF[0];
+		RenderData.TileSDFAtlas1 = TileSDF[1];
+		RenderData.TileSDFAtlas2 = TileSDF[2];
+		RenderData.TileAtlasInvSize0 = TileInvSize[0];
+		RenderData.TileAtlasInvSize1 = TileInvSize[1];
+		RenderData.TileAtlasInvSize2 = TileInvSize[2];
+		RenderData.DensityLUTScale = VaporDensity::GetLUTScale(DensityLUTDensity);
+		RenderData.DensityLUT = GraphBuilder.RegisterExternalTexture(DensityLUT);
 		CloudRenderData = TUniformBufferRef<FCloudscapeRenderData>::CreateUniformBufferImmediate(RenderData, EUniformBufferUsage::UniformBuffer_SingleFrame);
 	}
 
 	/* Register external textures */
-	FRDGTextureRef FRDGCacheData = GraphBuilder.RegisterExternalTexture(PersistentCacheData, ERDGTextureFlags::MultiFrame);
 	FRDGTextureRef FRDGNoise = GraphBuilder.RegisterExternalTexture(CreateRenderTarget(NoiseTexture->GetResource()->GetTextureRHI(), TEXT("Noise Texture")));
 
-	{ /* Cloud bake pass */
+	/* Use the precomputed lighting if the cloud asset has a transmittance field */
+	const bool bPrecomputedLighting = PrecomputedLighting && TransmittanceTexture != nullptr;
+	FRDGTextureRef FRDGTransmittance = nullptr;
+	if (bPrecomputedLighting) {
+		FRDGTransmittance = GraphBuilder.RegisterExternalTexture(CreateRenderTarget(TransmittanceTexture->GetTextureRHI(), TEXT("Transmittance SH Texture")));
+	}
+
+	/* The shadow map and the precomputed lighting replace the light cache */
+	const bool bLightCache = !bPrecomputedLighting && !bShadowMapLighting;
+
+	/* Make sure the light cache is allocated if we need it */
+	if (bLightCache && (!LightCacheAtlas.IsValid() || LightCachePageList == nullptr)) return;
+
+	/* Register the light cache textures */
+	FRDGTextureRef FRDGCacheAtlas = nullptr;
+	FRDGTextureRef FRDGCachePageTable = nullptr;
+	FVector3f CacheAtlasInvSize = FVector3f::ZeroVector;
+	if (bLightCache) {
+		FRDGCacheAtlas = GraphBuilder.RegisterExternalTexture(LightCacheAtlas, ERDGTextureFlags::MultiFrame);
+		FRDGCachePageTable = GraphBuilder.RegisterExternalTexture(LightCachePageTable);
+		CacheAtlasInvSize = FVector3f(1.0f) / FVector3f(LightCacheAtlas->GetDesc().GetSize());
+	}
+
+	/* Fit the shadow map slices around the cloud bounds, away from the sun and down from the sky */
+	FBeerShadowMapParameters ShadowMapParameters;
+	FRDGTextureRef FRDGShadowMap = nullptr;
+	if (bShadowMapLighting) {
+		FitShadowMapSlice(ShadowMapParameters, VaporShadowMap::Sun, -ShadowMapKey.SunDir, ShadowMapKey.BoundsMin, ShadowMapKey.BoundsMax);
+		FitShadowMapSlice(ShadowMapParameters, VaporShadowMap::Sky, FVector3f(0.0f, 0.0f, -1.0f), ShadowMapKey.BoundsMin, ShadowMapKey.BoundsMax);
+
+		/* Static clouds only render the shadow map when the sun or the cloud changes, sequences render it every frame */
+		bool bRenderShadowMap = bSequence || ShadowMapKey != BeerShadowMapKey;
+		if (!BeerShadowMap.IsValid()) {
+			const FPooledRenderTargetDesc ShadowMapDesc = FPooledRenderTargetDesc::Create2DArrayDesc(
+				FIntPoint(VaporShadowMap::Resolution), PF_FloatRGBA, FClearValueBinding::None,
+				TexCreate_None, TexCreate_ShaderResource | TexCreate_UAV, false, VaporShadowMap::NumSlices
+			);
+			GRenderTargetPool.FindFreeElement(GraphBuilder.RHICmdList, ShadowMapDesc, BeerShadowMap, TEXT("Beer Shadow Map"));
+			bRenderShadowMap = true;
+		}
+		BeerShadowMapKey = ShadowMapKey;
+		FRDGShadowMap = GraphBuilder.RegisterExternalTexture(BeerShadowMap, ERDGTextureFlags::MultiFrame);
+
+		if (bRenderShadowMap) { /* Beer shadow map pass */
+			FBeerShadowMapShader::FParameters* PassParameters = GraphBuilder.AllocParameters<FBeerShadowMapShader::FParameters>();
+			PassParameters->Cloud = CloudRenderData;
+			PassParameters->ShadowMap = ShadowMapParameters;
+			PassParameters->BeerShadowMapOutput = GraphBuilder.CreateUAV(FRDGShadowMap);
+
+			TShaderMapRef<FBeerShadowMapShader> ComputeShader(GlobalShaderMap);
+
+			/* One ray per texel of each slice */
+			const FIntVector GroupCount = FIntVector(VaporShadowMap::Resolution / 8, VaporShadowMap::Resolution / 8, VaporShadowMap::NumSlices);
+
+			FComputeShaderUtils::AddPass(GraphBuilder,
+				RDG_EVENT_NAME("Vapor Beer Shadow Map %dx%d", VaporShadowMap::Resolution, VaporShadowMap::Resolution),
+				ComputeShader, PassParameters, GroupCount);
+		}
+	} else {
+		BeerShadowMap.SafeRelease();
+	}
+
+	if (bLightCache) { /* Cloud bake pass */
 		/* Allocate and fill-in the shader pass parameters */
 		FBakeShader::FParameters* PassParameters = GraphBuilder.AllocParameters<FBakeShader::FParameters>();
 		PassParameters->Cloud = CloudRenderData;
 		PassParameters->View = InView.ViewUniformBuffer;
 		PassParameters->Noise = FRDGNoise;
-		PassParameters->DensityCacheData = GraphBuilder.CreateUAV(FRDGCacheData);
+		PassParameters->LightCachePageList = GraphBuilder.CreateSRV(LightCachePageList, PF_R32_UINT);
+		PassParameters->LightCacheNumPages = LightCachePageList->Desc.NumElements;
+		PassParameters->LightCacheAtlasPages = FUintVector3(LightCacheAtlasPages.X, LightCacheAtlasPages.Y, LightCacheAtlasPages.Z);
+		PassParameters->LightCacheDense = LightCacheDense;
+		PassParameters->LightCacheAtlas = GraphBuilder.CreateUAV(FRDGCacheAtlas);
 
 		/* Load the baking shader from the global shader map */
-		TShaderMapRef<FBakeShader> ComputeShader(GlobalShaderMap);
+		FBakeShader::FPermutationDomain BakePermutationVector;
+		BakePermutationVector.Set<FBakeShader::FTiledDim>(bTiled);
+		TShaderMapRef<FBakeShader> ComputeShader(GlobalShaderMap, BakePermutationVector);
 
-		/* Calculate the group count based on the 'grid size / 2 / group size / 2' */
-		/* The cache grid is half the size of the density grid, and we go 1/8 the work each frame */
-		const FIntVector GroupCount = FIntVector::DivideAndRoundUp(FIntVector(512, 512, 64), 16);
+		/* Calculate the group count based on the 'atlas size / 2 / group size' */
+		/* Only allocated pages are baked, and we go 1/8 the work each frame */
+		const FIntVector GroupCount = FIntVector::DivideAndRoundUp(LightCacheAtlas->GetDesc().GetSize() / 2, 4);
 
 		FComputeShaderUtils::AddPass(GraphBuilder,
 			RDG_EVENT_NAME("Vapor Cloud Baking"),
 			ComputeShader, PassParameters, GroupCount);
 	}
 
-	/* Target texture creation info */
-	FRDGTextureDesc OutputDesc {};
-	OutputDesc = SceneColor->Desc;
-	OutputDesc.Reset();
-	OutputDesc.Flags |= TexCreate_UAV;
-	OutputDesc.Flags &= ~(TexCreate_RenderTargetable | TexCreate_FastVRAM);
-	const FLinearColor ClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-	OutputDesc.ClearValue = FClearValueBinding(ClearColor);
+	/* The cloud output only covers the scaled viewport, each thread traces one ray */
+	const FIntPoint MarchSize = FIntPoint(FMath::CeilToInt32(ViewSize.X * MarchSettings.ResolutionScale), FMath::CeilToInt32(ViewSize.Y * MarchSettings.ResolutionScale));
+
+	/* Rasterize the proxy hull at half the cloud output resolution, into the nearest and furthest face distances */
+	FRDGTextureRef HullTexture = nullptr;
+	FVector2f HullUVScale = FVector2f::ZeroVector;
+	if (HullVertices) {
+		const FVector2f HullViewport = FVector2f(ViewSize) * MarchSettings.ResolutionScale * 0.5f;
+		const FIntPoint HullSize = FIntPoint(FMath::Max(FMath::CeilToInt32(HullViewport.X), 1), FMath::Max(FMath::CeilToInt32(HullViewport.Y), 1));
+		const FRDGTextureDesc HullDesc = FRDGTextureDesc::Create2D(HullSize, PF_A32B32G32R32F, FClearValueBinding(FLinearColor(HullMiss, HullMiss, HullMiss, HullMiss)), TexCreate_ShaderResource | TexCreate_RenderTargetable);
+		HullTexture = GraphBuilder.CreateTexture(HullDesc, TEXT("Vapor Hull Distances"));
+		HullUVScale = HullViewport / FVector2f(HullSize);
+
+		/* The hull is in volume UVW space, transform it straight to clip space in double precision */
+		const FVector HullOrigin = FVector(HullMin);
+		FCloudHullParameters* HullParameters = GraphBuilder.AllocParameters<FCloudHullParameters>();
+		HullParameters->HullVertices = GraphBuilder.CreateSRV(HullVertices);
+		HullParameters->HullToClip = FMatrix44f(FScaleMatrix(FVector(HullExtent)) * FTranslationMatrix(HullOrigin + InView.ViewMatrices.GetPreViewTranslation())
+			* InView.ViewMatrices.GetTranslatedViewProjectionMatrix());
+		HullParameters->HullExtent = HullExtent;
+		HullParameters->HullCameraOrigin = FVector3f(InView.ViewMatrices.GetViewOrigin() - HullOrigin);
+		HullParameters->HullTexelSize = FVector2f(2.0f) / HullViewport;
+		HullParameters->RenderTargets[0] = FRenderTargetBinding(HullTexture, ERenderTargetLoadAction::EClear);
+
+		TShaderMapRef<FCloudHullVS> VertexShader(GlobalShaderMap);
+		TShaderMapRef<FCloudHullPS> PixelShader(GlobalShaderMap);
+		const uint32 NumTriangles = HullVertices->Desc.NumElements / 3;
+		GraphBuilder.AddPass(RDG_EVENT_NAME("Vapor Proxy Hull %dx%d", HullSize.X, HullSize.Y), HullParameters, ERDGPassFlags::Raster,
+			[HullParameters, VertexShader, PixelShader, HullViewport, NumTriangles](FRHICommandList& RHICmdList) {
+				RHICmdList.SetViewport(0.0f, 0.0f, 0.0f, HullViewport.X, HullViewport.Y, 1.0f);
+
+				/* Front and back faces are both drawn, min blending keeps the nearest and furthest distances */
+				FGraphicsPipelineStateInitializer GraphicsPSOInit;
+				RHICmdList.ApplyCachedRenderTargets(GraphicsPSOInit);
+				GraphicsPSOInit.BlendState = TStaticBlendState<CW_RGBA, BO_Min, BF_One, BF_One, BO_Min, BF_One, BF_One>::GetRHI();
+				GraphicsPSOInit.RasterizerState = TStaticRasterizerState<FM_Solid, CM_None>::GetRHI();
+				GraphicsPSOInit.DepthStencilState = TStaticDepthStencilState<false, CF_Always>::GetRHI();
+				GraphicsPSOInit.BoundShaderState.VertexDeclarationRHI = GEmptyVertexDeclaration.VertexDeclarationRHI;
+				GraphicsPSOInit.BoundShaderState.VertexShaderRHI = VertexShader.GetVertexShader();
+				GraphicsPSOInit.BoundShaderState.PixelShaderRHI = PixelShader.GetPixelShader();
+				GraphicsPSOInit.PrimitiveType = PT_TriangleList;
+				SetGraphicsPipelineState(RHICmdList, GraphicsPSOInit, 0);
+
+				SetShaderParameters(RHICmdList, VertexShader, VertexShader.GetVertexShader(), *HullParameters);
+				SetShaderParameters(RHICmdList, PixelShader, PixelShader.GetPixelShader(), *HullParameters);
+				RHICmdList.DrawPrimitive(0, NumTriangles, 1);
+			});
+	}
 
-	/* Create a target texture we can write into */
+	/* Create a compact half precision target for the premultiplied cloud luminance and transmittance */
+	const FRDGTextureDesc OutputDesc = FRDGTextureDesc::Create2D(MarchSize, PF_FloatRGBA, FClearValueBinding::None, TexCreate_ShaderResource | TexCreate_UAV);
 	const FRDGTextureRef OutputTexture = GraphBuilder.CreateTexture(OutputDesc, TEXT("Vapor Output"));
 
 	/* Allocate and fill-in the shader pass parameters */
@@ -164,25 +868,97 @@ void FVaporExtension::PrePostProcessPass_RenderThread(FRDGBuilder& GraphBuilder,
 	PassParameters->Cloud = CloudRenderData;
 	PassParameters->View = InView.ViewUniformBuffer;
 	PassParameters->Noise = FRDGNoise;
-	PassParameters->SceneColor = SceneColor;
 	PassParameters->SceneDepth = SceneDepth;
-	PassParameters->DensityCacheDataSRV = GraphBuilder.CreateSRV(FRDGCacheData);
+	PassParameters->LightCachePageTable = FRDGCachePageTable;
+	PassParameters->LightCacheAtlas = FRDGCacheAtlas;
+	PassParameters->LightCacheAtlasInvSize = CacheAtlasInvSize;
+	PassParameters->LightCacheDense = LightCacheDense;
+	PassParameters->TransmittanceSH = FRDGTransmittance;
+	PassParameters->ShadowMap = ShadowMapParameters;
+	PassParameters->BeerShadowMap = FRDGShadowMap;
+	PassParameters->HullDistances = HullTexture;
+	PassParameters->HullUVScale = HullUVScale;
+	PassParameters->HullCameraInside = bHullCameraInside;
+	PassParameters->ResolutionScale = MarchSettings.ResolutionScale;
+	PassParameters->PixelConeWidth = 2.0f / (InView.ViewMatrices.GetProjectionMatrix().M[1][1] * MarchSize.Y) * FMath::Exp2(CVarLODBias.GetValueOnRenderThread());
+	PassParameters->OutputSize = FUintVector2(MarchSize.X, MarchSize.Y);
 	PassParameters->Output = GraphBuilder.CreateUAV(FRDGTextureUAVDesc(OutputTexture));
 
-	/* Calculate the group count based on the viewport size */
-	const FIntVector GroupCount = FIntVector(FMath::DivideAndRoundUp(ViewSize.X, 16), FMath::DivideAndRoundUp(ViewSize.Y, 16), 1); // FComputeShaderUtils::GetGroupCount(ViewSize, FComputeShaderUtils::kGolden2DGroupSize);
+	/* Count the march cost if stats are enabled or a dump is requested, the debug view shows the step counts instead */
+	/* Shipping shader maps have neither, so both are ignored there */
+	const bool bCostPermutations = FCloudShader::SupportsCostPermutations(InView.GetShaderPlatform());
+	const bool bDebug = DebugMode && bCostPermutations;
+	const bool bStats = !DebugMode && bCostPermutations && CostStats.Begin(CVarStats.GetValueOnRenderThread() != 0);
+	FRDGBufferRef CostCounters = nullptr;
+	FRDGTextureRef CostTexture = nullptr;
+	if (bStats) {
+		CostCounters = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), VaporCostStats::NumCounters), TEXT("Vapor Cost Counters"));
+		AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(CostCounters, PF_R32_UINT), 0u);
+		CostTexture = GraphBuilder.CreateTexture(FRDGTextureDesc::Create2D(MarchSize, PF_R32_UINT, FClearValueBinding::None, TexCreate_ShaderResource | TexCreate_UAV), TEXT("Vapor Cost"));
+		PassParameters->CostCounters = GraphBuilder.CreateUAV(CostCounters, PF_R32_UINT);
+		PassParameters->CostOutput = GraphBuilder.CreateUAV(FRDGTextureUAVDesc(CostTexture));
+	}
+
+	/* Calculate the group count based on the cloud output size */
+	const FIntVector GroupCount = FIntVector(FMath::DivideAndRoundUp(MarchSize.X, 16), FMath::DivideAndRoundUp(MarchSize.Y, 16), 1); // FComputeShaderUtils::GetGroupCount(ViewSize, FComputeShaderUtils::kGolden2DGroupSize);
 
 	/* Set the permutation vector for the shader */
+	const int32 Quality = ProfileTier >= 0 ? ProfileTier : GetQualityTier();
 	FCloudShader::FPermutationDomain PermutationVector;
-	PermutationVector.Set<FCloudShader::FDebugDim>(DebugMode);
+	PermutationVector.Set<FCloudShader::FDebugDim>(bDebug);
+	PermutationVector.Set<FCloudShader::FPrecomputedLightingDim>(bPrecomputedLighting);
+	PermutationVector.Set<FCloudShader::FShadowMapDim>(bShadowMapLighting);
+	PermutationVector.Set<FCloudShader::FDirectScatteringDim>(DirectScattering);
+	PermutationVector.Set<FCloudShader::FMultiScatteringDim>(MultiScattering);
+	PermutationVector.Set<FCloudShader::FAmbientScatteringDim>(AmbientScattering);
+	PermutationVector.Set<FCloudShader::FQualityDim>(Quality);
+	PermutationVector.Set<FCloudShader::FTiledDim>(bTiled);
+	PermutationVector.Set<FCloudShader::FProxyHullDim>(HullTexture != nullptr);
+	PermutationVector.Set<FCloudShader::FStatsDim>(bStats);
+	PermutationVector = FCloudShader::RemapPermutation(PermutationVector);
 
 	/* Load our custom shader from the global shader map */
 	TShaderMapRef<FCloudShader> ComputeShader(GlobalShaderMap, PermutationVector);
+	if (ProfileTier >= 0) QualityProfile.SetInstructions(Quality, ComputeShader->GetNumInstructions());
 
-	FComputeShaderUtils::AddPass(GraphBuilder,
-		RDG_EVENT_NAME("Vapor Cloud Rendering %dx%d", ViewSize.X, ViewSize.Y),
-		ComputeShader, PassParameters, GroupCount);
-
-	/* Finally copy our output texture back onto the scene color texture */
-	AddCopyTexturePass(GraphBuilder, OutputTexture, SceneColor);
+	{ /* Cloud rendering pass, timed per quality tier through "stat gpu" */
+		RDG_GPU_STAT_SCOPE(GraphBuilder, VaporCloudRendering);
+		const bool bTimed = (TargetMs > 0.0f || ProfileTier >= 0) && GPUTimer.Begin(GraphBuilder);
+		FComputeShaderUtils::AddPass(GraphBuilder,
+			RDG_EVENT_NAME("Vapor Cloud Rendering %dx%d (Quality %d)", MarchSize.X, MarchSize.Y, Quality),
+			ComputeShader, PassParameters, GroupCount);
+		if (bTimed) {
+			GPUTimer.End(GraphBuilder);
+			QualityProfile.OnTimed(ProfileTier);
+		}
+	}
+	if (bStats) CostStats.End(GraphBuilder, CostCounters, CostTexture, FCloudShader::GetMaxDirectSteps(Quality));
+
+	/* Expose the cloud output to later passes, this runs once per view on the same graph */
+	const int32 ViewIndex = FMath::Max(InView.Family->Views.Find(&InView), 0);
+	FVaporCloudTextures& CloudTextures = GraphBuilder.Blackboard.GetOrCreate<FVaporCloudTextures>();
+	if (CloudTextures.Views.Num() <= ViewIndex) CloudTextures.Views.SetNum(ViewIndex + 1);
+	FVaporCloudView& CloudView = CloudTextures.Views[ViewIndex];
+	CloudView.CloudOutput = OutputTexture;
+	CloudView.PixelToCloudUV = FVector2f(MarchSettings.ResolutionScale / MarchSize.X, MarchSettings.ResolutionScale / MarchSize.Y);
+	CloudView.ViewRectMin = ViewRect.Min;
+
+	{ /* Cloud composite pass */
+		/* Allocate and fill-in the shader pass parameters */
+		FCloudCompositeShader::FParameters* CompositeParameters = GraphBuilder.AllocParameters<FCloudCompositeShader::FParameters>();
+		CompositeParameters->View = InView.ViewUniformBuffer;
+		CompositeParameters->CloudOutput = OutputTexture;
+		CompositeParameters->CloudOutputSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp>::GetRHI();
+		CompositeParameters->PixelToCloudUV = CloudView.PixelToCloudUV;
+		CompositeParameters->RenderTargets[0] = FRenderTargetBinding(SceneColor, ERenderTargetLoadAction::ELoad);
+
+		/* Load the composite shader from the global shader map */
+		TShaderMapRef<FCloudCompositeShader> PixelShader(GlobalShaderMap);
+
+		/* Blend the clouds in place: SceneColor * Transmittance + Luminance */
+		FPixelShaderUtils::AddFullscreenPass(GraphBuilder, GlobalShaderMap,
+			RDG_EVENT_NAME("Vapor Cloud Composite"),
+			PixelShader, CompositeParameters, ViewRect,
+			TStaticBlendState<CW_RGB, BO_Add, BF_One, BF_SourceAlpha>::GetRHI());
+	}
 }
@@ -5,11 +5,21 @@
 #include "SceneViewExtension.h"
 #include "PostProcess/PostProcessMaterial.h"
 #include "DataDrivenShaderPlatformInfo.h"
+#include "RenderUtils.h"
 #include "SceneRendererInterface.h"
+#include "VaporQualityController.h"
+#include "VaporGPUTimer.h"
+#include "VaporQualityProfile.h"
+#include "VaporCostStats.h"
+#include "VaporSequenceStreamer.h"
+#include "VaporTileStreamer.h"
+#include "VaporFieldLoader.h"
 
 /* Cloudscape render data. */
 BEGIN_UNIFORM_BUFFER_STRUCT(FCloudscapeRenderData, )
 	SHADER_PARAMETER(FVector3f, Position)
+	SHADER_PARAMETER(FVector3f, BoundsMin)
+	SHADER_PARAMETER(FVector3f, BoundsMax)
 	SHADER_PARAMETER(FVector3f, Absorption)
 	SHADER_PARAMETER(float, Density)
 	SHADER_PARAMETER(float, ProfileWidth)
@@ -20,31 +30,167 @@ BEGIN_UNIFORM_BUFFER_STRUCT(FCloudscapeRenderData, )
 	SHADER_PARAMETER(float, PrimaryNearStep)
 	SHADER_PARAMETER(float, PrimaryStepPerDistance)
 	SHADER_PARAMETER(float, PrimaryMinSDFStep)
-	SHADER_PARAMETER(uint32, DirectScattering)
-	SHADER_PARAMETER(uint32, MultiScattering)
-	SHADER_PARAMETER(uint32, AmbientScattering)
 	// Secondary Ray Options
 	SHADER_PARAMETER(float, SecondaryStep)
 	SHADER_PARAMETER(float, SecondaryExtinctThreshold)
 	SHADER_PARAMETER(float, NoiseFreq)
 	SHADER_PARAMETER(FVector3f, WindSpeed)
+	// Sequence cross-fade from the current to the next frame
+	SHADER_PARAMETER(float, FrameBlend)
 	SHADER_PARAMETER_RDG_TEXTURE(Texture3D, DensityTexture)
 	SHADER_PARAMETER_RDG_TEXTURE(Texture3D, SDFTexture)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture3D, DensityTextureNext)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture3D, SDFTextureNext)
+	// Tiled Cloudscape
+	SHADER_PARAMETER(FVector3f, TilesOrigin)
+	SHADER_PARAMETER(FIntPoint, NumTiles)
+	SHADER_PARAMETER(FVector3f, TileAtlasInvSize0)
+	SHADER_PARAMETER(FVector3f, TileAtlasInvSize1)
+	SHADER_PARAMETER(FVector3f, TileAtlasInvSize2)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D<uint>, TileTable)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture3D, TileDensityAtlas0)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture3D, TileDensityAtlas1)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture3D, TileDensityAtlas2)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture3D, TileSDFAtlas0)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture3D, TileSDFAtlas1)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture3D, TileSDFAtlas2)
+	// Mean of each noise channel, distant samples fade towards it
+	SHADER_PARAMETER(FVector4f, NoiseMean)
+	// Density scale lookup table of the component density, and the scale from the stored density to its y axis
+	SHADER_PARAMETER(float, DensityLUTScale)
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D, DensityLUT)
 END_UNIFORM_BUFFER_STRUCT()
 
+/**
+ * Beer shadow map layout, must match "BeerShadowMap.ush".
+ * A 2D map per direction through the cloud bounds, which stores the front depth, mean extinction and path density of each ray.
+ */
+namespace VaporShadowMap {
+	constexpr int32 Resolution = 512;
+
+	enum ESlice : int32 {
+		Sun, /* Away from the sun, for direct scattering */
+		Sky, /* Down from the sky, for ambient scattering */
+		NumSlices
+	};
+}
+
+/* Placement of the Beer shadow map slices around the cloud bounds. */
+BEGIN_SHADER_PARAMETER_STRUCT(FBeerShadowMapParameters, )
+	SHADER_PARAMETER_ARRAY(FVector4f, ShadowMapOrigin, [VaporShadowMap::NumSlices])
+	SHADER_PARAMETER_ARRAY(FVector4f, ShadowMapAxisU, [VaporShadowMap::NumSlices])
+	SHADER_PARAMETER_ARRAY(FVector4f, ShadowMapAxisV, [VaporShadowMap::NumSlices])
+	SHADER_PARAMETER_ARRAY(FVector4f, ShadowMapDir, [VaporShadowMap::NumSlices])
+END_SHADER_PARAMETER_STRUCT()
+
+/* Inputs the Beer shadow map was rendered with, it's only rendered again when one of them changes. */
+struct FVaporShadowMapKey {
+	const UObject* Cloud = nullptr;
+	const FRHITexture* Field = nullptr; /* Density field of static clouds, sequences render every frame */
+	FVector3f SunDir = FVector3f::ZeroVector;
+	FVector3f BoundsMin = FVector3f::ZeroVector;
+	FVector3f BoundsMax = FVector3f::ZeroVector;
+	FVector3f Absorption = FVector3f::ZeroVector;
+	float Density = 0.0f;
+	float ProfileWidth = 0.0f;
+	float SecondaryStep = 0.0f;
+	float SecondaryExtinctThreshold = 0.0f;
+
+	bool operator==(const FVaporShadowMapKey&) const = default;
+};
+
+/* Game thread inputs of a frame, gathered from the world or replayed from a trace. (see "VaporTrace.h") */
+struct FVaporFrameInputs {
+	const class UVaporComponent* Component = nullptr;
+	FCloudscapeRenderData Data {}; /* Filled in from the component, the actor, the sun and the sky */
+	FVector ViewOrigin = FVector::ZeroVector;
+	double Time = 0.0;
+};
+
+/* Cloud resources of a frame on the render thread, after the pending uploads. */
+struct FVaporFrameResources {
+	FVaporSequenceState Sequence;
+	int32 CurrentSlot = 0;
+	int32 NextSlot = 0;
+	bool bTiled = false;
+	bool bSequence = false;
+	bool bFields = false;
+};
+
 class FVaporExtension : public FSceneViewExtensionBase {
 	// Frame Render Data
 	FCloudscapeRenderData RenderData;
 	FTextureResource* DensityTexture = nullptr;
 	FTextureResource* SDFTexture = nullptr;
+	FTextureResource* TransmittanceTexture = nullptr;
 	UVolumeTexture* NoiseTexture = nullptr;
+	FVector4f NoiseMean = FVector4f::Zero();
 	FCriticalSection RenderDataLock;
 
-	// Cache UAV Textures
-	TRefCountPtr<IPooledRenderTarget> PersistentCacheData;
-	TRefCountPtr<IPooledRenderTarget> PersistentCacheFlags;
+	// Sparse Light Cache
+	TRefCountPtr<IPooledRenderTarget> LightCacheAtlas;
+	TRefCountPtr<IPooledRenderTarget> LightCachePageTable;
+	TRefCountPtr<FRDGPooledBuffer> LightCachePageListBuffer; /* `LightCachePages` on the GPU */
+	TArray<uint32> LightCachePages; /* Logical page of each atlas page */
+	FIntVector LightCacheAtlasPages = FIntVector::ZeroValue;
+	bool LightCacheDense = false; /* Most pages are allocated, the atlas holds every voxel without a page table */
+	const UObject* LightCacheCloud = nullptr; /* Cloud asset or sequence the cache was allocated for */
+	bool LightCacheDirty = false;
+
+	// Beer Shadow Map
+	TRefCountPtr<IPooledRenderTarget> BeerShadowMap;
+	FVaporShadowMapKey BeerShadowMapKey; /* Render thread only */
+
+	// Streamed Cloud Sequence
+	FVaporSequenceStreamer SequenceStreamer; /* Game thread only */
+	FVaporSequenceState SequenceState;
+	TRefCountPtr<IPooledRenderTarget> SequenceDensity[2];
+	TRefCountPtr<IPooledRenderTarget> SequenceSDF[2];
+	uint64 SequenceGPUFrames[2] = { 0, 0 }; /* Frame load id uploaded to each slot, render thread only */
+
+	// Compressed Cloud Fields
+	FVaporFieldLoader FieldLoader; /* Game thread only */
+	TSharedPtr<FVaporCloudFields, ESPMode::ThreadSafe> PendingFields;
+	TRefCountPtr<IPooledRenderTarget> FieldDensity;
+	TRefCountPtr<IPooledRenderTarget> FieldSDF;
+	bool CompressedFields = false;
+
+	// Density Scale Lookup Table
+	TRefCountPtr<IPooledRenderTarget> DensityLUT;
+	float DensityLUTDensity = -1.0f; /* Component density the table was built for, render thread only */
+
+	// Proxy Hull
+	TArray<FVector3f> ProxyHull; /* Hull triangles of the current cloud asset, empty if it has none */
+	FIntVector ProxyHullSize = FIntVector::ZeroValue; /* Voxels covered by the hull bricks */
+	FIntVector ProxyHullBricks = FIntVector::ZeroValue;
+	TArray<uint32> ProxyHullOccupancy;
+
+	// Tiled Cloudscape
+	FVaporTileStreamer TileStreamer; /* Game thread only */
+	TArray<FVaporTileUpload> TileUploads; /* Completed loads waiting for the render thread */
+	TArray<uint32> TileTable;
+	FIntPoint TileTableSize = FIntPoint::ZeroValue;
+	int32 TileSlots[VaporCloudscape::NumLODs] = {};
+	TRefCountPtr<IPooledRenderTarget> TileTableTexture;
+	TRefCountPtr<IPooledRenderTarget> TileDensityAtlas[VaporCloudscape::NumLODs];
+	TRefCountPtr<IPooledRenderTarget> TileSDFAtlas[VaporCloudscape::NumLODs];
+	bool TiledCloudscape = false;
 
 	bool DebugMode = false;
+	bool PrecomputedLighting = false;
+	bool ShadowMapLighting = false;
+	bool DirectScattering = true;
+	bool MultiScattering = true;
+	bool AmbientScattering = true;
+
+	// GPU Time Auto-Tuning
+	FVaporQualityBounds QualityBounds;
+	FVaporQualityController QualityController;
+	FVaporGPUTimer GPUTimer;
+	FVaporQualityProfile QualityProfile;
+
+	// March Cost Statistics
+	FVaporCostStats CostStats;
 
 public:
 	FVaporExtension(const FAutoRegister& AutoRegister);
@@ -58,6 +204,28 @@ public:
 
 	/* All the rendering happens in here. */
 	virtual void PrePostProcessPass_RenderThread(FRDGBuilder& GraphBuilder, const FSceneView& InView, const FPostProcessingInputs& Inputs) override;
+
+	/* Stream in the cloud and hand the frame over to the render thread, without touching the world. (game thread) */
+	void SetupFrame(const FVaporFrameInputs& Frame);
+
+	/* Take the frame from the game thread and upload its pending fields, tiles and sequence frames. Returns false if there is nothing to render yet. */
+	bool UploadFrame(FRHICommandListImmediate& RHICmdList, FVaporFrameResources& Out);
+
+private:
+	/* (Re)allocate the light cache atlas and page table, sparse or dense by occupancy, must hold the render data lock. */
+	void AllocateLightCache(FRHICommandListImmediate& RHICmdList);
+
+	/* Upload a sequence frame into the GPU slot which is not `KeepSlot`, unless it's already uploaded. Returns the slot. */
+	int32 UploadSequenceFrame(FRHICommandListImmediate& RHICmdList, const FVaporSequenceFrame& Frame, const int32 KeepSlot);
+
+	/* Upload decoded cloud fields into the field textures, or release them if the fields are corrupt. */
+	void UploadCloudFields(FRHICommandListImmediate& RHICmdList, const FVaporCloudFields& Fields);
+
+	/* Rebuild the density scale lookup table when the component density changes. */
+	void UpdateDensityLUT(FRHICommandListImmediate& RHICmdList, const float Density);
+
+	/* (Re)allocate the tile atlases for the slot counts, upload the streamed in tiles and the tile table. */
+	void UpdateTileAtlas(FRHICommandListImmediate& RHICmdList, const int32 Slots[VaporCloudscape::NumLODs], const TArray<FVaporTileUpload>& Uploads, const TArray<uint32>& Table, const FIntPoint NumTiles);
 };
 
 // Cloud ray marching shader.
@@ -71,25 +239,152 @@ public:
 		SHADER_PARAMETER_STRUCT_REF(FCloudscapeRenderData, Cloud)
 		SHADER_PARAMETER_STRUCT_REF(FViewUniformShaderParameters, View)
 		SHADER_PARAMETER_RDG_TEXTURE(Texture3D, Noise)
-		SHADER_PARAMETER_RDG_TEXTURE(Texture2D, SceneColor)
 		SHADER_PARAMETER_RDG_TEXTURE(Texture2D, SceneDepth)
-		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture3D, DensityCacheDataSRV)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture3D<uint>, LightCachePageTable)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture3D<float2>, LightCacheAtlas)
+		SHADER_PARAMETER(FVector3f, LightCacheAtlasInvSize)
+		SHADER_PARAMETER(uint32, LightCacheDense)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture3D, TransmittanceSH)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FBeerShadowMapParameters, ShadowMap)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2DArray<float4>, BeerShadowMap)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, HullDistances)
+		SHADER_PARAMETER(FVector2f, HullUVScale)
+		SHADER_PARAMETER(uint32, HullCameraInside)
+		SHADER_PARAMETER(float, ResolutionScale)
+		SHADER_PARAMETER(float, PixelConeWidth)
+		SHADER_PARAMETER(FUintVector2, OutputSize)
 		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, Output)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, CostCounters)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<uint>, CostOutput)
 	END_SHADER_PARAMETER_STRUCT()
 
+	/* Number of quality tiers, these follow the scalability levels. (Low, Medium, High, Epic) */
+	static constexpr int32 NumQualityTiers = 4;
+
 	class FDebugDim : SHADER_PERMUTATION_BOOL("DEBUG");
-	using FPermutationDomain = TShaderPermutationDomain<FDebugDim>;
+	class FPrecomputedLightingDim : SHADER_PERMUTATION_BOOL("PRECOMPUTED_LIGHTING");
+	class FShadowMapDim : SHADER_PERMUTATION_BOOL("SHADOW_MAP");
+	class FDirectScatteringDim : SHADER_PERMUTATION_BOOL("DIRECT_SCATTERING");
+	class FMultiScatteringDim : SHADER_PERMUTATION_BOOL("MULTI_SCATTERING");
+	class FAmbientScatteringDim : SHADER_PERMUTATION_BOOL("AMBIENT_SCATTERING");
+	class FQualityDim : SHADER_PERMUTATION_RANGE_INT("QUALITY", 0, NumQualityTiers);
+	class FTiledDim : SHADER_PERMUTATION_BOOL("TILED");
+	class FProxyHullDim : SHADER_PERMUTATION_BOOL("PROXY_HULL");
+	class FStatsDim : SHADER_PERMUTATION_BOOL("STATS");
+	using FPermutationDomain = TShaderPermutationDomain<FDebugDim, FPrecomputedLightingDim, FShadowMapDim,
+		FDirectScatteringDim, FMultiScatteringDim, FAmbientScatteringDim, FQualityDim, FTiledDim, FProxyHullDim, FStatsDim>;
+
+	/** @brief Get the primary ray step budget of a quality tier. */
+	static uint32 GetMaxDirectSteps(const int32 Quality) {
+		constexpr uint32 MaxDirectSteps[NumQualityTiers] = { 64, 128, 192, 256 };
+		return MaxDirectSteps[FMath::Clamp(Quality, 0, NumQualityTiers - 1)];
+	}
+
+	/** @brief Strip the features a quality tier does not support, this keeps the permutation count bounded. */
+	static FPermutationDomain RemapPermutation(FPermutationDomain PermutationVector) {
+		const int32 Quality = PermutationVector.Get<FQualityDim>();
+
+		/* Multi-scattering builds on top of direct scattering */
+		if (!PermutationVector.Get<FDirectScatteringDim>()) PermutationVector.Set<FMultiScatteringDim>(false);
+		/* Medium quality and below has no multi-scattering */
+		if (Quality < 2) PermutationVector.Set<FMultiScatteringDim>(false);
+		/* Low quality only has direct scattering */
+		if (Quality < 1) PermutationVector.Set<FAmbientScatteringDim>(false);
+		/* Tiled cloudscapes have no precomputed lighting */
+		if (PermutationVector.Get<FTiledDim>()) PermutationVector.Set<FPrecomputedLightingDim>(false);
+		/* Tiled cloudscapes are too large for a single shadow map, and the lighting modes are exclusive */
+		if (PermutationVector.Get<FTiledDim>() || PermutationVector.Get<FPrecomputedLightingDim>()) PermutationVector.Set<FShadowMapDim>(false);
+		/* Only single cloud assets have a proxy hull */
+		if (PermutationVector.Get<FTiledDim>()) PermutationVector.Set<FProxyHullDim>(false);
+		/* The debug view already shows the step counts, which don't depend on the lighting */
+		if (PermutationVector.Get<FDebugDim>()) {
+			PermutationVector.Set<FStatsDim>(false);
+			PermutationVector.Set<FPrecomputedLightingDim>(false);
+			PermutationVector.Set<FShadowMapDim>(false);
+			PermutationVector.Set<FDirectScatteringDim>(false);
+			PermutationVector.Set<FMultiScatteringDim>(false);
+			PermutationVector.Set<FAmbientScatteringDim>(false);
+		}
+		return PermutationVector;
+	}
+
+	/** @brief Check if the debug and stats permutations are compiled for a platform, only editor and development shader maps have them. */
+	static bool SupportsCostPermutations(const EShaderPlatform Platform) { return AllowDebugViewmodes(Platform); }
 
 	// Basic shader initialization
 	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters) {
+		const FPermutationDomain PermutationVector(Parameters.PermutationId);
+		if (RemapPermutation(PermutationVector) != PermutationVector) return false;
+		if ((PermutationVector.Get<FDebugDim>() || PermutationVector.Get<FStatsDim>()) && !SupportsCostPermutations(Parameters.Platform)) return false;
 		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
 	}
 
 	// Define environment variables used by compute shader
 	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment) {
+		const FPermutationDomain PermutationVector(Parameters.PermutationId);
 		OutEnvironment.SetDefine(TEXT("THREADS_X"), 16);
 		OutEnvironment.SetDefine(TEXT("THREADS_Y"), 16);
 		OutEnvironment.SetDefine(TEXT("THREADS_Z"), 1);
+		OutEnvironment.SetDefine(TEXT("MAX_DIRECT_STEPS"), GetMaxDirectSteps(PermutationVector.Get<FQualityDim>()));
+	}
+};
+
+// Cloud composite shader, blends the cloud output onto the scene color.
+class FCloudCompositeShader : public FGlobalShader {
+public:
+	DECLARE_GLOBAL_SHADER(FCloudCompositeShader)
+
+	SHADER_USE_PARAMETER_STRUCT(FCloudCompositeShader, FGlobalShader)
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_REF(FViewUniformShaderParameters, View)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D, CloudOutput)
+		SHADER_PARAMETER_SAMPLER(SamplerState, CloudOutputSampler)
+		SHADER_PARAMETER(FVector2f, PixelToCloudUV)
+		RENDER_TARGET_BINDING_SLOTS()
+	END_SHADER_PARAMETER_STRUCT()
+
+	// Basic shader initialization
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters) {
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
+
+// Proxy hull pre-pass shaders, rasterize the hull of the cloud into per-pixel entry and exit distances.
+BEGIN_SHADER_PARAMETER_STRUCT(FCloudHullParameters, )
+	SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<float3>, HullVertices)
+	SHADER_PARAMETER(FMatrix44f, HullToClip)
+	SHADER_PARAMETER(FVector3f, HullExtent)
+	SHADER_PARAMETER(FVector3f, HullCameraOrigin)
+	SHADER_PARAMETER(FVector2f, HullTexelSize)
+	RENDER_TARGET_BINDING_SLOTS()
+END_SHADER_PARAMETER_STRUCT()
+
+class FCloudHullVS : public FGlobalShader {
+public:
+	DECLARE_GLOBAL_SHADER(FCloudHullVS)
+
+	SHADER_USE_PARAMETER_STRUCT(FCloudHullVS, FGlobalShader)
+
+	using FParameters = FCloudHullParameters;
+
+	// Basic shader initialization
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters) {
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+};
+
+class FCloudHullPS : public FGlobalShader {
+public:
+	DECLARE_GLOBAL_SHADER(FCloudHullPS)
+
+	SHADER_USE_PARAMETER_STRUCT(FCloudHullPS, FGlobalShader)
+
+	using FParameters = FCloudHullParameters;
+
+	// Basic shader initialization
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters) {
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
 	}
 };
 
@@ -104,9 +399,16 @@ public:
 		SHADER_PARAMETER_STRUCT_REF(FCloudscapeRenderData, Cloud)
 		SHADER_PARAMETER_STRUCT_REF(FViewUniformShaderParameters, View)
 		SHADER_PARAMETER_RDG_TEXTURE(Texture3D, Noise)
-		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D, DensityCacheData)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<uint>, LightCachePageList)
+		SHADER_PARAMETER(uint32, LightCacheNumPages)
+		SHADER_PARAMETER(FUintVector3, LightCacheAtlasPages)
+		SHADER_PARAMETER(uint32, LightCacheDense)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture3D<float2>, LightCacheAtlas)
 	END_SHADER_PARAMETER_STRUCT()
 
+	class FTiledDim : SHADER_PERMUTATION_BOOL("TILED");
+	using FPermutationDomain = TShaderPermutationDomain<FTiledDim>;
+
 	// Basic shader initialization
 	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters) {
 		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
@@ -119,3 +421,29 @@ public:
 		OutEnvironment.SetDefine(TEXT("THREADS_Z"), 4);
 	}
 };
+
+// Beer shadow map shader, marches one ray per texel of each slice through the cloud bounds.
+class FBeerShadowMapShader : public FGlobalShader {
+public:
+	DECLARE_GLOBAL_SHADER(FBeerShadowMapShader)
+
+	SHADER_USE_PARAMETER_STRUCT(FBeerShadowMapShader, FGlobalShader)
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_REF(FCloudscapeRenderData, Cloud)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FBeerShadowMapParameters, ShadowMap)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2DArray<float4>, BeerShadowMapOutput)
+	END_SHADER_PARAMETER_STRUCT()
+
+	// Basic shader initialization
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters) {
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+
+	// Define environment variables used by compute shader
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment) {
+		OutEnvironment.SetDefine(TEXT("THREADS_X"), 8);
+		OutEnvironment.SetDefine(TEXT("THREADS_Y"), 8);
+		OutEnvironment.SetDefine(TEXT("SHADOW_MAP_RESOLUTION"), VaporShadowMap::Resolution);
+	}
+};
@@ -0,0 +1,112 @@
+#include "VaporFieldLoader.h"
+
+#include "Async/Async.h"
+#include "VaporBricks.h"
+#include "VaporCloud.h"
+#include "Serialization/BulkData.h"
+
+FVaporFieldLoader::~FVaporFieldLoader() {
+	Cancel();
+}
+
+void FVaporFieldLoader::SetCloud(const UVaporCloud* InCloud) {
+	if (Cloud.Get() == InCloud) return;
+
+	Cancel();
+	Cloud = InCloud;
+	bLoaded = false;
+	if (InCloud == nullptr || !InCloud->HasCompressedFields()) return;
+
+	Fields = MakeShared<FVaporCloudFields, ESPMode::ThreadSafe>();
+	Fields->Size = InCloud->FieldSize;
+	StartTime = FPlatformTime::Seconds();
+
+	/* Stream every payload straight into its own buffer */
+	const int32 NumMips = InCloud->NumFieldMips;
+	Payloads.SetNum(NumMips * 2);
+	Requests.Init(nullptr, NumMips * 2);
+	for (int32 i = 0; i < Payloads.Num(); ++i) {
+		const FByteBulkData& BulkData = i < NumMips ? InCloud->DensityBricks[i] : InCloud->SDFBricks[i - NumMips];
+		Payloads[i].SetNumUninitialized(BulkData.GetBulkDataSize());
+		if (BulkData.CanLoadFromDisk()) {
+			Requests[i] = BulkData.CreateStreamingRequest(AIOP_Normal, nullptr, Payloads[i].GetData());
+		}
+
+		/* Payloads which are not backed by a file yet (freshly imported) are already resident */
+		if (Requests[i] == nullptr) {
+			FMemory::Memcpy(Payloads[i].GetData(), BulkData.LockReadOnly(), Payloads[i].Num());
+			BulkData.Unlock();
+		}
+	}
+}
+
+TSharedPtr<FVaporCloudFields, ESPMode::ThreadSafe> FVaporFieldLoader::Update() {
+	if (!Fields.IsValid()) return nullptr;
+
+	/* Hand the payloads to the decoder once they're all read */
+	if (!Decode.IsValid()) {
+		for (IBulkDataIORequest* Request : Requests) {
+			if (Request && !Request->PollCompletion()) return nullptr;
+		}
+		bool bRead = true;
+		for (IBulkDataIORequest*& Request : Requests) {
+			if (Request == nullptr) continue;
+			bRead &= !Request->WasCanceled();
+			delete Request;
+			Request = nullptr;
+		}
+		Fields->bValid = bRead;
+		Fields->ReadMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+		Decode = Async(EAsyncExecution::ThreadPool, [Decoded = Fields, Compressed = MoveTemp(Payloads)]() {
+			if (!Decoded->bValid) return;
+			const double DecodeStart = FPlatformTime::Seconds();
+			const int32 NumMips = Compressed.Num() / 2;
+			Decoded->DensityMips.SetNum(NumMips);
+			Decoded->SDFMips.SetNum(NumMips);
+			for (int32 Mip = 0; Mip < NumMips; ++Mip) {
+				const FIntVector MipSize = UVaporCloud::GetMipSize(Decoded->Size, Mip);
+				for (int32 Field = 0; Field < 2; ++Field) {
+					const int32 BytesPerVoxel = Field == 0 ? sizeof(uint8) : sizeof(uint16);
+					const TArray64<uint8>& Payload = Compressed[Mip + Field * NumMips];
+					TArray64<uint8>& Dest = Field == 0 ? Decoded->DensityMips[Mip] : Decoded->SDFMips[Mip];
+					Dest.SetNumUninitialized((int64)MipSize.X * MipSize.Y * MipSize.Z * BytesPerVoxel);
+					Decoded->bValid &= VaporBricks::Decompress(Payload.GetData(), Payload.Num(), MipSize, BytesPerVoxel,
+						Dest.GetData(), MipSize.X * BytesPerVoxel, MipSize.X * MipSize.Y * BytesPerVoxel);
+					Decoded->CompressedBytes += Payload.Num();
+				}
+			}
+			Decoded->DecodeMs = (FPlatformTime::Seconds() - DecodeStart) * 1000.0;
+
+			/* Corrupt fields are dropped as a whole, so they're never uploaded half decoded */
+			if (!Decoded->bValid) {
+				Decoded->DensityMips.Empty();
+				Decoded->SDFMips.Empty();
+			}
+		});
+		return nullptr;
+	}
+
+	if (!Decode.IsReady()) return nullptr;
+	Decode.Reset();
+	bLoaded = true;
+	return MoveTemp(Fields);
+}
+
+void FVaporFieldLoader::Cancel() {
+	/* The reads write into the payloads and the decoder into the fields, so we have to wait for both */
+	for (IBulkDataIORequest*& Request : Requests) {
+		if (Request == nullptr) continue;
+		Request->Cancel();
+		Request->WaitCompletion();
+		delete Request;
+		Request = nullptr;
+	}
+	if (Decode.IsValid()) {
+		Decode.Wait();
+		Decode.Reset();
+	}
+	Requests.Reset();
+	Payloads.Reset();
+	Fields.Reset();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+
+class UVaporCloud;
+class IBulkDataIORequest;
+
+/* Decoded density and SDF fields of a cloud asset, waiting to be uploaded on the render thread. */
+struct FVaporCloudFields {
+	FIntVector Size = FIntVector::ZeroValue;
+	TArray<TArray64<uint8>> DensityMips; // Tightly packed, one per mip
+	TArray<TArray64<uint8>> SDFMips;
+	/* False if a payload failed to load or is corrupt, the mips are empty then */
+	bool bValid = false;
+	int64 CompressedBytes = 0;
+	double ReadMs = 0.0;
+	double DecodeMs = 0.0;
+};
+
+/**
+ * Reads the compressed fields of a cloud asset with async IO, and decodes them on a worker thread.
+ * Neither the game thread nor the render thread waits for the disk or the decoder. (game thread)
+ */
+class FVaporFieldLoader {
+public:
+	~FVaporFieldLoader();
+
+	/** @brief Switch to a different cloud asset, cancels the outstanding loads. Clouds without compressed fields load nothing. */
+	void SetCloud(const UVaporCloud* InCloud);
+
+	/**
+	 * @brief Pick up the completed reads and hand them to the decoder.
+	 * @return The decoded fields, once per cloud asset, or nullptr while they're loading.
+	 */
+	TSharedPtr<FVaporCloudFields, ESPMode::ThreadSafe> Update();
+
+	/** @brief Check if the fields of the current cloud asset were handed out by `Update`. */
+	bool IsLoaded() const { return bLoaded; }
+
+private:
+	/** @brief Cancel the outstanding reads and wait for them, and for the decoder. */
+	void Cancel();
+
+	TWeakObjectPtr<const UVaporCloud> Cloud;
+	TSharedPtr<FVaporCloudFields, ESPMode::ThreadSafe> Fields;
+	/* Compressed payloads, the density mips followed by the SDF mips */
+	TArray<TArray64<uint8>> Payloads;
+	TArray<IBulkDataIORequest*> Requests;
+	TFuture<void> Decode;
+	double StartTime = 0.0;
+	bool bLoaded = false;
+};
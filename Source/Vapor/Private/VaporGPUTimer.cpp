@@ -0,0 +1,54 @@
+#include "VaporGPUTimer.h"
+
+#include "RHICommandList.h"
+
+/** @brief Add a pass to the render graph which writes a timestamp. */
+static void AddTimestampPass(FRDGBuilder& GraphBuilder, FRHIRenderQuery* Query) {
+	GraphBuilder.AddPass(RDG_EVENT_NAME("Vapor Timestamp"), ERDGPassFlags::NeverCull,
+		[Query](FRHICommandListImmediate& RHICmdList) {
+			RHICmdList.EndRenderQuery(Query);
+		});
+}
+
+bool FVaporGPUTimer::Begin(FRDGBuilder& GraphBuilder) {
+	check(!bTiming);
+	if (!QueryPool.IsValid()) QueryPool = RHICreateRenderQueryPool(RQT_AbsoluteTime, NumFrames * 2);
+
+	/* All frames are still in flight, skip this one */
+	FFrame& Frame = Frames[WriteIndex];
+	if (Frame.bPending) return false;
+
+	Frame.Begin = QueryPool->AllocateQuery();
+	Frame.End = QueryPool->AllocateQuery();
+	AddTimestampPass(GraphBuilder, Frame.Begin.GetQuery());
+	bTiming = true;
+	return true;
+}
+
+void FVaporGPUTimer::End(FRDGBuilder& GraphBuilder) {
+	check(bTiming);
+	FFrame& Frame = Frames[WriteIndex];
+	AddTimestampPass(GraphBuilder, Frame.End.GetQuery());
+	Frame.bPending = true;
+	WriteIndex = (WriteIndex + 1) % NumFrames;
+	bTiming = false;
+}
+
+bool FVaporGPUTimer::Poll(float& OutMs) {
+	FFrame& Frame = Frames[ReadIndex];
+	if (!Frame.bPending) return false;
+
+	/* Timestamps are in microseconds, don't wait for them */
+	uint64 BeginTime = 0, EndTime = 0;
+	if (!RHIGetRenderQueryResult(Frame.End.GetQuery(), EndTime, false)) return false;
+	if (!RHIGetRenderQueryResult(Frame.Begin.GetQuery(), BeginTime, false)) return false;
+
+	/* Return the queries to the pool */
+	Frame.Begin.ReleaseQuery();
+	Frame.End.ReleaseQuery();
+	Frame.bPending = false;
+	ReadIndex = (ReadIndex + 1) % NumFrames;
+
+	OutMs = EndTime > BeginTime ? (float)(EndTime - BeginTime) / 1000.0f : 0.0f;
+	return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderGraphUtils.h"
+#include "RHIResources.h"
+
+/* Measures the GPU time between two points in a render graph, results are read back without stalling. */
+class FVaporGPUTimer {
+	/* Number of frames which can be in flight before we drop measurements */
+	static constexpr int32 NumFrames = 4;
+
+	struct FFrame {
+		FRHIPooledRenderQuery Begin;
+		FRHIPooledRenderQuery End;
+		bool bPending = false;
+	};
+
+	FRenderQueryPoolRHIRef QueryPool;
+	FFrame Frames[NumFrames];
+	int32 WriteIndex = 0;
+	int32 ReadIndex = 0;
+	bool bTiming = false;
+
+public:
+	/** @brief Start timing, returns false if there is no free query this frame. (render thread) */
+	bool Begin(FRDGBuilder& GraphBuilder);
+
+	/** @brief Stop timing, only call this if `Begin` returned true. (render thread) */
+	void End(FRDGBuilder& GraphBuilder);
+
+	/** @brief Read back the oldest measurement, returns false if it's not ready yet. (render thread) */
+	bool Poll(float& OutMs);
+};
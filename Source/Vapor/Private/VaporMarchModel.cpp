@@ -0,0 +1,180 @@
+#include "VaporMarchModel.h"
+
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "VaporBricks.h"
+#include "VaporCloud.h"
+#include "VaporDensity.h"
+#include "VaporTrace.h"
+
+namespace {
+	/* Size of a voxel in world units, must match `UNITS_PER_VOXEL` in "Cloud.ush" */
+	constexpr float UnitsPerVoxel = 800.0f;
+
+	/** @brief Read and decode the full resolution mip of a compressed field. */
+	template<typename T>
+	bool DecodeField(FByteBulkData& BulkData, const FIntVector& Size, TArray64<T>& OutField) {
+		TArray64<uint8> Payload;
+		Payload.SetNumUninitialized(BulkData.GetBulkDataSize());
+		void* Dest = Payload.GetData();
+		BulkData.GetCopy(&Dest, false);
+
+		OutField.SetNumUninitialized((int64)Size.X * Size.Y * Size.Z);
+		return VaporBricks::Decompress(Payload.GetData(), Payload.Num(), Size, sizeof(T),
+			(uint8*)OutField.GetData(), Size.X * sizeof(T), Size.X * Size.Y * sizeof(T));
+	}
+
+	/** @brief Intersect a ray with a box, returns the entry (x) and exit (y) distance. (like `RayAABB` in "Common.ush") */
+	FVector2f RayAABB(const FVector3f& Origin, const FVector3f& Dir, const FVector3f& Min, const FVector3f& Max) {
+		const FVector3f InvDir = FVector3f(1.0f) / Dir;
+		const FVector3f T0 = (Min - Origin) * InvDir;
+		const FVector3f T1 = (Max - Origin) * InvDir;
+		const FVector3f TMin = FVector3f::Min(T0, T1);
+		const FVector3f TMax = FVector3f::Max(T0, T1);
+		return FVector2f(TMin.GetMax(), TMax.GetMin());
+	}
+}
+
+bool FVaporMarchModel::SetCloud(UVaporCloud* Cloud) {
+	Size = FIntVector::ZeroValue;
+	Density.Empty();
+	SDF.Empty();
+	if (Cloud == nullptr || !Cloud->HasCompressedFields()) return false;
+
+	if (!DecodeField(Cloud->DensityBricks[0], Cloud->FieldSize, Density) || !DecodeField(Cloud->SDFBricks[0], Cloud->FieldSize, SDF)) {
+		UE_LOG(LogTemp, Error, TEXT("Vapor: Cloud fields of %s are corrupt, try re-importing the cloud"), *Cloud->GetName());
+		return false;
+	}
+	Size = Cloud->FieldSize;
+	return true;
+}
+
+template<typename T>
+float FVaporMarchModel::Sample(const TArray64<T>& Field, const FVector3f& Voxel) const {
+	const FVector3f Texel = Voxel - 0.5f;
+	const int32 X0 = FMath::Clamp(FMath::FloorToInt32(Texel.X), 0, Size.X - 1);
+	const int32 Y0 = FMath::Clamp(FMath::FloorToInt32(Texel.Y), 0, Size.Y - 1);
+	const int32 Z0 = FMath::Clamp(FMath::FloorToInt32(Texel.Z), 0, Size.Z - 1);
+	const int32 X1 = FMath::Min(X0 + 1, Size.X - 1);
+	const int32 Y1 = FMath::Min(Y0 + 1, Size.Y - 1);
+	const int32 Z1 = FMath::Min(Z0 + 1, Size.Z - 1);
+	const float FX = FMath::Clamp(Texel.X - X0, 0.0f, 1.0f);
+	const float FY = FMath::Clamp(Texel.Y - Y0, 0.0f, 1.0f);
+	const float FZ = FMath::Clamp(Texel.Z - Z0, 0.0f, 1.0f);
+
+	auto At = [this, &Field](const int32 X, const int32 Y, const int32 Z) -> float {
+		return (float)Field[X + ((int64)Y * Size.X) + ((int64)Z * Size.X * Size.Y)];
+	};
+	const float C00 = FMath::Lerp(At(X0, Y0, Z0), At(X1, Y0, Z0), FX);
+	const float C10 = FMath::Lerp(At(X0, Y1, Z0), At(X1, Y1, Z0), FX);
+	const float C01 = FMath::Lerp(At(X0, Y0, Z1), At(X1, Y0, Z1), FX);
+	const float C11 = FMath::Lerp(At(X0, Y1, Z1), At(X1, Y1, Z1), FX);
+	return FMath::Lerp(FMath::Lerp(C00, C10, FY), FMath::Lerp(C01, C11, FY), FZ);
+}
+
+int32 FVaporMarchModel::TraceRay(const FVector3f& Origin, const FVector3f& Dir, const FVaporTraceFrame& Frame, const float PixelConeWidth, const int32 MaxSteps,
+	const TArray<float>* DensityLUT, bool& bOutHit, bool& bOutExhausted, float& OutAbsorption) const {
+	const FCloudscapeRenderData& Data = Frame.Data;
+	const FVector3f HalfSize = FVector3f(Size) * UnitsPerVoxel * 0.5f;
+	const FVector2f Range = RayAABB(Origin, Dir, -HalfSize, HalfSize);
+	bOutHit = Range.X <= Range.Y && Range.Y > 0.0f;
+	bOutExhausted = false;
+	OutAbsorption = 0.0f;
+	if (!bOutHit) return 0;
+
+	/* Same traversal as `TraceVolume`, without the lighting */
+	float Distance = FMath::Max(0.0f, Range.X);
+	float Absorption = 0.0f;
+	int32 Steps = 0;
+	for (; Steps < MaxSteps; ++Steps) {
+		OutAbsorption = Absorption;
+		if (Distance >= Range.Y) return Steps;
+
+		const FVector3f Voxel = (Origin + Dir * Distance + HalfSize) / UnitsPerVoxel;
+		const float SDist = (Sample(SDF, Voxel) / 65535.0f * (32.0f + 512.0f) - 32.0f) * UnitsPerVoxel;
+
+		/* Skip by the distance minus the slack of the mip the footprint picks, like `SampleSDist` */
+		const float Mip = FMath::Clamp(FMath::Log2(FMath::Max(Distance * PixelConeWidth / UnitsPerVoxel, 1.0f)), 0.0f, UVaporCloud::MaxFieldMips - 1.0f);
+		const float SkipDist = SDist - UVaporCloud::GetMipSlack(Mip) * UnitsPerVoxel;
+		if (SkipDist > 0.0f) {
+			Distance += FMath::Max(Data.PrimaryMinSDFStep, SkipDist);
+			continue;
+		}
+		const float StepSize = FMath::Max(Data.PrimaryNearStep, FMath::Sqrt(Distance) * Data.PrimaryStepPerDistance);
+		Distance += StepSize;
+
+		/* `SampleCloud` with the erosion noise at zero */
+		const float DimensionalProfile = FMath::Clamp(-SDist / Data.ProfileWidth, 0.0f, 1.0f);
+		const float StoredDensity = Sample(Density, Voxel) / 255.0f;
+		const float ErodedDensity = DensityLUT
+			? VaporDensity::SampleLUT(*DensityLUT, Data.Density, DimensionalProfile, StoredDensity)
+			: VaporDensity::Transform(DimensionalProfile, StoredDensity * Data.Density);
+
+		Absorption = FMath::Clamp(Absorption + ErodedDensity * StepSize * (1.0f - Absorption), 0.0f, 1.0f);
+		if (Absorption > 0.999f) {
+			OutAbsorption = Absorption;
+			return Steps + 1;
+		}
+	}
+	OutAbsorption = Absorption;
+	bOutExhausted = Distance < Range.Y;
+	return Steps;
+}
+
+FVaporMarchStats FVaporMarchModel::Trace(const FVaporTraceFrame& Frame, const FIntPoint& NumRays, const int32 MaxSteps) const {
+	FVaporMarchStats Stats;
+	if (!IsValid() || NumRays.X <= 0 || NumRays.Y <= 0) return Stats;
+
+	/* Rays start at the camera, relative to the cloud center so they keep their precision */
+	const FMatrix InvViewProjection = Frame.GetInvViewProjection();
+	const FVector CloudCenter = FVector(FVector3f(Frame.Data.Position));
+	const FVector3f Origin = FVector3f(Frame.ViewOrigin - CloudCenter);
+
+	/* Width of the pixel cone at full resolution, like the march computes it */
+	const IConsoleVariable* CVarLODBias = IConsoleManager::Get().FindConsoleVariable(TEXT("r.Vapor.LODBias"));
+	const float PixelConeWidth = 2.0f / (Frame.ProjectionMatrix.M[1][1] * FMath::Max(Frame.ViewSize.Y, 1)) * FMath::Exp2(CVarLODBias ? CVarLODBias->GetFloat() : 0.0f);
+
+	/* The same table the extension uploads for this density */
+	TArray<float> DensityLUT;
+	VaporDensity::BuildLUT(Frame.Data.Density, DensityLUT);
+
+	TArray<FVaporMarchStats> RowStats;
+	RowStats.SetNum(NumRays.Y);
+	ParallelFor(NumRays.Y, [&](const int32 y) {
+		FVaporMarchStats& Row = RowStats[y];
+		for (int32 x = 0; x < NumRays.X; ++x) {
+			/* Pixel centers in clip space, on a plane in front of the near plane (reversed Z) */
+			const FVector4 Clip((x + 0.5) / NumRays.X * 2.0 - 1.0, 1.0 - (y + 0.5) / NumRays.Y * 2.0, 0.5, 1.0);
+			const FVector4 World = InvViewProjection.TransformFVector4(Clip);
+			const FVector3f Dir = FVector3f(FVector(World) / World.W - Frame.ViewOrigin).GetSafeNormal();
+
+			bool bHit, bExhausted;
+			float Absorption;
+			const int32 Steps = TraceRay(Origin, Dir, Frame, PixelConeWidth, MaxSteps, &DensityLUT, bHit, bExhausted, Absorption);
+
+			/* Trace the ray again with the reference density scale */
+			bool bRefHit, bRefExhausted;
+			float RefAbsorption;
+			const int32 RefSteps = TraceRay(Origin, Dir, Frame, PixelConeWidth, MaxSteps, nullptr, bRefHit, bRefExhausted, RefAbsorption);
+			Row.NumStepMismatches += Steps != RefSteps;
+			Row.MaxAbsorptionError = FMath::Max(Row.MaxAbsorptionError, FMath::Abs(Absorption - RefAbsorption));
+
+			Row.NumRays++;
+			Row.NumHits += bHit;
+			Row.NumExhausted += bExhausted;
+			Row.TotalSteps += Steps;
+			Row.MaxSteps = FMath::Max(Row.MaxSteps, Steps);
+		}
+	});
+
+	for (const FVaporMarchStats& Row : RowStats) {
+		Stats.NumRays += Row.NumRays;
+		Stats.NumHits += Row.NumHits;
+		Stats.NumExhausted += Row.NumExhausted;
+		Stats.TotalSteps += Row.TotalSteps;
+		Stats.MaxSteps = FMath::Max(Stats.MaxSteps, Row.MaxSteps);
+		Stats.NumStepMismatches += Row.NumStepMismatches;
+		Stats.MaxAbsorptionError = FMath::Max(Stats.MaxAbsorptionError, Row.MaxAbsorptionError);
+	}
+	return Stats;
+}
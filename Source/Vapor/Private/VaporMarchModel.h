@@ -0,0 +1,57 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UVaporCloud;
+struct FVaporTraceFrame;
+
+/* Primary march step statistics of the modelled rays of a frame. */
+struct FVaporMarchStats {
+	int32 NumRays = 0;
+	/* Rays which enter the cloud bounds */
+	int32 NumHits = 0;
+	/* Rays which ran out of steps before leaving the cloud or becoming opaque */
+	int32 NumExhausted = 0;
+	/* Total and largest number of steps of a ray, rays which miss the bounds take no steps */
+	int64 TotalSteps = 0;
+	int32 MaxSteps = 0;
+	/* Differences between the density scale lookup table and the reference `pow`, rays with another step count and the largest absorption error */
+	int32 NumStepMismatches = 0;
+	float MaxAbsorptionError = 0.0f;
+
+	float GetMeanSteps() const { return NumRays > 0 ? (float)TotalSteps / NumRays : 0.0f; }
+};
+
+/**
+ * CPU model of the primary march in "CloudMarchCS.usf", to estimate step counts along captured flight paths.
+ * Follows the same SDF skipping and distance-based steps over the full resolution fields, the skips keep the slack of
+ * the mip the pixel footprint picks. The erosion noise, the proxy hull and the lighting are left out.
+ * Every ray is traced with the density scale lookup table and with the reference `pow`, to check they stay equivalent.
+ */
+class FVaporMarchModel {
+public:
+	/** @brief Decode the fields of a cloud asset, returns false if it has no compressed fields. */
+	bool SetCloud(UVaporCloud* Cloud);
+
+	/** @brief Check if a cloud is loaded. */
+	bool IsValid() const { return Size != FIntVector::ZeroValue; }
+
+	/** @brief Trace a grid of rays over the view of a captured frame. */
+	FVaporMarchStats Trace(const FVaporTraceFrame& Frame, const FIntPoint& NumRays, const int32 MaxSteps) const;
+
+private:
+	FIntVector Size = FIntVector::ZeroValue;
+	TArray64<uint8> Density; /* G8, 0..1 */
+	TArray64<uint16> SDF; /* G16, -32..512 voxels */
+
+	/**
+	 * @brief Trace a single ray, `Origin` is relative to the cloud center. Returns the number of steps.
+	 * The density scale is looked up in `DensityLUT` like the GPU does, or evaluated with `pow` if it's nullptr.
+	 */
+	int32 TraceRay(const FVector3f& Origin, const FVector3f& Dir, const FVaporTraceFrame& Frame, const float PixelConeWidth, const int32 MaxSteps,
+		const TArray<float>* DensityLUT, bool& bOutHit, bool& bOutExhausted, float& OutAbsorption) const;
+
+	/** @brief Trilinearly sample a field at a point in voxel-space, with clamped addressing. */
+	template<typename T>
+	float Sample(const TArray64<T>& Field, const FVector3f& Voxel) const;
+};
@@ -0,0 +1,43 @@
+#include "VaporQualityController.h"
+
+FVaporMarchSettings FVaporMarchSettings::Lerp(const FVaporMarchSettings& Cheapest, const FVaporMarchSettings& Best, const float Quality) {
+	const float Alpha = FMath::Clamp(Quality, 0.0f, 1.0f);
+	FVaporMarchSettings Settings;
+	Settings.PrimaryNearStep = FMath::Lerp(Cheapest.PrimaryNearStep, Best.PrimaryNearStep, Alpha);
+	Settings.PrimaryStepPerDistance = FMath::Lerp(Cheapest.PrimaryStepPerDistance, Best.PrimaryStepPerDistance, Alpha);
+	Settings.SecondaryStep = FMath::Lerp(Cheapest.SecondaryStep, Best.SecondaryStep, Alpha);
+	Settings.ResolutionScale = FMath::Lerp(Cheapest.ResolutionScale, Best.ResolutionScale, Alpha);
+	return Settings;
+}
+
+float FVaporQualityController::Update(const float GpuMs, const float TargetMs) {
+	if (TargetMs <= 0.0f || GpuMs < 0.0f) return Quality;
+
+	/* Smooth out the measurements, so single spikes don't change the quality */
+	FilteredMs = FilteredMs < 0.0f ? GpuMs : FMath::Lerp(FilteredMs, GpuMs, Smoothing);
+
+	/* Wait for earlier changes to show up in the measurements */
+	if (++FramesSinceChange < SettleFrames) return Quality;
+
+	/* Only change the quality once we leave the tolerance band, this avoids flickering */
+	const float Error = FilteredMs / TargetMs - 1.0f;
+	float NewQuality = Quality;
+	if (Error > Tolerance) {
+		NewQuality -= FMath::Min(Error, 1.0f) * DecreaseRate;
+	} else if (Error < -Tolerance) {
+		NewQuality += IncreaseRate;
+	}
+	NewQuality = FMath::Clamp(NewQuality, 0.0f, 1.0f);
+
+	if (NewQuality != Quality) {
+		Quality = NewQuality;
+		FramesSinceChange = 0;
+	}
+	return Quality;
+}
+
+void FVaporQualityController::Reset() {
+	Quality = 1.0f;
+	FilteredMs = -1.0f;
+	FramesSinceChange = 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/* Cloud march settings the quality controller is allowed to change. */
+struct FVaporMarchSettings {
+	float PrimaryNearStep = 200.0f; // cm
+	float PrimaryStepPerDistance = 0.08f;
+	float SecondaryStep = 800.0f; // cm
+	float ResolutionScale = 1.0f;
+
+	/** @brief Interpolate between the cheapest (0) and the best (1) settings. */
+	static FVaporMarchSettings Lerp(const FVaporMarchSettings& Cheapest, const FVaporMarchSettings& Best, const float Quality);
+};
+
+/* User-set bounds for the quality controller. */
+struct FVaporQualityBounds {
+	FVaporMarchSettings Best;
+	FVaporMarchSettings Cheapest;
+};
+
+/**
+ * Adjusts the cloud march quality to meet a GPU time budget.
+ * Has no dependencies on the renderer, timings are fed in through `Update`.
+ */
+class FVaporQualityController {
+public:
+	/* Fraction of the target time in which the quality is left alone */
+	float Tolerance = 0.1f;
+	/* Weight of a new measurement in the exponential moving average */
+	float Smoothing = 0.2f;
+	/* Quality change per frame, per fraction over budget */
+	float DecreaseRate = 0.5f;
+	/* Quality change per frame while under budget, recovers slower than it drops */
+	float IncreaseRate = 0.02f;
+	/* Number of measurements to wait after a change, the measurement lags a couple frames */
+	int32 SettleFrames = 4;
+
+	/**
+	 * @brief Feed a new GPU time measurement.
+	 * @return The new quality level, (0 = cheapest, 1 = best)
+	 */
+	float Update(const float GpuMs, const float TargetMs);
+
+	/** @brief Go back to the best quality and forget all measurements. */
+	void Reset();
+
+	float GetQuality() const { return Quality; }
+	float GetFilteredMs() const { return FilteredMs; }
+
+private:
+	float Quality = 1.0f;
+	float FilteredMs = -1.0f;
+	int32 FramesSinceChange = 0;
+};
@@ -0,0 +1,93 @@
+#include "VaporQualityProfile.h"
+
+#include "HAL/IConsoleManager.h"
+#include <atomic>
+
+namespace {
+	/* Frames per tier of the requested profile, 0 if there is none */
+	std::atomic<int32> PendingFrames = 0;
+
+	void ProfileQualityCommand(const TArray<FString>& Args) {
+		const int32 NumFrames = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 64;
+		FVaporQualityProfile::Request(FMath::Max(NumFrames, 1));
+	}
+
+	FAutoConsoleCommand CmdProfileQuality(
+		TEXT("vapor.profilequality"),
+		TEXT("Render every quality tier in turn, and log its march instruction count and GPU time. Optional: <FramesPerTier> (default: 64)"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&ProfileQualityCommand));
+}
+
+void FVaporQualityProfile::Start(const int32 NumTiers, const int32 NumFrames) {
+	Results.Reset();
+	Results.SetNum(NumTiers);
+	FramesPerTier = NumFrames;
+	Tier = NumTiers > 0 ? 0 : -1;
+	FrameInTier = -1;
+	LastFrame = MAX_uint64;
+	bStarted = true;
+}
+
+int32 FVaporQualityProfile::BeginFrame(const uint64 FrameNumber) {
+	if (Tier < 0 || FrameNumber == LastFrame) return Tier;
+	LastFrame = FrameNumber;
+
+	if (++FrameInTier >= WarmupFrames + FramesPerTier) {
+		FrameInTier = 0;
+		if (++Tier >= Results.Num()) Tier = -1;
+	}
+	return Tier;
+}
+
+void FVaporQualityProfile::SetInstructions(const int32 InTier, const uint32 NumInstructions) {
+	if (Results.IsValidIndex(InTier)) Results[InTier].NumInstructions = NumInstructions;
+}
+
+void FVaporQualityProfile::OnTimed(const int32 InTier) {
+	FTimedFrame& Frame = Timed.AddDefaulted_GetRef();
+	Frame.Tier = InTier;
+	Frame.bWarm = InTier >= 0 && InTier == Tier && FrameInTier >= WarmupFrames;
+}
+
+bool FVaporQualityProfile::AddMeasurement(const float GpuMs) {
+	if (Timed.IsEmpty()) return false;
+	const FTimedFrame Frame = Timed[0];
+	Timed.RemoveAt(0, EAllowShrinking::No);
+	if (!Results.IsValidIndex(Frame.Tier)) return false;
+
+	if (Frame.bWarm) {
+		FVaporTierProfile& Result = Results[Frame.Tier];
+		Result.MinMs = Result.NumFrames > 0 ? FMath::Min(Result.MinMs, GpuMs) : GpuMs;
+		Result.TotalMs += GpuMs;
+		++Result.NumFrames;
+	}
+	return true;
+}
+
+bool FVaporQualityProfile::Finish() {
+	if (!bStarted || Tier >= 0) return false;
+
+	/* Wait for the measurements of the last frames, they come back a few frames late */
+	for (const FTimedFrame& Frame : Timed) {
+		if (Frame.Tier >= 0) return false;
+	}
+	bStarted = false;
+	return true;
+}
+
+void FVaporQualityProfile::Log() const {
+	for (int32 i = 0; i < Results.Num(); ++i) {
+		const FVaporTierProfile& Result = Results[i];
+		const FString Instructions = Result.NumInstructions > 0 ? FString::FromInt(Result.NumInstructions) : TEXT("n/a");
+		UE_LOG(LogTemp, Display, TEXT("Vapor: Quality %d, %s instructions, %.3f ms mean, %.3f ms min over %d frames"),
+			i, *Instructions, Result.GetMeanMs(), Result.MinMs, Result.NumFrames);
+	}
+}
+
+void FVaporQualityProfile::Request(const int32 NumFrames) {
+	PendingFrames = NumFrames;
+}
+
+int32 FVaporQualityProfile::ConsumeRequest() {
+	return PendingFrames.exchange(0);
+}
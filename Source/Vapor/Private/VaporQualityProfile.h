@@ -0,0 +1,67 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/* Measured cost of a single quality tier. */
+struct FVaporTierProfile {
+	uint32 NumInstructions = 0; /* Reported by the shader compiler, 0 on platforms which don't report it */
+	int32 NumFrames = 0;
+	float TotalMs = 0.0f;
+	float MinMs = 0.0f;
+
+	float GetMeanMs() const { return NumFrames > 0 ? TotalMs / NumFrames : 0.0f; }
+};
+
+/**
+ * Renders every quality tier in turn for a number of frames, and measures its GPU time and instruction count.
+ * Has no dependencies on the renderer, timings are fed in through `AddMeasurement` like the quality controller.
+ */
+class FVaporQualityProfile {
+public:
+	/* Frames rendered at each tier before measuring, so measurements of the previous tier don't leak in */
+	int32 WarmupFrames = 8;
+
+	/** @brief Start rendering every tier for `WarmupFrames + NumFrames` frames, from the lowest tier up. */
+	void Start(const int32 NumTiers, const int32 NumFrames);
+
+	/** @brief Advance to the next frame, views of the same frame get the same tier. Returns the tier to render, or -1 if no profile is running. */
+	int32 BeginFrame(const uint64 FrameNumber);
+
+	/** @brief Record the instruction count of the march shader of a tier. */
+	void SetInstructions(const int32 Tier, const uint32 NumInstructions);
+
+	/** @brief Record that the GPU timer measures this frame at a tier (-1 outside the profile), measurements come back in the same order. */
+	void OnTimed(const int32 Tier);
+
+	/** @brief Feed a GPU time measurement, returns false if it belongs to a frame outside the profile. */
+	bool AddMeasurement(const float GpuMs);
+
+	/** @brief Returns true once, after the last tier is rendered and all of its measurements came back. */
+	bool Finish();
+
+	/** @brief Log the instruction count and GPU time of every tier. */
+	void Log() const;
+
+	bool IsRunning() const { return Tier >= 0; }
+	const TArray<FVaporTierProfile>& GetResults() const { return Results; }
+
+	/** @brief Profile `NumFrames` frames of every tier, starting at the next rendered frame. (any thread) */
+	static void Request(const int32 NumFrames);
+
+	/** @brief Take the pending request, returns the number of frames per tier or 0 if there is none. (render thread) */
+	static int32 ConsumeRequest();
+
+private:
+	struct FTimedFrame {
+		int32 Tier = -1;
+		bool bWarm = false;
+	};
+
+	TArray<FVaporTierProfile> Results;
+	TArray<FTimedFrame> Timed;
+	int32 Tier = -1;
+	int32 FramesPerTier = 0;
+	int32 FrameInTier = 0;
+	uint64 LastFrame = 0;
+	bool bStarted = false;
+};
@@ -0,0 +1,219 @@
+#include "VaporReplayCommandlet.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "RenderingThread.h"
+#include "SceneViewExtension.h"
+#include "VaporCloud.h"
+#include "VaporComponent.h"
+#include "VaporExtension.h"
+#include "VaporMarchModel.h"
+#include "VaporTrace.h"
+#include <atomic>
+
+namespace {
+	/**
+	 * Counts the allocations of every thread, forwarding them to the allocator it replaced.
+	 * It's installed once and never removed, other threads may still be inside it.
+	 */
+	class FCountingMalloc final : public FMalloc {
+	public:
+		std::atomic<int64> NumAllocs = 0;
+		std::atomic<int64> AllocBytes = 0;
+
+		explicit FCountingMalloc(FMalloc* InInner) : Inner(InInner) {}
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override { Record(Count); return Inner->Malloc(Count, Alignment); }
+		virtual void* TryMalloc(SIZE_T Count, uint32 Alignment) override { Record(Count); return Inner->TryMalloc(Count, Alignment); }
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override { Record(Count); return Inner->Realloc(Original, Count, Alignment); }
+		virtual void* TryRealloc(void* Original, SIZE_T Count, uint32 Alignment) override { Record(Count); return Inner->TryRealloc(Original, Count, Alignment); }
+		virtual void Free(void* Original) override { Inner->Free(Original); }
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+		virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+		virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+		virtual void MarkTLSCachesAsUsedOnCurrentThread() override { Inner->MarkTLSCachesAsUsedOnCurrentThread(); }
+		virtual void MarkTLSCachesAsUnusedOnCurrentThread() override { Inner->MarkTLSCachesAsUnusedOnCurrentThread(); }
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+		virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override { Inner->GetAllocatorStats(OutStats); }
+		virtual void DumpAllocatorStats(FOutputDevice& Ar) override { Inner->DumpAllocatorStats(Ar); }
+		virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+		virtual bool ValidateHeap() override { return Inner->ValidateHeap(); }
+		virtual void UpdateStats() override { Inner->UpdateStats(); }
+		virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+
+	private:
+		FMalloc* Inner;
+
+		void Record(const SIZE_T Count) {
+			if (Count == 0) return;
+			NumAllocs.fetch_add(1, std::memory_order_relaxed);
+			AllocBytes.fetch_add(Count, std::memory_order_relaxed);
+		}
+	};
+
+	/** @brief Put the counting allocator in front of the engine allocator, only the first call installs it. */
+	FCountingMalloc& InstallCountingMalloc() {
+		static FCountingMalloc* Counter = nullptr;
+		if (Counter == nullptr) {
+			Counter = new FCountingMalloc(GMalloc);
+			GMalloc = Counter;
+		}
+		return *Counter;
+	}
+
+	/** @brief Get the primary ray step budget of the quality tier set by the replayed console variables. */
+	int32 GetMaxDirectSteps() {
+		const IConsoleVariable* CVarQuality = IConsoleManager::Get().FindConsoleVariable(TEXT("r.Vapor.Quality"));
+		int32 Quality = CVarQuality ? CVarQuality->GetInt() : -1;
+		if (Quality < 0) {
+			const IConsoleVariable* CVarEffectsQuality = IConsoleManager::Get().FindConsoleVariable(TEXT("sg.EffectsQuality"));
+			Quality = CVarEffectsQuality ? CVarEffectsQuality->GetInt() : FCloudShader::NumQualityTiers - 1;
+		}
+		return FCloudShader::GetMaxDirectSteps(Quality);
+	}
+
+	/* Measurements of a replayed frame */
+	struct FReplayFrame {
+		uint64 FrameNumber = 0;
+		double GameMs = 0.0;
+		double RenderMs = 0.0;
+		int64 NumAllocs = 0;
+		int64 AllocBytes = 0;
+		FVaporMarchStats March;
+	};
+
+	/** @brief Log the mean, 95th percentile and maximum of a measurement over all frames. */
+	void LogDistribution(const TCHAR* Name, const TArray<FReplayFrame>& Frames, TFunctionRef<double(const FReplayFrame&)> Measure) {
+		TArray<double> Values;
+		Values.Reserve(Frames.Num());
+		double Sum = 0.0;
+		for (const FReplayFrame& Frame : Frames) {
+			Values.Add(Measure(Frame));
+			Sum += Values.Last();
+		}
+		Values.Sort();
+		const double P95 = Values[FMath::Min(FMath::FloorToInt32(Values.Num() * 0.95), Values.Num() - 1)];
+		UE_LOG(LogTemp, Display, TEXT("Vapor:   %-16s mean %10.3f  p95 %10.3f  max %10.3f"), Name, Sum / Values.Num(), P95, Values.Last());
+	}
+}
+
+UVaporReplayCommandlet::UVaporReplayCommandlet() {
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UVaporReplayCommandlet::Main(const FString& Params) {
+	FString TraceFile, CsvFile, RaysParam;
+	if (!FParse::Value(*Params, TEXT("trace="), TraceFile)) {
+		UE_LOG(LogTemp, Error, TEXT("Vapor: Usage: -run=VaporReplay -trace=<File> -nullrhi [-csv=<File>] [-realtime] [-modelrays=<X>x<Y>]"));
+		return 1;
+	}
+	FParse::Value(*Params, TEXT("csv="), CsvFile);
+	const bool bRealtime = FParse::Param(*Params, TEXT("realtime"));
+	FIntPoint NumRays(64, 36);
+	if (FParse::Value(*Params, TEXT("modelrays="), RaysParam)) {
+		FString X, Y;
+		if (RaysParam.Split(TEXT("x"), &X, &Y)) NumRays = FIntPoint(FCString::Atoi(*X), FCString::Atoi(*Y));
+	}
+	if (!GUsingNullRHI) {
+		UE_LOG(LogTemp, Warning, TEXT("Vapor: Replaying without -nullrhi, the render thread timings include the uploads to the GPU"));
+	}
+
+	FVaporTraceReader Reader;
+	if (!Reader.Open(TraceFile)) return 1;
+
+	/* The replay drives its own extension, the component only holds the replayed properties */
+	TSharedRef<FVaporExtension, ESPMode::ThreadSafe> Extension = FSceneViewExtensions::NewExtension<FVaporExtension>();
+	UVaporComponent* Component = NewObject<UVaporComponent>(GetTransientPackage());
+	Component->AddToRoot();
+	FVaporMarchModel Model;
+	const UVaporCloud* ModelCloud = nullptr;
+
+	FCountingMalloc& Counter = InstallCountingMalloc();
+	TArray<FReplayFrame> Frames;
+	FVaporTraceFrame Frame;
+	double FirstTime = 0.0;
+	const double StartSeconds = FPlatformTime::Seconds();
+	while (Reader.Read(Frame)) {
+		VaporTrace::ApplyCVarChanges(Frame);
+		VaporTrace::ApplyComponentChanges(Frame, *Component);
+
+		/* Keep the captured frame timing, so streaming has as much time to complete as it had in the game */
+		if (Frames.Num() == 0) FirstTime = Frame.Time;
+		if (bRealtime) {
+			const double WaitSeconds = (Frame.Time - FirstTime) - (FPlatformTime::Seconds() - StartSeconds);
+			if (WaitSeconds > 0.0) FPlatformProcess::Sleep((float)WaitSeconds);
+		}
+
+		FVaporFrameInputs Inputs;
+		Inputs.Component = Component;
+		Inputs.Data = Frame.Data;
+		Inputs.ViewOrigin = Frame.ViewOrigin;
+		Inputs.Time = Frame.Time;
+
+		FReplayFrame& Replay = Frames.AddDefaulted_GetRef();
+		Replay.FrameNumber = Frame.FrameNumber;
+		const int64 AllocsBefore = Counter.NumAllocs.load();
+		const int64 BytesBefore = Counter.AllocBytes.load();
+
+		const double GameStart = FPlatformTime::Seconds();
+		Extension->SetupFrame(Inputs);
+		Replay.GameMs = (FPlatformTime::Seconds() - GameStart) * 1000.0;
+
+		/* The render thread part is waited for, so frames never overlap */
+		double* RenderMs = &Replay.RenderMs;
+		ENQUEUE_RENDER_COMMAND(VaporReplayFrame)([Extension, RenderMs](FRHICommandListImmediate& RHICmdList) {
+			const double RenderStart = FPlatformTime::Seconds();
+			FVaporFrameResources Resources;
+			Extension->UploadFrame(RHICmdList, Resources);
+			*RenderMs = (FPlatformTime::Seconds() - RenderStart) * 1000.0;
+		});
+		FlushRenderingCommands();
+		Replay.NumAllocs = Counter.NumAllocs.load() - AllocsBefore;
+		Replay.AllocBytes = Counter.AllocBytes.load() - BytesBefore;
+
+		/* Model the march along the captured view, only cloud assets have fields on the CPU */
+		UVaporCloud* Cloud = Component->Cloudscape || Component->CloudSequence ? nullptr : Component->CloudAsset.Get();
+		if (Cloud != ModelCloud) {
+			ModelCloud = Cloud;
+			Model.SetCloud(Cloud);
+		}
+		if (Model.IsValid()) Replay.March = Model.Trace(Frame, NumRays, GetMaxDirectSteps());
+	}
+	Component->RemoveFromRoot();
+
+	if (Frames.Num() == 0) {
+		UE_LOG(LogTemp, Error, TEXT("Vapor: %s holds no frames"), *TraceFile);
+		return 1;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Vapor: Replayed %d frames of %s"), Frames.Num(), *TraceFile);
+	LogDistribution(TEXT("Game thread ms"), Frames, [](const FReplayFrame& F) { return F.GameMs; });
+	LogDistribution(TEXT("Render thread ms"), Frames, [](const FReplayFrame& F) { return F.RenderMs; });
+	LogDistribution(TEXT("Allocations"), Frames, [](const FReplayFrame& F) { return (double)F.NumAllocs; });
+	LogDistribution(TEXT("Allocated KB"), Frames, [](const FReplayFrame& F) { return F.AllocBytes / 1024.0; });
+	if (Model.IsValid()) {
+		LogDistribution(TEXT("Mean ray steps"), Frames, [](const FReplayFrame& F) { return (double)F.March.GetMeanSteps(); });
+		LogDistribution(TEXT("Max ray steps"), Frames, [](const FReplayFrame& F) { return (double)F.March.MaxSteps; });
+		LogDistribution(TEXT("Exhausted rays %"), Frames, [](const FReplayFrame& F) { return F.March.NumRays > 0 ? 100.0 * F.March.NumExhausted / F.March.NumRays : 0.0; });
+		LogDistribution(TEXT("LUT step diffs"), Frames, [](const FReplayFrame& F) { return (double)F.March.NumStepMismatches; });
+		LogDistribution(TEXT("LUT absorption %"), Frames, [](const FReplayFrame& F) { return 100.0 * F.March.MaxAbsorptionError; });
+	}
+
+	if (!CsvFile.IsEmpty()) {
+		FString Csv = TEXT("Frame,GameMs,RenderMs,Allocs,AllocBytes,Rays,HitRays,ExhaustedRays,MeanSteps,MaxSteps,StepMismatches,AbsorptionError\n");
+		for (const FReplayFrame& Replay : Frames) {
+			Csv += FString::Printf(TEXT("%llu,%.4f,%.4f,%lld,%lld,%d,%d,%d,%.2f,%d,%d,%.6f\n"), Replay.FrameNumber, Replay.GameMs, Replay.RenderMs,
+				Replay.NumAllocs, Replay.AllocBytes, Replay.March.NumRays, Replay.March.NumHits, Replay.March.NumExhausted, Replay.March.GetMeanSteps(), Replay.March.MaxSteps,
+				Replay.March.NumStepMismatches, Replay.March.MaxAbsorptionError);
+		}
+		if (!FFileHelper::SaveStringToFile(Csv, *CsvFile)) {
+			UE_LOG(LogTemp, Error, TEXT("Vapor: Failed to write %s"), *CsvFile);
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "VaporReplayCommandlet.generated.h"
+
+/**
+ * Replays a captured trace through the per-frame setup of the extension and its render thread uploads, without a world.
+ * Measures the game and render thread time and the allocations of every frame, and models the march step counts.
+ *
+ * Usage: -run=VaporReplay -trace=<File> -nullrhi [-csv=<File>] [-realtime] [-modelrays=<X>x<Y>]
+ */
+UCLASS()
+class UVaporReplayCommandlet : public UCommandlet {
+	GENERATED_BODY()
+
+public:
+	UVaporReplayCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
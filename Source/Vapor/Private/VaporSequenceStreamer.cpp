@@ -0,0 +1,167 @@
+#include "VaporSequenceStreamer.h"
+
+#include "VaporCloudSequence.h"
+#include "Serialization/BulkData.h"
+
+FVaporSequenceStreamer::~FVaporSequenceStreamer() {
+	for (FSlot& Slot : Slots) CancelSlot(Slot);
+}
+
+void FVaporSequenceStreamer::SetSequence(const UVaporCloudSequence* InSequence) {
+	if (Sequence.Get() == InSequence) return;
+
+	/* Drop all frames of the previous sequence */
+	for (FSlot& Slot : Slots) {
+		CancelSlot(Slot);
+		Slot.Data.Frame = INDEX_NONE;
+		Slot.bReady = false;
+	}
+	Sequence = InSequence;
+	Displayed = FVaporSequenceFrame();
+	Stats = FVaporStreamingStats();
+	LastFrame = INDEX_NONE;
+}
+
+void FVaporSequenceStreamer::GetFrameTiming(const double Time, const float FrameRate, const int32 NumFrames, const bool bLoop, int32& OutFrame, int32& OutNext, float& OutBlend) {
+	const double Position = FMath::Max(Time * FrameRate, 0.0);
+	const int64 Frame = (int64)Position;
+	OutBlend = (float)(Position - Frame);
+
+	if (bLoop) {
+		OutFrame = (int32)(Frame % NumFrames);
+		OutNext = (OutFrame + 1) % NumFrames;
+	} else if (Frame >= NumFrames - 1) {
+		/* Hold the last frame once the sequence has finished */
+		OutFrame = OutNext = NumFrames - 1;
+		OutBlend = 0.0f;
+	} else {
+		OutFrame = (int32)Frame;
+		OutNext = OutFrame + 1;
+	}
+}
+
+bool FVaporSequenceStreamer::Update(const double Time, const bool bLoop, FVaporSequenceState& OutState) {
+	OutState = FVaporSequenceState();
+	const UVaporCloudSequence* Seq = Sequence.Get();
+	if (Seq == nullptr || Seq->NumFrames == 0 || Seq->Frames.Num() != Seq->NumFrames) return false;
+
+	int32 Frame, Next;
+	float Blend;
+	GetFrameTiming(Time, Seq->FrameRate, Seq->NumFrames, bLoop, Frame, Next, Blend);
+
+	/* Pick up the loads which completed since the last update */
+	for (FSlot& Slot : Slots) PollSlot(Slot);
+
+	/* Count whether the new frame was prefetched in time */
+	if (Frame != LastFrame) {
+		if (LastFrame != INDEX_NONE) {
+			const FSlot* Slot = FindSlot(Frame);
+			if (Slot && Slot->bReady) ++Stats.Hits; else ++Stats.Misses;
+		}
+
+		/* Report and reset the statistics every time the sequence loops */
+		if (Frame < LastFrame) {
+			UE_LOG(LogTemp, Log, TEXT("Vapor: Sequence prefetch hit rate %.1f%% (%d hits, %d misses), %d loads, %.2f ms avg, %.2f ms max"),
+				Stats.GetHitRate() * 100.0f, Stats.Hits, Stats.Misses, Stats.Loads, Stats.GetAverageLoadMs(), Stats.MaxLoadMs);
+			Stats = FVaporStreamingStats();
+		}
+		LastFrame = Frame;
+	}
+
+	/* Prefetch the current frame and the ones after it */
+	for (int32 i = 0; i < RingSize; ++i) {
+		int32 Prefetch = Frame + i;
+		if (bLoop) Prefetch %= Seq->NumFrames;
+		else if (Prefetch >= Seq->NumFrames) break;
+		if (FindSlot(Prefetch) == nullptr) RequestFrame(Prefetch, Frame, bLoop);
+	}
+
+	/* Display the current frame once it's ready, otherwise hold the last displayed frame */
+	const FSlot* CurrentSlot = FindSlot(Frame);
+	if (CurrentSlot && CurrentSlot->bReady) Displayed = CurrentSlot->Data;
+	if (!Displayed.Payload.IsValid()) return false;
+	OutState.Current = Displayed;
+	OutState.Next = Displayed;
+
+	/* Only blend towards the next frame if we're on time, and it's ready as well */
+	const FSlot* NextSlot = FindSlot(Next);
+	if (Displayed.Frame == Frame && Next != Frame && NextSlot && NextSlot->bReady) {
+		OutState.Next = NextSlot->Data;
+		OutState.Blend = Blend;
+	}
+	return true;
+}
+
+FVaporSequenceStreamer::FSlot* FVaporSequenceStreamer::FindSlot(const int32 Frame) {
+	for (FSlot& Slot : Slots) {
+		if (Slot.Data.Frame == Frame) return &Slot;
+	}
+	return nullptr;
+}
+
+void FVaporSequenceStreamer::RequestFrame(const int32 Frame, const int32 WindowStart, const bool bLoop) {
+	const UVaporCloudSequence* Seq = Sequence.Get();
+
+	/* Find a slot which is free, or holds a frame outside of the prefetch window */
+	FSlot* Target = nullptr;
+	for (FSlot& Slot : Slots) {
+		if (Slot.Data.Frame == INDEX_NONE) { Target = &Slot; break; }
+		const int32 Ahead = bLoop ? (Slot.Data.Frame - WindowStart + Seq->NumFrames) % Seq->NumFrames : Slot.Data.Frame - WindowStart;
+		if (Ahead < 0 || Ahead >= RingSize) { Target = &Slot; break; }
+	}
+	if (Target == nullptr) return;
+	CancelSlot(*Target);
+
+	/* Re-use the slot buffer, unless the render thread still holds on to it */
+	const int64 Bytes = Seq->GetFrameBytes();
+	if (!Target->Data.Payload.IsValid() || !Target->Data.Payload.IsUnique()) {
+		Target->Data.Payload = MakeShared<TArray<uint8>, ESPMode::ThreadSafe>();
+	}
+	Target->Data.Payload->SetNumUninitialized(Bytes);
+	Target->Data.Id = ++NextId;
+	Target->Data.Frame = Frame;
+	Target->Data.Size = Seq->FrameSize;
+	Target->RequestTime = FPlatformTime::Seconds();
+	Target->bReady = false;
+
+	/* Stream the payload straight into the slot buffer */
+	const FByteBulkData& BulkData = Seq->Frames[Frame];
+	if (BulkData.CanLoadFromDisk()) {
+		Target->Request = BulkData.CreateStreamingRequest(AIOP_Normal, nullptr, Target->Data.Payload->GetData());
+	}
+
+	/* Payloads which are not backed by a file yet (freshly imported) are already resident */
+	if (Target->Request == nullptr) {
+		FMemory::Memcpy(Target->Data.Payload->GetData(), BulkData.LockReadOnly(), FMath::Min<int64>(Bytes, BulkData.GetBulkDataSize()));
+		BulkData.Unlock();
+		Target->bReady = true;
+	}
+}
+
+void FVaporSequenceStreamer::PollSlot(FSlot& Slot) {
+	if (Slot.Request == nullptr || !Slot.Request->PollCompletion()) return;
+
+	const bool bCanceled = Slot.Request->WasCanceled();
+	delete Slot.Request;
+	Slot.Request = nullptr;
+	if (bCanceled) {
+		Slot.Data.Frame = INDEX_NONE;
+		return;
+	}
+
+	const double LoadMs = (FPlatformTime::Seconds() - Slot.RequestTime) * 1000.0;
+	Stats.Loads += 1;
+	Stats.TotalLoadMs += LoadMs;
+	Stats.MaxLoadMs = FMath::Max(Stats.MaxLoadMs, LoadMs);
+	Slot.bReady = true;
+}
+
+void FVaporSequenceStreamer::CancelSlot(FSlot& Slot) {
+	if (Slot.Request == nullptr) return;
+
+	/* The request writes into the slot buffer, so we have to wait for it before the buffer can be touched */
+	Slot.Request->Cancel();
+	Slot.Request->WaitCompletion();
+	delete Slot.Request;
+	Slot.Request = nullptr;
+}
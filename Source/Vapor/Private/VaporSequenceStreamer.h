@@ -0,0 +1,98 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+
+class UVaporCloudSequence;
+class IBulkDataIORequest;
+
+/* Frame payload, density (G8) followed by SDF (G16), shared with the render thread. */
+using FVaporFramePayload = TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe>;
+
+/* A streamed in sequence frame. */
+struct FVaporSequenceFrame {
+	/* Unique id of this load, changes whenever a payload is (re)loaded */
+	uint64 Id = 0;
+	/* Frame index in the sequence */
+	int32 Frame = INDEX_NONE;
+	/* Number of voxels along each axis */
+	FIntVector Size = FIntVector::ZeroValue;
+	FVaporFramePayload Payload;
+};
+
+/* Frames to display, the cloud is cross-faded from `Current` to `Next` by `Blend`. */
+struct FVaporSequenceState {
+	FVaporSequenceFrame Current;
+	FVaporSequenceFrame Next;
+	float Blend = 0.0f;
+};
+
+/* Prefetch statistics, reset whenever the sequence loops. */
+struct FVaporStreamingStats {
+	/* Frames which were streamed in before they were displayed */
+	int32 Hits = 0;
+	/* Frames which were late, the previous frame was held instead */
+	int32 Misses = 0;
+	/* Number of completed loads, and their total and longest duration */
+	int32 Loads = 0;
+	double TotalLoadMs = 0.0;
+	double MaxLoadMs = 0.0;
+
+	float GetHitRate() const { return Hits + Misses > 0 ? (float)Hits / (Hits + Misses) : 1.0f; }
+	float GetAverageLoadMs() const { return Loads > 0 ? (float)(TotalLoadMs / Loads) : 0.0f; }
+};
+
+/**
+ * Streams the frames of a cloud sequence from disk with async IO, keeping a small ring of prefetched frames.
+ * Memory is bounded by the ring size, regardless of the sequence length.
+ * Has no dependencies on the renderer, playback is driven through `Update`. (game thread)
+ */
+class FVaporSequenceStreamer {
+public:
+	/* Number of frames kept in flight, the current frame and the ones after it */
+	static constexpr int32 RingSize = 4;
+
+	~FVaporSequenceStreamer();
+
+	/** @brief Switch to a different sequence, cancels all outstanding loads. */
+	void SetSequence(const UVaporCloudSequence* InSequence);
+
+	/**
+	 * @brief Advance playback and prefetch the upcoming frames.
+	 * @return False if there is nothing to display yet.
+	 */
+	bool Update(const double Time, const bool bLoop, FVaporSequenceState& OutState);
+
+	/** @brief Get the prefetch statistics of the current loop. */
+	const FVaporStreamingStats& GetStats() const { return Stats; }
+
+	/** @brief Get the frame to display at a point in time, and the frame to blend towards. */
+	static void GetFrameTiming(const double Time, const float FrameRate, const int32 NumFrames, const bool bLoop, int32& OutFrame, int32& OutNext, float& OutBlend);
+
+private:
+	struct FSlot {
+		FVaporSequenceFrame Data;
+		IBulkDataIORequest* Request = nullptr;
+		double RequestTime = 0.0;
+		bool bReady = false;
+	};
+
+	/** @brief Find the slot which holds a frame, or nullptr. */
+	FSlot* FindSlot(const int32 Frame);
+
+	/** @brief Start loading a frame into a slot which is not needed in the prefetch window. */
+	void RequestFrame(const int32 Frame, const int32 WindowStart, const bool bLoop);
+
+	/** @brief Mark the slot as ready if its load has completed. */
+	void PollSlot(FSlot& Slot);
+
+	/** @brief Cancel the outstanding load of a slot and wait for it. */
+	void CancelSlot(FSlot& Slot);
+
+	TWeakObjectPtr<const UVaporCloudSequence> Sequence;
+	FSlot Slots[RingSize];
+	FVaporSequenceFrame Displayed;
+	FVaporStreamingStats Stats;
+	int32 LastFrame = INDEX_NONE;
+	uint64 NextId = 0;
+};
@@ -0,0 +1,164 @@
+#include "VaporTileResidency.h"
+
+void FVaporTileResidency::ComputeSlotBudget(const FVaporTileSettings& Settings, const int64 BudgetBytes, int32 OutSlots[VaporCloudscape::NumLODs]) {
+	using namespace VaporCloudscape;
+
+	/* Upper bound of the tiles within a distance of the camera, wherever the camera is */
+	auto TilesInRange = [&Settings](const float Distance) {
+		const int32 Radius = FMath::CeilToInt32(Distance / Settings.TileSize);
+		return FMath::Min(2 * Radius + 1, Settings.NumTiles.X) * FMath::Min(2 * Radius + 1, Settings.NumTiles.Y);
+	};
+
+	/* Cover the coarsest LOD first, so distant clouds never disappear, then spend the rest on detail */
+	int64 Remaining = BudgetBytes;
+	for (int32 LOD = NumLODs - 1; LOD >= 0; --LOD) {
+		const int32 Needed = TilesInRange(Settings.LODDistances[LOD] * (1.0f + Settings.Hysteresis));
+		const int32 Affordable = (int32)FMath::Min<int64>(FMath::Max<int64>(Remaining, 0) / GetTileBytes(LOD), MAX_int32);
+		OutSlots[LOD] = FMath::Min3(Needed, Affordable, GetMaxSlots(LOD));
+		Remaining -= OutSlots[LOD] * GetTileBytes(LOD);
+	}
+}
+
+void FVaporTileResidency::Init(const FVaporTileSettings& InSettings, const int32 InSlots[VaporCloudscape::NumLODs]) {
+	Settings = InSettings;
+	Settings.EmptyTiles.SetNumZeroed(Settings.NumTiles.X * Settings.NumTiles.Y);
+	Tiles.Reset();
+	Tiles.SetNum(Settings.NumTiles.X * Settings.NumTiles.Y);
+	for (int32 LOD = 0; LOD < VaporCloudscape::NumLODs; ++LOD) {
+		SlotOwners[LOD].Init(INDEX_NONE, InSlots[LOD]);
+	}
+}
+
+void FVaporTileResidency::Update(const FVector2D& Camera, TArray<FVaporTileLoad>& OutLoads) {
+	struct FCandidate {
+		int32 Tile;
+		int32 LOD;
+		float Distance;
+	};
+
+	/* Find the LOD each tile wants, and stream out the tiles which are out of range */
+	TArray<FCandidate> Candidates;
+	for (int32 Tile = 0; Tile < Tiles.Num(); ++Tile) {
+		FTileState& State = Tiles[Tile];
+		const float Distance = GetTileDistance(Tile, Camera);
+		const int32 LOD = Settings.EmptyTiles[Tile] ? INDEX_NONE : GetDesiredLOD(State, Distance);
+		if (LOD == INDEX_NONE) {
+			ReleaseSlot(State.ResidentLOD, State.ResidentSlot);
+			ReleaseSlot(State.PendingLOD, State.PendingSlot);
+			State.ResidentLOD = State.PendingLOD = INDEX_NONE;
+			continue;
+		}
+		Candidates.Add({ Tile, LOD, Distance });
+	}
+
+	/* Nearest tiles get the first pick of the free slots */
+	Candidates.Sort([](const FCandidate& A, const FCandidate& B) { return A.Distance < B.Distance; });
+
+	for (int32 i = 0; i < Candidates.Num(); ++i) {
+		const FCandidate& Candidate = Candidates[i];
+		FTileState& State = Tiles[Candidate.Tile];
+
+		/* Keep loads which are still an improvement, even if they're a fallback to a coarser LOD */
+		if (State.PendingLOD != INDEX_NONE) {
+			const bool bUseful = State.PendingLOD >= Candidate.LOD
+				&& (State.ResidentLOD == INDEX_NONE || State.ResidentLOD < Candidate.LOD || State.PendingLOD < State.ResidentLOD);
+			if (bUseful) continue;
+			ReleaseSlot(State.PendingLOD, State.PendingSlot);
+			State.PendingLOD = INDEX_NONE;
+		}
+		if (State.ResidentLOD == Candidate.LOD) continue;
+
+		/* Try the desired LOD first, then fall back to coarser LODs, up to the one we already have */
+		for (int32 LOD = Candidate.LOD; LOD < VaporCloudscape::NumLODs; ++LOD) {
+			if (LOD == State.ResidentLOD) break;
+			const int32 Slot = ClaimSlot(LOD, Candidate.Tile);
+			if (Slot == INDEX_NONE) continue;
+			State.PendingLOD = LOD;
+			State.PendingSlot = Slot;
+			break;
+		}
+
+		/* Tiles without any data take a slot from the farthest tile, if the budget is exhausted */
+		if (State.ResidentLOD == INDEX_NONE && State.PendingLOD == INDEX_NONE) {
+			for (int32 j = Candidates.Num() - 1; j > i; --j) {
+				FTileState& Victim = Tiles[Candidates[j].Tile];
+				if (Victim.ResidentLOD < Candidate.LOD) continue;
+				State.PendingLOD = Victim.ResidentLOD;
+				State.PendingSlot = Victim.ResidentSlot;
+				SlotOwners[State.PendingLOD][State.PendingSlot] = Candidate.Tile;
+				Victim.ResidentLOD = Victim.ResidentSlot = INDEX_NONE;
+				break;
+			}
+		}
+
+		if (State.PendingLOD != INDEX_NONE) {
+			OutLoads.Add({ Candidate.Tile, State.PendingLOD, State.PendingSlot });
+		}
+	}
+}
+
+bool FVaporTileResidency::CompleteLoad(const FVaporTileLoad& Load) {
+	FTileState& State = Tiles[Load.Tile];
+	if (State.PendingLOD != Load.LOD || State.PendingSlot != Load.Slot) return false;
+
+	/* Switch over to the new LOD, the old one is no longer referenced */
+	ReleaseSlot(State.ResidentLOD, State.ResidentSlot);
+	State.ResidentLOD = State.PendingLOD;
+	State.ResidentSlot = State.PendingSlot;
+	State.PendingLOD = State.PendingSlot = INDEX_NONE;
+	return true;
+}
+
+int32 FVaporTileResidency::GetUsedSlots(const int32 LOD) const {
+	int32 Used = 0;
+	for (const int32 Owner : SlotOwners[LOD]) {
+		if (Owner != INDEX_NONE) ++Used;
+	}
+	return Used;
+}
+
+int64 FVaporTileResidency::GetUsedBytes() const {
+	int64 Bytes = 0;
+	for (int32 LOD = 0; LOD < VaporCloudscape::NumLODs; ++LOD) {
+		Bytes += GetUsedSlots(LOD) * VaporCloudscape::GetTileBytes(LOD);
+	}
+	return Bytes;
+}
+
+int64 FVaporTileResidency::GetAllocatedBytes() const {
+	int64 Bytes = 0;
+	for (int32 LOD = 0; LOD < VaporCloudscape::NumLODs; ++LOD) {
+		Bytes += GetNumSlots(LOD) * VaporCloudscape::GetTileBytes(LOD);
+	}
+	return Bytes;
+}
+
+float FVaporTileResidency::GetTileDistance(const int32 Tile, const FVector2D& Camera) const {
+	/* Distance from the camera to the footprint of the tile, zero inside */
+	const FVector2D Min = FVector2D(Tile % Settings.NumTiles.X, Tile / Settings.NumTiles.X) * Settings.TileSize;
+	const FVector2D Max = Min + Settings.TileSize;
+	const FVector2D Delta = FVector2D::Max(FVector2D::Max(Min - Camera, Camera - Max), FVector2D::ZeroVector);
+	return (float)Delta.Size();
+}
+
+int32 FVaporTileResidency::GetDesiredLOD(const FTileState& State, const float Distance) const {
+	const int32 Current = State.PendingLOD != INDEX_NONE ? State.PendingLOD : State.ResidentLOD;
+	for (int32 LOD = 0; LOD < VaporCloudscape::NumLODs; ++LOD) {
+		/* Hold on to the current LOD (and coarser ones) a little past their distance */
+		const float Limit = Settings.LODDistances[LOD] * ((Current != INDEX_NONE && LOD >= Current) ? 1.0f + Settings.Hysteresis : 1.0f);
+		if (Distance < Limit) return LOD;
+	}
+	return INDEX_NONE;
+}
+
+int32 FVaporTileResidency::ClaimSlot(const int32 LOD, const int32 Tile) {
+	const int32 Slot = SlotOwners[LOD].Find(INDEX_NONE);
+	if (Slot != INDEX_NONE) SlotOwners[LOD][Slot] = Tile;
+	return Slot;
+}
+
+void FVaporTileResidency::ReleaseSlot(const int32 LOD, int32& Slot) {
+	if (Slot == INDEX_NONE) return;
+	SlotOwners[LOD][Slot] = INDEX_NONE;
+	Slot = INDEX_NONE;
+}
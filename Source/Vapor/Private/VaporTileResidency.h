@@ -0,0 +1,94 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VaporCloudscape.h"
+
+/* Distance-based LOD settings of a tiled cloudscape. */
+struct FVaporTileSettings {
+	/* Number of tiles along X and Y */
+	FIntPoint NumTiles = FIntPoint::ZeroValue;
+	/* World size of a single tile */
+	float TileSize = VaporCloudscape::TileWorldSize;
+	/* Camera distance up to which each LOD is used, tiles past the last distance are streamed out */
+	float LODDistances[VaporCloudscape::NumLODs] = { 600000.0f, 1600000.0f, 4000000.0f }; // cm
+	/* Fraction past a LOD distance at which tiles switch to a coarser LOD, this avoids thrashing at the boundary */
+	float Hysteresis = 0.1f;
+	/* Tiles without any cloud, these are never made resident */
+	TArray<bool> EmptyTiles;
+};
+
+/* Request to stream a tile LOD into an atlas slot. */
+struct FVaporTileLoad {
+	int32 Tile = INDEX_NONE;
+	int32 LOD = INDEX_NONE;
+	int32 Slot = INDEX_NONE;
+};
+
+/**
+ * Decides which tiles are resident at which LOD, within a fixed number of atlas slots per LOD.
+ * A tile keeps its old LOD until the new one is loaded, and the slots are sized to the VRAM budget up front.
+ * Has no dependencies on the renderer or IO, the camera is fed in through `Update`.
+ */
+class FVaporTileResidency {
+public:
+	/** @brief Split a VRAM budget into atlas slots for each LOD, the coarsest LOD is covered first. */
+	static void ComputeSlotBudget(const FVaporTileSettings& Settings, const int64 BudgetBytes, int32 OutSlots[VaporCloudscape::NumLODs]);
+
+	/** @brief Reset all residency, with a fixed number of atlas slots for each LOD. */
+	void Init(const FVaporTileSettings& InSettings, const int32 InSlots[VaporCloudscape::NumLODs]);
+
+	/** @brief Decide the residency for a camera position, returns the new loads to start. Tiles which are out of range are evicted. */
+	void Update(const FVector2D& Camera, TArray<FVaporTileLoad>& OutLoads);
+
+	/**
+	 * @brief Mark a load as completed, the tile switches to the new LOD and frees its old slot.
+	 * @return False if the load was cancelled in the meantime, its data should be dropped.
+	 */
+	bool CompleteLoad(const FVaporTileLoad& Load);
+
+	/** @brief Check if a load is still wanted, loads are cancelled when a tile changes its mind. */
+	bool IsLoadPending(const FVaporTileLoad& Load) const { return Tiles[Load.Tile].PendingLOD == Load.LOD && Tiles[Load.Tile].PendingSlot == Load.Slot; }
+
+	/** @brief Get the resident LOD of a tile, or INDEX_NONE. */
+	int32 GetResidentLOD(const int32 Tile) const { return Tiles[Tile].ResidentLOD; }
+
+	/** @brief Get the atlas slot of the resident LOD of a tile, or INDEX_NONE. */
+	int32 GetResidentSlot(const int32 Tile) const { return Tiles[Tile].ResidentSlot; }
+
+	/** @brief Get the number of atlas slots of a LOD. */
+	int32 GetNumSlots(const int32 LOD) const { return SlotOwners[LOD].Num(); }
+
+	/** @brief Get the number of atlas slots of a LOD which are in use, by resident or loading tiles. */
+	int32 GetUsedSlots(const int32 LOD) const;
+
+	/** @brief Get the number of bytes of all atlas slots in use. */
+	int64 GetUsedBytes() const;
+
+	/** @brief Get the number of bytes of all atlas slots, this stays within the budget passed to `ComputeSlotBudget`. */
+	int64 GetAllocatedBytes() const;
+
+	/** @brief Get the camera distance to a tile. */
+	float GetTileDistance(const int32 Tile, const FVector2D& Camera) const;
+
+private:
+	struct FTileState {
+		int32 ResidentLOD = INDEX_NONE;
+		int32 ResidentSlot = INDEX_NONE;
+		int32 PendingLOD = INDEX_NONE;
+		int32 PendingSlot = INDEX_NONE;
+	};
+
+	/** @brief Get the LOD a tile should use at a distance, or INDEX_NONE if it should be streamed out. */
+	int32 GetDesiredLOD(const FTileState& State, const float Distance) const;
+
+	/** @brief Claim a free slot of a LOD for a tile, or INDEX_NONE. */
+	int32 ClaimSlot(const int32 LOD, const int32 Tile);
+
+	/** @brief Release a slot, if valid. */
+	void ReleaseSlot(const int32 LOD, int32& Slot);
+
+	FVaporTileSettings Settings;
+	TArray<FTileState> Tiles;
+	/* Tile which owns each slot of each LOD, or INDEX_NONE */
+	TArray<int32> SlotOwners[VaporCloudscape::NumLODs];
+};
@@ -0,0 +1,100 @@
+#include "VaporTileStreamer.h"
+
+#include "VaporCloudscape.h"
+#include "Serialization/BulkData.h"
+
+FVaporTileStreamer::~FVaporTileStreamer() {
+	CancelAll();
+}
+
+bool FVaporTileStreamer::SetCloudscape(const UVaporCloudscape* InCloudscape, const FVaporTileSettings& InSettings, const int64 BudgetBytes) {
+	const bool bSameSettings = FMemory::Memcmp(InSettings.LODDistances, Settings.LODDistances, sizeof(Settings.LODDistances)) == 0
+		&& InSettings.Hysteresis == Settings.Hysteresis;
+	if (Cloudscape.Get() == InCloudscape && Budget == BudgetBytes && bSameSettings) return false;
+
+	CancelAll();
+	Queue.Reset();
+	Cloudscape = InCloudscape;
+	Budget = BudgetBytes;
+	Settings = InSettings;
+	if (InCloudscape) {
+		Settings.NumTiles = InCloudscape->NumTiles;
+		Settings.EmptyTiles = InCloudscape->EmptyTiles;
+	}
+
+	/* Size the atlas slots to the budget up front, so we never go over it */
+	FVaporTileResidency::ComputeSlotBudget(Settings, Budget, Slots);
+	Residency.Init(Settings, Slots);
+	TileTable.Init(0, Settings.NumTiles.X * Settings.NumTiles.Y);
+
+	UE_LOG(LogTemp, Log, TEXT("Vapor: Cloudscape %dx%d tiles, %d/%d/%d LOD slots (%.2f of %.2f MB)"),
+		Settings.NumTiles.X, Settings.NumTiles.Y, Slots[0], Slots[1], Slots[2],
+		Residency.GetAllocatedBytes() / (1024.0f * 1024.0f), Budget / (1024.0f * 1024.0f));
+	return true;
+}
+
+void FVaporTileStreamer::Update(const FVector2D& Camera, TArray<FVaporTileUpload>& OutUploads) {
+	const UVaporCloudscape* Scape = Cloudscape.Get();
+	if (Scape == nullptr || Scape->TilePayloads.Num() != Scape->GetNumTiles() * VaporCloudscape::NumLODs) return;
+
+	/* Hand the completed loads over to the render thread, unless they were cancelled in the meantime */
+	for (int32 i = InFlight.Num() - 1; i >= 0; --i) {
+		FRequest& Request = InFlight[i];
+		if (Request.Request && !Request.Request->PollCompletion()) continue;
+
+		const bool bCanceled = Request.Request && Request.Request->WasCanceled();
+		delete Request.Request;
+		if (!bCanceled && Residency.CompleteLoad(Request.Load)) {
+			OutUploads.Add({ Request.Load.LOD, Request.Load.Slot, MoveTemp(Request.Payload) });
+		}
+		InFlight.RemoveAtSwap(i);
+	}
+
+	/* Decide which tiles should be resident */
+	Residency.Update(Camera, Queue);
+
+	/* Start new loads, nearest tiles were queued first */
+	while (InFlight.Num() < MaxInFlight && Queue.Num() > 0) {
+		const FVaporTileLoad Load = Queue[0];
+		Queue.RemoveAt(0);
+		if (!Residency.IsLoadPending(Load)) continue;
+
+		FRequest& Request = InFlight.AddDefaulted_GetRef();
+		Request.Load = Load;
+		Request.Payload = MakeShared<TArray<uint8>, ESPMode::ThreadSafe>();
+		Request.Payload->SetNumUninitialized(VaporCloudscape::GetTileBytes(Load.LOD));
+
+		/* Stream the payload straight into the upload buffer */
+		const FByteBulkData& BulkData = Scape->TilePayloads[UVaporCloudscape::GetPayloadIndex(Load.Tile, Load.LOD)];
+		if (BulkData.CanLoadFromDisk()) {
+			Request.Request = BulkData.CreateStreamingRequest(AIOP_Normal, nullptr, Request.Payload->GetData());
+		}
+
+		/* Payloads which are not backed by a file yet (freshly imported) are already resident */
+		if (Request.Request == nullptr) {
+			FMemory::Memcpy(Request.Payload->GetData(), BulkData.LockReadOnly(), FMath::Min<int64>(Request.Payload->Num(), BulkData.GetBulkDataSize()));
+			BulkData.Unlock();
+		}
+	}
+
+	/* Rebuild the tile table from the resident tiles */
+	FIntVector AtlasSlots[VaporCloudscape::NumLODs];
+	for (int32 LOD = 0; LOD < VaporCloudscape::NumLODs; ++LOD) {
+		AtlasSlots[LOD] = VaporCloudscape::GetAtlasSlots(LOD, Slots[LOD]);
+	}
+	for (int32 Tile = 0; Tile < TileTable.Num(); ++Tile) {
+		const int32 LOD = Residency.GetResidentLOD(Tile);
+		TileTable[Tile] = LOD == INDEX_NONE ? 0u : VaporCloudscape::PackTile(VaporCloudscape::GetSlotCoord(Residency.GetResidentSlot(Tile), AtlasSlots[LOD]), LOD);
+	}
+}
+
+void FVaporTileStreamer::CancelAll() {
+	/* The requests write into their upload buffers, so we have to wait for them */
+	for (FRequest& Request : InFlight) {
+		if (Request.Request == nullptr) continue;
+		Request.Request->Cancel();
+		Request.Request->WaitCompletion();
+		delete Request.Request;
+	}
+	InFlight.Reset();
+}
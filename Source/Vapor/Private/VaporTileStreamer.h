@@ -0,0 +1,64 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+#include "VaporTileResidency.h"
+
+class UVaporCloudscape;
+class IBulkDataIORequest;
+
+/* Tile payload which finished streaming in, to be uploaded into its atlas slot. (render thread) */
+struct FVaporTileUpload {
+	int32 LOD = INDEX_NONE;
+	int32 Slot = INDEX_NONE;
+	/* Density (G8) followed by SDF (G16) */
+	TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe> Payload;
+};
+
+/**
+ * Streams the tiles of a cloudscape in and out with async IO, following the decisions of `FVaporTileResidency`.
+ * Produces the tile uploads and the tile table for the render thread. (game thread)
+ */
+class FVaporTileStreamer {
+public:
+	/* Number of tile loads in flight at once */
+	static constexpr int32 MaxInFlight = 4;
+
+	~FVaporTileStreamer();
+
+	/**
+	 * @brief Switch to a different cloudscape or budget, cancels all loads and resets the residency.
+	 * @return True if the residency was reset, all atlas slots are invalid after this.
+	 */
+	bool SetCloudscape(const UVaporCloudscape* InCloudscape, const FVaporTileSettings& InSettings, const int64 BudgetBytes);
+
+	/** @brief Stream tiles in and out for a camera position, relative to the cloudscape corner. */
+	void Update(const FVector2D& Camera, TArray<FVaporTileUpload>& OutUploads);
+
+	/** @brief Get the number of atlas slots of each LOD. */
+	const int32* GetSlots() const { return Slots; }
+
+	/** @brief Get the tile table, an entry per tile packed with `VaporCloudscape::PackTile`. */
+	const TArray<uint32>& GetTileTable() const { return TileTable; }
+
+	const FVaporTileResidency& GetResidency() const { return Residency; }
+
+private:
+	struct FRequest {
+		FVaporTileLoad Load;
+		TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe> Payload;
+		IBulkDataIORequest* Request = nullptr;
+	};
+
+	/** @brief Cancel all loads in flight and wait for them. */
+	void CancelAll();
+
+	TWeakObjectPtr<const UVaporCloudscape> Cloudscape;
+	FVaporTileResidency Residency;
+	FVaporTileSettings Settings;
+	int64 Budget = 0;
+	int32 Slots[VaporCloudscape::NumLODs] = {};
+	TArray<FVaporTileLoad> Queue;
+	TArray<FRequest> InFlight;
+	TArray<uint32> TileTable;
+};
@@ -0,0 +1,187 @@
+#include "VaporTrace.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+#include "SceneView.h"
+#include "UObject/UnrealType.h"
+#include "VaporComponent.h"
+
+namespace {
+	/* State of the running capture, game thread only */
+	struct FCapture {
+		TUniquePtr<FArchive> Ar;
+		FString Filename;
+		TMap<FString, FString> Component; /* Last recorded value of each component property */
+		TMap<FString, FString> CVars; /* Last recorded value of each console variable */
+		uint64 LastFrameNumber = MAX_uint64;
+		int32 NumFrames = 0;
+	};
+	TUniquePtr<FCapture> Capture;
+
+	/** @brief Serialize the scalar parameters of the render data, the textures are bound on the render thread. */
+	void SerializeRenderData(FArchive& Ar, FCloudscapeRenderData& Data) {
+		Ar << Data.Position << Data.Absorption << Data.Density << Data.ProfileWidth;
+		Ar << Data.SunDir << Data.SunLuminance << Data.AmbientLuminance;
+		Ar << Data.PrimaryNearStep << Data.PrimaryStepPerDistance << Data.PrimaryMinSDFStep;
+		Ar << Data.SecondaryStep << Data.SecondaryExtinctThreshold;
+		Ar << Data.NoiseFreq << Data.WindSpeed;
+	}
+
+	void SerializeFrame(FArchive& Ar, FVaporTraceFrame& Frame) {
+		Ar << Frame.Time << Frame.FrameNumber;
+		Ar << Frame.ViewOrigin << Frame.ViewMatrix << Frame.ProjectionMatrix << Frame.ViewSize;
+		SerializeRenderData(Ar, Frame.Data);
+		Ar << Frame.ComponentChanges << Frame.CVarChanges;
+	}
+
+	/** @brief Export the properties declared by the component as text, object references become paths. */
+	void GatherComponentProperties(const UVaporComponent& Component, TMap<FString, FString>& Out) {
+		for (TFieldIterator<FProperty> It(UVaporComponent::StaticClass(), EFieldIteratorFlags::ExcludeSuper); It; ++It) {
+			FString Value;
+			It->ExportTextItem_InContainer(Value, &Component, nullptr, nullptr, PPF_None);
+			Out.Add(It->GetName(), MoveTemp(Value));
+		}
+	}
+
+	/** @brief Get the console variables which affect the clouds, including the scalability group of the quality tier. */
+	void GatherCVars(TMap<FString, FString>& Out) {
+		const FConsoleObjectVisitor Visitor = FConsoleObjectVisitor::CreateLambda([&Out](const TCHAR* Name, IConsoleObject* Object) {
+			if (IConsoleVariable* Variable = Object->AsVariable()) Out.Add(Name, Variable->GetString());
+		});
+		IConsoleManager::Get().ForEachConsoleObjectThatStartsWith(Visitor, TEXT("r.Vapor"));
+		IConsoleManager::Get().ForEachConsoleObjectThatStartsWith(Visitor, TEXT("sg.EffectsQuality"));
+	}
+
+	/** @brief Find the values which changed since they were last recorded. */
+	void DiffValues(const TMap<FString, FString>& Current, TMap<FString, FString>& Recorded, TArray<TPair<FString, FString>>& OutChanges) {
+		for (const TPair<FString, FString>& Value : Current) {
+			const FString* Previous = Recorded.Find(Value.Key);
+			if (Previous && *Previous == Value.Value) continue;
+			Recorded.Add(Value.Key, Value.Value);
+			OutChanges.Emplace(Value.Key, Value.Value);
+		}
+	}
+}
+
+bool VaporTrace::IsCapturing() {
+	return Capture.IsValid();
+}
+
+bool VaporTrace::StartCapture(const FString& Filename) {
+	StopCapture();
+
+	TUniquePtr<FArchive> Ar(IFileManager::Get().CreateFileWriter(*Filename));
+	if (!Ar.IsValid()) {
+		UE_LOG(LogTemp, Error, TEXT("Vapor: Failed to create trace %s"), *Filename);
+		return false;
+	}
+	uint32 Header[2] = { Magic, Version };
+	*Ar << Header[0] << Header[1];
+
+	Capture = MakeUnique<FCapture>();
+	Capture->Ar = MoveTemp(Ar);
+	Capture->Filename = Filename;
+	UE_LOG(LogTemp, Log, TEXT("Vapor: Capturing trace to %s"), *Filename);
+	return true;
+}
+
+void VaporTrace::StopCapture() {
+	if (!Capture.IsValid()) return;
+
+	const int64 Bytes = Capture->Ar->Tell();
+	Capture->Ar->Close();
+	UE_LOG(LogTemp, Log, TEXT("Vapor: Captured %d frames to %s, %.2f MB (%.0f bytes per frame)"),
+		Capture->NumFrames, *Capture->Filename, Bytes / (1024.0f * 1024.0f), (float)Bytes / FMath::Max(Capture->NumFrames, 1));
+	Capture.Reset();
+}
+
+void VaporTrace::CaptureFrame(const FVaporFrameInputs& Inputs, const FSceneView& View) {
+	if (!Capture.IsValid() || Capture->LastFrameNumber == GFrameCounter) return;
+	Capture->LastFrameNumber = GFrameCounter;
+
+	FVaporTraceFrame Frame;
+	Frame.Time = Inputs.Time;
+	Frame.FrameNumber = GFrameCounter;
+	Frame.ViewOrigin = View.ViewMatrices.GetViewOrigin();
+	Frame.ViewMatrix = View.ViewMatrices.GetViewMatrix();
+	Frame.ProjectionMatrix = View.ViewMatrices.GetProjectionMatrix();
+	Frame.ViewSize = View.UnscaledViewRect.Size();
+	Frame.Data = Inputs.Data;
+
+	/* Only the values which changed are stored, the first frame holds all of them */
+	TMap<FString, FString> Current;
+	GatherComponentProperties(*Inputs.Component, Current);
+	DiffValues(Current, Capture->Component, Frame.ComponentChanges);
+	Current.Reset();
+	GatherCVars(Current);
+	DiffValues(Current, Capture->CVars, Frame.CVarChanges);
+
+	SerializeFrame(*Capture->Ar, Frame);
+	++Capture->NumFrames;
+}
+
+void VaporTrace::ApplyComponentChanges(const FVaporTraceFrame& Frame, UVaporComponent& Component) {
+	for (const TPair<FString, FString>& Change : Frame.ComponentChanges) {
+		FProperty* Property = FindFProperty<FProperty>(UVaporComponent::StaticClass(), *Change.Key);
+		if (Property == nullptr) {
+			UE_LOG(LogTemp, Warning, TEXT("Vapor: Trace sets unknown component property %s"), *Change.Key);
+			continue;
+		}
+		/* Object references are loaded by path */
+		Property->ImportText_InContainer(*Change.Value, &Component, &Component, PPF_None);
+	}
+}
+
+void VaporTrace::ApplyCVarChanges(const FVaporTraceFrame& Frame) {
+	for (const TPair<FString, FString>& Change : Frame.CVarChanges) {
+		if (IConsoleVariable* Variable = IConsoleManager::Get().FindConsoleVariable(*Change.Key)) {
+			Variable->Set(*Change.Value, ECVF_SetByConsole);
+		}
+	}
+}
+
+bool FVaporTraceReader::Open(const FString& Filename) {
+	Ar.Reset(IFileManager::Get().CreateFileReader(*Filename));
+	if (!Ar.IsValid()) {
+		UE_LOG(LogTemp, Error, TEXT("Vapor: Failed to open trace %s"), *Filename);
+		return false;
+	}
+
+	uint32 Header[2] = { 0, 0 };
+	*Ar << Header[0] << Header[1];
+	if (Header[0] != VaporTrace::Magic || Header[1] != VaporTrace::Version) {
+		UE_LOG(LogTemp, Error, TEXT("Vapor: %s is not a trace, or was captured by a different version"), *Filename);
+		Ar.Reset();
+		return false;
+	}
+	return true;
+}
+
+bool FVaporTraceReader::Read(FVaporTraceFrame& OutFrame) {
+	if (!Ar.IsValid() || Ar->AtEnd()) return false;
+
+	OutFrame.ComponentChanges.Reset();
+	OutFrame.CVarChanges.Reset();
+	SerializeFrame(*Ar, OutFrame);
+	return !Ar->IsError();
+}
+
+namespace {
+	void StartCaptureCommand(const TArray<FString>& Args) {
+		const FString Filename = Args.Num() > 0 ? Args[0]
+			: FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Vapor"), FString::Printf(TEXT("%s.vtrace"), *FDateTime::Now().ToString()));
+		VaporTrace::StartCapture(Filename);
+	}
+
+	FAutoConsoleCommand CmdTraceStart(
+		TEXT("vapor.trace.start"),
+		TEXT("Capture the cloud state of every frame into a trace, for replay with -run=VaporReplay. Optional: <Filename>"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&StartCaptureCommand));
+
+	FAutoConsoleCommand CmdTraceStop(
+		TEXT("vapor.trace.stop"),
+		TEXT("Stop capturing the cloud trace"),
+		FConsoleCommandDelegate::CreateStatic(&VaporTrace::StopCapture));
+}
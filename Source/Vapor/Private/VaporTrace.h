@@ -0,0 +1,69 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VaporExtension.h"
+
+class UVaporComponent;
+
+/* A captured frame, the inputs of `FVaporExtension::SetupFrame` and the primary view. */
+struct FVaporTraceFrame {
+	double Time = 0.0;
+	uint64 FrameNumber = 0;
+
+	/* Primary view, in world space */
+	FVector ViewOrigin = FVector::ZeroVector;
+	FMatrix ViewMatrix = FMatrix::Identity;
+	FMatrix ProjectionMatrix = FMatrix::Identity;
+	FIntPoint ViewSize = FIntPoint::ZeroValue;
+
+	/* Render data filled in on the game thread, only the scalar parameters are stored */
+	FCloudscapeRenderData Data {};
+
+	/* Component properties and console variables which changed since the previous frame, as text */
+	TArray<TPair<FString, FString>> ComponentChanges;
+	TArray<TPair<FString, FString>> CVarChanges;
+
+	/** @brief Get the inverse view projection, from clip space to world space. */
+	FMatrix GetInvViewProjection() const { return (ViewMatrix * ProjectionMatrix).Inverse(); }
+};
+
+/**
+ * Compact binary trace of captured frames, used to replay production frames offline. (see "VaporReplayCommandlet.h")
+ * Component properties and console variables are delta encoded, so a frame is mostly the view and the render data.
+ */
+namespace VaporTrace {
+	/* File header, followed by frames until the end of the file */
+	constexpr uint32 Magic = 0x43525456; // "VTRC"
+	constexpr uint32 Version = 1;
+
+	/** @brief Check if a trace is being captured. (game thread) */
+	bool IsCapturing();
+
+	/** @brief Start capturing into a file, stops the previous capture. (game thread) */
+	bool StartCapture(const FString& Filename);
+
+	/** @brief Stop capturing and close the file. (game thread) */
+	void StopCapture();
+
+	/** @brief Record a frame, only the first view family of each engine frame is recorded. (game thread) */
+	void CaptureFrame(const FVaporFrameInputs& Inputs, const FSceneView& View);
+
+	/** @brief Apply the property changes of a frame to a component. */
+	void ApplyComponentChanges(const FVaporTraceFrame& Frame, UVaporComponent& Component);
+
+	/** @brief Apply the console variable changes of a frame. */
+	void ApplyCVarChanges(const FVaporTraceFrame& Frame);
+}
+
+/* Reads the frames of a trace in order. */
+class FVaporTraceReader {
+public:
+	/** @brief Open a trace, returns false if it's missing or has an unknown version. */
+	bool Open(const FString& Filename);
+
+	/** @brief Read the next frame, returns false at the end of the trace. */
+	bool Read(FVaporTraceFrame& OutFrame);
+
+private:
+	TUniquePtr<FArchive> Ar;
+};
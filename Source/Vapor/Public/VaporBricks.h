@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Compressed on-disk layout of the cloud fields.
+ * Fields are split into bricks which are compressed independently, so they can be decoded in parallel.
+ * Each brick is delta encoded against its neighbouring voxel, and 16-bit fields are split into a low and high byte plane.
+ */
+namespace VaporBricks {
+	/* Voxels per brick along each axis, bricks at the edge of a field are clipped */
+	constexpr int32 BrickSize = 32;
+
+	/** @brief Get the number of bricks along each axis of a field. */
+	inline FIntVector GetNumBricks(const FIntVector& Size) {
+		return FIntVector(FMath::DivideAndRoundUp(Size.X, BrickSize), FMath::DivideAndRoundUp(Size.Y, BrickSize), FMath::DivideAndRoundUp(Size.Z, BrickSize));
+	}
+
+	/**
+	 * @brief Compress a dense field, with `BytesPerVoxel` of 1 (G8) or 2 (G16). (x + y * X + z * X * Y)
+	 * The payload starts with the end offset of each brick, followed by the compressed bricks.
+	 */
+	TArray64<uint8> Compress(const uint8* Voxels, const FIntVector& Size, const int32 BytesPerVoxel);
+
+	/**
+	 * @brief Decompress a payload into a dense field with the given pitches, all bricks are decoded in parallel.
+	 * The field loader decodes into staging arrays on a worker thread, the render thread then copies them into the textures.
+	 * Returns false if the payload is corrupt, the destination is left partially written.
+	 */
+	bool Decompress(const uint8* Payload, const int64 PayloadSize, const FIntVector& Size, const int32 BytesPerVoxel,
+		uint8* Dest, const uint32 RowPitch, const uint32 DepthPitch);
+}
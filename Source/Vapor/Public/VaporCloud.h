@@ -1,19 +1,139 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Serialization/BulkData.h"
 
 #include "VaporCloud.generated.h"
 
-UCLASS()
+/* Sparse light cache layout, must match "LightCache.ush". */
+namespace VaporLightCache {
+	/* The light cache has half the resolution of the cloud fields */
+	constexpr int32 Downsample = 2;
+	constexpr int32 ResolutionX = 512 / Downsample;
+	constexpr int32 ResolutionY = 512 / Downsample;
+	constexpr int32 ResolutionZ = 64 / Downsample;
+
+	/* Cache voxels per page along each axis, pages have a 1 voxel border for filtering */
+	constexpr int32 PageSize = 8;
+	constexpr int32 PhysicalPageSize = PageSize + 2;
+	constexpr int32 PagesX = ResolutionX / PageSize;
+	constexpr int32 PagesY = ResolutionY / PageSize;
+	constexpr int32 PagesZ = ResolutionZ / PageSize;
+
+	/** @brief Pack the coordinates of a page into a single integer. */
+	inline uint32 PackPage(const uint32 X, const uint32 Y, const uint32 Z) { return X | (Y << 10) | (Z << 20); }
+}
+
+/* Proxy hull bricks, must match `BuildProxyHull` in "CloudscapeFactory.cpp". */
+namespace VaporProxyHull {
+	/* Voxels per hull brick along each axis */
+	constexpr int32 BrickSize = 16;
+
+	/**
+	 * @brief Check if a point in voxel-space lies in an occupied brick, or in one of the bricks around it.
+	 * `Occupancy` holds one bit per brick, with x running fastest. Bricks outside the volume are empty.
+	 */
+	inline bool IsNearOccupied(const FIntVector& Bricks, const TArray<uint32>& Occupancy, const FVector3f& Voxel) {
+		const FVector3f BrickCoord = Voxel / (float)BrickSize;
+		if (BrickCoord.X < -1.0f || BrickCoord.Y < -1.0f || BrickCoord.Z < -1.0f) return false;
+		if (BrickCoord.X >= Bricks.X + 1.0f || BrickCoord.Y >= Bricks.Y + 1.0f || BrickCoord.Z >= Bricks.Z + 1.0f) return false;
+
+		const FIntVector Center(FMath::FloorToInt32(BrickCoord.X), FMath::FloorToInt32(BrickCoord.Y), FMath::FloorToInt32(BrickCoord.Z));
+		for (int32 z = FMath::Max(Center.Z - 1, 0); z <= FMath::Min(Center.Z + 1, Bricks.Z - 1); ++z) {
+			for (int32 y = FMath::Max(Center.Y - 1, 0); y <= FMath::Min(Center.Y + 1, Bricks.Y - 1); ++y) {
+				for (int32 x = FMath::Max(Center.X - 1, 0); x <= FMath::Min(Center.X + 1, Bricks.X - 1); ++x) {
+					const int32 Index = x + (y * Bricks.X) + (z * Bricks.X * Bricks.Y);
+					if (Occupancy.IsValidIndex(Index >> 5) && (Occupancy[Index >> 5] & (1u << (Index & 31)))) return true;
+				}
+			}
+		}
+		return false;
+	}
+}
+
+UCLASS(MinimalAPI)
 class UVaporCloud : public UObject {
 	GENERATED_UCLASS_BODY()
 
 public:
-	/* Cloud density data field (0..1) */
+	/* Number of prefiltered mips stored for the compressed fields, each mip halves the resolution */
+	static constexpr int32 MaxFieldMips = 3;
+
+	/* Number of voxels along each axis of the compressed fields, zero for clouds imported as volume textures */
+	UPROPERTY(VisibleAnywhere, Category = "Fields")
+	FIntVector FieldSize = FIntVector::ZeroValue;
+
+	/* Number of mips of the compressed fields, for footprint based LOD sampling */
+	UPROPERTY(VisibleAnywhere, Category = "Fields")
+	int32 NumFieldMips = 0;
+
+	/* Total size of the compressed density and SDF payloads, in bytes */
+	UPROPERTY(VisibleAnywhere, Category = "Fields")
+	int64 CompressedBytes = 0;
+
+	/* Density (G8) and SDF (G16) field mips, compressed into bricks. (see `VaporBricks`) */
+	TIndirectArray<FByteBulkData> DensityBricks;
+	TIndirectArray<FByteBulkData> SDFBricks;
+
+	/* Cloud density data field (0..1), only used by clouds imported before the compressed fields */
 	UPROPERTY(VisibleAnywhere, Category = "Textures")
 	class UVolumeTexture* DensityField = nullptr;
 
-	/* Cloud SDF data field, for ray-marching */
+	/* Cloud SDF data field, for ray-marching, only used by clouds imported before the compressed fields */
 	UPROPERTY(VisibleAnywhere, Category = "Textures")
 	class UVolumeTexture* SignedDistanceField = nullptr;
+
+	/* Cloud L1 spherical harmonics path density field, for precomputed lighting */
+	UPROPERTY(VisibleAnywhere, Category = "Textures")
+	class UVolumeTexture* TransmittanceField = nullptr;
+
+	/* Light cache pages which overlap the cloud, (packed with `VaporLightCache::PackPage`) */
+	UPROPERTY(VisibleAnywhere, Category = "Lighting")
+	TArray<uint32> LightCachePages;
+
+	/* Conservative hull around the occupied bricks of the cloud, a triangle list in volume UVW space (0..1) */
+	UPROPERTY(VisibleAnywhere, Category = "Rendering")
+	TArray<FVector3f> ProxyHull;
+
+	/* Number of hull bricks along each axis, zero for clouds imported before the brick occupancy was stored */
+	UPROPERTY(VisibleAnywhere, Category = "Rendering")
+	FIntVector ProxyHullBricks = FIntVector::ZeroValue;
+
+	/* Occupied hull bricks, one bit per brick (see `VaporProxyHull::IsNearOccupied`) */
+	UPROPERTY()
+	TArray<uint32> ProxyHullOccupancy;
+
+	/** @brief Check if the density and SDF are stored as compressed fields, instead of volume textures. */
+	bool HasCompressedFields() const { return FieldSize != FIntVector::ZeroValue; }
+
+	/** @brief Get the number of voxels along each axis of a field mip. */
+	static FIntVector GetMipSize(const FIntVector& Size, const int32 Mip) {
+		return FIntVector(FMath::Max(Size.X >> Mip, 1), FMath::Max(Size.Y >> Mip, 1), FMath::Max(Size.Z >> Mip, 1));
+	}
+
+	/**
+	 * @brief Get how much closer the surface can be than a trilinear SDF sample of a mip says, in voxels of mip 0.
+	 * Mip 0 only reaches its bilinear neighbours, half a voxel along each axis. A prefiltered mip reaches 1.5 mip texels,
+	 * the box filter and the bilinear neighbour. Between mips the slack blends like the samples do.
+	 * Must match `SampleSDist` in "Cloud.ush".
+	 */
+	static float GetMipSlack(const float Mip) {
+		const auto SlackAt = [](const float Level) { return Level > 0.0f ? 1.5f * UE_SQRT_3 * FMath::Exp2(Level) : 0.5f * UE_SQRT_3; };
+		return FMath::Lerp(SlackAt(FMath::FloorToFloat(Mip)), SlackAt(FMath::CeilToFloat(Mip)), FMath::Frac(Mip));
+	}
+
+	/** @brief Get the uncompressed size in bytes of the density and SDF fields, including all mips. */
+	int64 GetFieldBytes() const {
+		int64 Bytes = 0;
+		for (int32 Mip = 0; Mip < NumFieldMips; ++Mip) {
+			const FIntVector MipSize = GetMipSize(FieldSize, Mip);
+			Bytes += (int64)MipSize.X * MipSize.Y * MipSize.Z * (sizeof(uint8) + sizeof(uint16));
+		}
+		return Bytes;
+	}
+
+	/** @brief Compress and store the field mips, mip 0 must be `Size` voxels large. (see `GetMipSize`) */
+	VAPOR_API void SetFields(const FIntVector& Size, const TArray<TArray<uint8>>& DensityMips, const TArray<TArray<uint16>>& SDFMips);
+
+	virtual void Serialize(FArchive& Ar) override;
 };
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Serialization/BulkData.h"
+
+#include "VaporCloudSequence.generated.h"
+
+/* Animated cloud, each frame is a density and SDF field which is streamed in from disk during playback. */
+UCLASS(MinimalAPI)
+class UVaporCloudSequence : public UObject {
+	GENERATED_UCLASS_BODY()
+
+public:
+	/* Playback rate of the sequence */
+	UPROPERTY(EditAnywhere, Category = "Sequence", meta = (Units = "Hertz", ClampMin = "0.01"))
+	float FrameRate = 24.0f; // hz
+
+	/* Number of frames in the sequence */
+	UPROPERTY(VisibleAnywhere, Category = "Sequence")
+	int32 NumFrames = 0;
+
+	/* Number of voxels along each axis, the same for all frames */
+	UPROPERTY(VisibleAnywhere, Category = "Sequence")
+	FIntVector FrameSize = FIntVector::ZeroValue;
+
+	/* Frame payloads, density (G8) followed by SDF (G16). (never inlined, so they stay on disk until streamed) */
+	TIndirectArray<FByteBulkData> Frames;
+
+	/** @brief Get the size in bytes of a single frame payload. */
+	int64 GetFrameBytes() const { return (int64)FrameSize.X * FrameSize.Y * FrameSize.Z * (sizeof(uint8) + sizeof(uint16)); }
+
+	/** @brief Get the duration of the sequence in seconds. */
+	float GetDuration() const { return NumFrames / FMath::Max(FrameRate, 0.01f); }
+
+	/** @brief Append a frame, both fields must be `FrameSize` voxels large. */
+	VAPOR_API void AddFrame(const TArray<uint8>& Density, const TArray<uint16>& SDF);
+
+	virtual void Serialize(FArchive& Ar) override;
+};
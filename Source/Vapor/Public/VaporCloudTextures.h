@@ -0,0 +1,33 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderGraphResources.h"
+#include "RenderGraphBlackboard.h"
+
+/* Cloud textures of a single view. */
+struct FVaporCloudView {
+	/* Premultiplied cloud luminance (rgb) and transmittance (a), at the cloud resolution */
+	FRDGTextureRef CloudOutput = nullptr;
+
+	/* Scale from a pixel position within the view rect to a cloud output UV coordinate */
+	FVector2f PixelToCloudUV = FVector2f::ZeroVector;
+
+	/* Scene color pixel position of the view rect origin, subtracted before scaling by `PixelToCloudUV` */
+	FIntPoint ViewRectMin = FIntPoint::ZeroValue;
+};
+
+/**
+ * Cloud textures of every view of the family, put on the render graph blackboard after the cloud march.
+ * Only passes after the post-process pass can read them, fog and translucency render before the clouds.
+ */
+struct FVaporCloudTextures {
+	/* Indexed like `FSceneViewFamily::Views`, views without clouds have no cloud output */
+	TArray<FVaporCloudView, TInlineAllocator<2>> Views;
+
+	/** @brief Get the cloud textures of a view, or nullptr if the clouds were not rendered for it. */
+	const FVaporCloudView* Find(const int32 ViewIndex) const {
+		return Views.IsValidIndex(ViewIndex) && Views[ViewIndex].CloudOutput ? &Views[ViewIndex] : nullptr;
+	}
+};
+
+RDG_REGISTER_BLACKBOARD_STRUCT(FVaporCloudTextures);
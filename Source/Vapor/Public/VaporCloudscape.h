@@ -0,0 +1,97 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Serialization/BulkData.h"
+
+#include "VaporCloudscape.generated.h"
+
+/* Tiled cloudscape layout, must match "Cloudscape.ush". */
+namespace VaporCloudscape {
+	/* Number of LOD resolutions stored for each tile, each LOD halves the resolution */
+	constexpr int32 NumLODs = 3;
+
+	/* Tiles have a 1 voxel border (along X and Y) copied from their neighbours, for filtering */
+	constexpr int32 Apron = 1;
+
+	/* World size of a tile, the same as a single cloud. (512 voxels at `UNITS_PER_VOXEL`) */
+	constexpr float TileWorldSize = 512 * 800.0f; // cm
+	constexpr float TileWorldHeight = 64 * 800.0f; // cm
+
+	/* Atlas textures are limited to this many texels along each axis */
+	constexpr int32 MaxAtlasSize = 2048;
+
+	/** @brief Get the number of voxels of a tile along each axis. */
+	inline FIntVector GetTileResolution(const int32 LOD) { return FIntVector(512 >> LOD, 512 >> LOD, 64 >> LOD); }
+
+	/** @brief Get the number of voxels of a tile along each axis, including the apron. */
+	inline FIntVector GetPhysicalSize(const int32 LOD) { return GetTileResolution(LOD) + FIntVector(Apron * 2, Apron * 2, 0); }
+
+	/** @brief Get the size in bytes of a tile payload, density (G8) followed by SDF (G16). */
+	inline int64 GetTileBytes(const int32 LOD) {
+		const FIntVector Size = GetPhysicalSize(LOD);
+		return (int64)Size.X * Size.Y * Size.Z * (sizeof(uint8) + sizeof(uint16));
+	}
+
+	/** @brief Get the number of slots along each axis of an atlas holding `NumSlots` tiles. (stacked along Z first) */
+	inline FIntVector GetAtlasSlots(const int32 LOD, const int32 NumSlots) {
+		const FIntVector Size = GetPhysicalSize(LOD);
+		const int32 SlotsZ = FMath::Clamp(NumSlots, 1, MaxAtlasSize / Size.Z);
+		const int32 SlotsY = FMath::Clamp(FMath::DivideAndRoundUp(NumSlots, SlotsZ), 1, MaxAtlasSize / Size.Y);
+		const int32 SlotsX = FMath::Max(FMath::DivideAndRoundUp(NumSlots, SlotsZ * SlotsY), 1);
+		return FIntVector(SlotsX, SlotsY, SlotsZ);
+	}
+
+	/** @brief Get the maximum number of slots which fit in an atlas. */
+	inline int32 GetMaxSlots(const int32 LOD) {
+		const FIntVector Size = GetPhysicalSize(LOD);
+		return (MaxAtlasSize / Size.X) * (MaxAtlasSize / Size.Y) * (MaxAtlasSize / Size.Z);
+	}
+
+	/** @brief Get the coordinates of a slot in the atlas. */
+	inline FIntVector GetSlotCoord(const int32 Slot, const FIntVector& AtlasSlots) {
+		return FIntVector(Slot / (AtlasSlots.Z * AtlasSlots.Y), (Slot / AtlasSlots.Z) % AtlasSlots.Y, Slot % AtlasSlots.Z);
+	}
+
+	/* Tile table entries are a packed atlas slot and LOD, with the top bit set if the tile is resident */
+	constexpr uint32 TileResident = 0x80000000u;
+
+	/** @brief Pack a tile table entry. */
+	inline uint32 PackTile(const FIntVector& SlotCoord, const int32 LOD) {
+		return (uint32)SlotCoord.X | ((uint32)SlotCoord.Y << 8) | ((uint32)SlotCoord.Z << 16) | ((uint32)LOD << 24) | TileResident;
+	}
+}
+
+/* World-scale cloudscape, a grid of cloud tiles at several LOD resolutions which are streamed in by camera distance. */
+UCLASS(MinimalAPI)
+class UVaporCloudscape : public UObject {
+	GENERATED_UCLASS_BODY()
+
+public:
+	/* Number of tiles along X and Y */
+	UPROPERTY(VisibleAnywhere, Category = "Cloudscape")
+	FIntPoint NumTiles = FIntPoint::ZeroValue;
+
+	/* Tiles without any cloud, these are never streamed in */
+	UPROPERTY(VisibleAnywhere, Category = "Cloudscape")
+	TArray<bool> EmptyTiles;
+
+	/* Tile payloads, indexed by `GetPayloadIndex`. (never inlined, so they stay on disk until streamed) */
+	TIndirectArray<FByteBulkData> TilePayloads;
+
+	/** @brief Get the number of tiles. */
+	int32 GetNumTiles() const { return NumTiles.X * NumTiles.Y; }
+
+	/** @brief Get the index of a tile payload. */
+	static int32 GetPayloadIndex(const int32 Tile, const int32 LOD) { return Tile * VaporCloudscape::NumLODs + LOD; }
+
+	/** @brief Get the world size of the whole cloudscape. */
+	FVector3f GetWorldSize() const { return FVector3f(NumTiles.X * VaporCloudscape::TileWorldSize, NumTiles.Y * VaporCloudscape::TileWorldSize, VaporCloudscape::TileWorldHeight); }
+
+	/** @brief Allocate all tiles as empty. */
+	VAPOR_API void Init(const FIntPoint& InNumTiles);
+
+	/** @brief Set the payload of a tile LOD, both fields must be `GetPhysicalSize(LOD)` voxels large. */
+	VAPOR_API void SetTile(const int32 Tile, const int32 LOD, const TArray<uint8>& Density, const TArray<uint16>& SDF);
+
+	virtual void Serialize(FArchive& Ar) override;
+};
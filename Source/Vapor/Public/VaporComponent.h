@@ -11,6 +11,18 @@ enum class ECloudColorSpecifier {
 	Transmittance
 };
 
+UENUM()
+enum class ECloudLightingMode {
+	/* Bake the lighting into a cache at runtime, whenever the lighting changes. */
+	RuntimeCache,
+	/* Evaluate the lighting from the transmittance field baked on import. */
+	/* The bake uses the default settings of `FTransmittanceBakeSettings` (Density 0.01, ProfileWidth 160 m, 8 m steps), */
+	/* so it ignores the Density, ProfileWidth and SecondaryStep of the component. Re-import the cloud to bake it again. */
+	Precomputed,
+	/* Render a Beer shadow map of the cloud from the sun and the sky, whenever the sun or the cloud changes. */
+	ShadowMap
+};
+
 /* Vapor Instance Component */
 UCLASS(MinimalAPI)
 class UVaporComponent : public UPrimitiveComponent {
@@ -20,6 +32,10 @@ class UVaporComponent : public UPrimitiveComponent {
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cloud Volume")
 	TObjectPtr<class UVaporCloud> CloudAsset;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cloud Volume", meta = (ToolTip = "Animated cloud sequence, streamed from disk and used instead of the cloud asset."))
+	TObjectPtr<class UVaporCloudSequence> CloudSequence;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cloud Volume", meta = (EditCondition = "CloudSequence != nullptr"))
+	bool LoopSequence = true;
 
 	UPROPERTY(EditAnywhere, Category = "Cloud Volume")
 	ECloudColorSpecifier ColorSpecifier = ECloudColorSpecifier::Absorption;
@@ -38,8 +54,22 @@ class UVaporComponent : public UPrimitiveComponent {
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cloud Volume", meta = (Units = "CentimetersPerSecondSquared"))
 	FVector3f WindSpeed = FVector3f(0.0f, 0.0f, 400.0f); // cm/s2
 
+	/* -===- Cloudscape Section (r.Vapor.TileBudgetMB) -===- */
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cloudscape", meta = (ToolTip = "World-scale tiled cloudscape, streamed in around the camera and used instead of the cloud asset."))
+	TObjectPtr<class UVaporCloudscape> Cloudscape;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cloudscape", meta = (Units = "Centimeters", ToolTip = "Camera distance up to which tiles use the full resolution."))
+	float LOD0Distance = 600000.0f; // cm
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cloudscape", meta = (Units = "Centimeters", ToolTip = "Camera distance up to which tiles use half resolution."))
+	float LOD1Distance = 1600000.0f; // cm
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cloudscape", meta = (Units = "Centimeters", ToolTip = "Camera distance up to which tiles are streamed in, at quarter resolution."))
+	float StreamingDistance = 4000000.0f; // cm
+
 	/* -===- Cloud Lighting Section -===- */
 
+	UPROPERTY(EditAnywhere, Category = "Cloud Lighting")
+	ECloudLightingMode LightingMode = ECloudLightingMode::RuntimeCache;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cloud Lighting")
 	bool DirectScattering = true;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cloud Lighting")
@@ -64,6 +94,17 @@ class UVaporComponent : public UPrimitiveComponent {
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cloud Quality", meta = (Units = "Percent"))
 	float SecondaryExtinctThreshold = 0.0f; // %
 
+	/* -===- Cloud Auto-Tuning Section (r.Vapor.TargetMs) -===- */
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cloud Quality|Auto Tuning", meta = (Units = "Centimeters", ToolTip = "Largest near step the auto-tuner may use."))
+	float MaxPrimaryNearStep = 800.0f; // cm
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cloud Quality|Auto Tuning", meta = (Units = "Times", ToolTip = "Largest step per distance the auto-tuner may use."))
+	float MaxPrimaryStepPerDistance = 0.24f;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cloud Quality|Auto Tuning", meta = (Units = "Centimeters", ToolTip = "Largest secondary step the auto-tuner may use."))
+	float MaxSecondaryStep = 1600.0f; // cm
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cloud Quality|Auto Tuning", meta = (ClampMin = "0.25", ClampMax = "1.0", ToolTip = "Lowest resolution scale the auto-tuner may use."))
+	float MinResolutionScale = 0.5f;
+
 	/* -===- Cloud Debug Section -===- */
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cloud Debug")
@@ -74,6 +115,12 @@ class UVaporComponent : public UPrimitiveComponent {
 
 	/** @brief Insert this cloud components data into a render data struct. */
 	void IntoRenderData(class FCloudscapeRenderData& RenderData) const;
+
+	/** @brief Insert this cloud components quality settings into the auto-tuning bounds. */
+	void IntoQualityBounds(struct FVaporQualityBounds& Bounds) const;
+
+	/** @brief Insert this cloud components cloudscape LOD distances into the tile streaming settings. */
+	void IntoTileSettings(struct FVaporTileSettings& Settings) const;
 };
 
 /* Vapor Instance Actor */
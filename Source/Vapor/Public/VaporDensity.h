@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * User density scale of the clouds, `pow(x * s, lerp(0.3, 0.6, s))` with `s = pow(saturate(Scale), 4)`.
+ * The importer applies it with the `density_scale` grid, the renderer with the stored density times the component density.
+ * On the GPU it's looked up in a table built for the component density, so `SampleCloud` doesn't evaluate it per sample.
+ */
+namespace VaporDensity {
+	/* Lookup table size, the square root of the eroded density (x) by the stored density (y) */
+	constexpr int32 LUTSizeX = 128;
+	constexpr int32 LUTSizeY = 64;
+
+	/** @brief Apply a density scale to a density, this is the reference for the lookup table. */
+	inline float Transform(const float Value, const float Scale) {
+		const float PowScale = FMath::Pow(FMath::Clamp(Scale, 0.0f, 1.0f), 4.0f);
+		return FMath::Pow(FMath::Max(0.0f, Value * PowScale), FMath::Lerp(0.3f, 0.6f, FMath::Max(0.00001f, PowScale)));
+	}
+
+	/**
+	 * @brief Get the scale from the stored density to the y coordinate of the table. (0..1)
+	 * Stored densities above 1 / Density saturate, so the table stops there instead of spending rows on a constant.
+	 */
+	inline float GetLUTScale(const float Density) { return FMath::Max(1.0f, Density); }
+
+	/** @brief Build the lookup table for a component density. (x + y * LUTSizeX) */
+	VAPOR_API void BuildLUT(const float Density, TArray<float>& OutLUT);
+
+	/** @brief Look up the density scale of an eroded density like `ApplyDensityScale` in "Cloud.ush", with bilinear filtering. */
+	VAPOR_API float SampleLUT(const TArray<float>& LUT, const float Density, const float ErodedDensity, const float StoredDensity);
+}
@@ -18,6 +18,11 @@ public class Vapor : ModuleRules
             "SparseVolumeTexture"
             });
 
+        PrivateDependencyModuleNames.AddRange(new string[] {
+            "AssetRegistry",
+            "ImageCore"
+            });
+
         var EngineDir = Path.GetFullPath(Target.RelativeEnginePath);
 
         PrivateIncludePaths.AddRange(